@@ -2,15 +2,38 @@
 #include <linux/device.h>
 #include <linux/cdev.h>
 #include <linux/fs.h>
+#include <linux/hrtimer.h>
 #include <linux/init.h>
+#include <linux/irq_work.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/log2.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
 #include <linux/printk.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <asm/local.h>
+#include <linux/sysfs.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/wait.h>
 #include <linux/errno.h>
 
+#include "lkmpg-latency.h"
+#include "chardev.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
 MODULE_DESCRIPTION("04-chardev");
@@ -31,7 +54,6 @@ enum {
     CHARDEV_OPEN,
 };
 
-static char chardev_message_buffer[CHARDEV_BUFFER_LEN + 1];
 static atomic_t chardev_already_open = ATOMIC_INIT(CHARDEV_NOT_OPEN);
 
 static dev_t chardev_number = 0;
@@ -45,12 +67,249 @@ static struct file_operations chardev_file_operations = {
     .release = chardev_device_release
 };
 
-// enable debug output
+// per-operation latency histograms, built with LATENCY=1; the device takes no
+// lock, so only service times are recorded
+
+enum {
+    CHARDEV_LATENCY_OPEN,
+    CHARDEV_LATENCY_READ,
+    CHARDEV_LATENCY_RELEASE,
+    CHARDEV_LATENCY_COUNT
+};
+
+static struct lkmpg_latency chardev_latency[CHARDEV_LATENCY_COUNT] = {
+    [CHARDEV_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [CHARDEV_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [CHARDEV_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+};
+
+static struct lkmpg_latency_set chardev_latency_set;
+
+// enable debug output during initialization and cleanup; file operations are
+// traced through the chardev tracepoints instead
 
 static bool debug = false;
 module_param(debug, bool, 0);
 MODULE_PARM_DESC(debug, "Enable debug messages");
 
+// stream mode: instead of the open message, reads return the records that
+// other modules write through the producer api in chardev.h, which keeps a
+// ring of stream_ring_size bytes per cpu
+//
+// insmod chardev.ko stream=1
+// cat /sys/class/chardev/chardev/stream/drops
+//
+// a ring entry is a struct chardev_ring_entry followed by its payload, padded
+// to CHARDEV_RING_ALIGN bytes; an entry that would cross the end of the ring
+// starts at its beginning instead, behind a discarded entry covering the gap
+//
+// three positions, counted in bytes since the ring was created, split each
+// ring: reservations advance head, the outermost commit on the cpu advances
+// commit over every entry that was committed or discarded, and the reader
+// advances tail; nested reservations leave commit alone, so the entries
+// between commit and head are the ones still being filled in, and the reader
+// never sees them
+//
+// synthetic producer mode (producer=1, which implies stream=1) sizes
+// consumers without another module: a kernel thread bound to producer_cpu
+// wakes up on an hrtimer and writes burst records per wakeup, rate records
+// per second on average, through the same api; each payload starts with a
+// u32 sequence number, so consumers can find drops from gaps in it, and is
+// of a uniformly distributed size between record_size_min and
+// record_size_max
+//
+// insmod chardev.ko producer=1 producer_rate=100000 producer_burst=16
+// cat /sys/class/chardev/chardev/producer/drops
+//
+// when the ring has no room for a record, the producer drops it, or with
+// producer_block=1 waits until the reader makes room (backpressure); drops,
+// stalls and late wakeups are counted in the producer attribute group of the
+// device; the pacing parameters can be changed while the module is loaded
+
+#define CHARDEV_RING_SIZE 65536
+#define CHARDEV_RING_SIZE_MIN 16384
+#define CHARDEV_RING_ALIGN 8
+#define CHARDEV_RING_COMMITTED 0x1
+#define CHARDEV_RING_DISCARDED 0x2
+#define CHARDEV_RING_FLAGS (CHARDEV_RING_COMMITTED | CHARDEV_RING_DISCARDED)
+
+#define CHARDEV_PRODUCER_NAME "chardev-producer"
+#define CHARDEV_PRODUCER_IDLE_MS 100
+
+struct chardev_ring_entry {
+    u32 size;
+    u32 length;
+    u64 timestamp_ns;
+    u8 payload[];
+};
+
+struct chardev_ring {
+    local_t head;
+    local_t commit;
+    local_t nesting;
+    local_t drops;
+    unsigned long tail;
+    unsigned int cpu;
+    u8* data;
+    struct irq_work wakeup;
+};
+
+static DEFINE_PER_CPU(struct chardev_ring, chardev_rings);
+static DEFINE_MUTEX(chardev_stream_lock);
+static DECLARE_WAIT_QUEUE_HEAD(chardev_stream_wait);
+static bool chardev_stream_waiting = false;
+
+static bool chardev_param_stream = false;
+module_param_named(stream, chardev_param_stream, bool, 0444);
+MODULE_PARM_DESC(stream, "read records from the producer api instead of the open message");
+
+static unsigned int chardev_param_stream_ring_size = CHARDEV_RING_SIZE;
+module_param_named(stream_ring_size, chardev_param_stream_ring_size, uint, 0444);
+MODULE_PARM_DESC(stream_ring_size, "bytes buffered per cpu in stream mode, a power of two");
+
+static bool chardev_param_producer = false;
+module_param_named(producer, chardev_param_producer, bool, 0444);
+MODULE_PARM_DESC(producer, "stream records from a synthetic producer thread");
+
+static unsigned int chardev_param_producer_cpu = 0;
+module_param_named(producer_cpu, chardev_param_producer_cpu, uint, 0444);
+MODULE_PARM_DESC(producer_cpu, "cpu the producer thread runs on");
+
+static unsigned int chardev_param_producer_rate = 1000;
+module_param_named(producer_rate, chardev_param_producer_rate, uint, 0644);
+MODULE_PARM_DESC(producer_rate, "records per second, 0 pauses the producer");
+
+static unsigned int chardev_param_producer_burst = 1;
+module_param_named(producer_burst, chardev_param_producer_burst, uint, 0644);
+MODULE_PARM_DESC(producer_burst, "records written per timer wakeup");
+
+static unsigned int chardev_param_record_size_min = 64;
+module_param_named(record_size_min, chardev_param_record_size_min, uint, 0644);
+MODULE_PARM_DESC(record_size_min, "smallest record payload in bytes (at least 4)");
+
+static unsigned int chardev_param_record_size_max = 64;
+module_param_named(record_size_max, chardev_param_record_size_max, uint, 0644);
+MODULE_PARM_DESC(record_size_max, "largest record payload in bytes (at most 4096)");
+
+static bool chardev_param_producer_block = false;
+module_param_named(producer_block, chardev_param_producer_block, bool, 0644);
+MODULE_PARM_DESC(producer_block, "wait for the reader when the ring is full instead of dropping records");
+
+static DECLARE_WAIT_QUEUE_HEAD(chardev_producer_wait);
+static struct task_struct* chardev_producer_task = NULL;
+
+struct chardev_producer_stats {
+    atomic64_t records;
+    atomic64_t bytes;
+    atomic64_t drops;
+    atomic64_t stalls;
+    atomic64_t stall_ns;
+    atomic64_t late;
+};
+
+static struct chardev_producer_stats chardev_producer_stats = {};
+
+static int chardev_stream_create(void);
+static void chardev_stream_destroy(void);
+static void chardev_stream_wakeup(struct irq_work*);
+static void chardev_ring_end(struct chardev_ring*);
+static size_t chardev_ring_free(struct chardev_ring*);
+static void* chardev_ring_reserve(struct chardev_reservation*, size_t, bool);
+static void chardev_ring_drop(void);
+static struct chardev_ring_entry* chardev_ring_entry(struct chardev_ring*, unsigned long);
+static struct chardev_ring* chardev_stream_next(void);
+static ssize_t chardev_stream_read(struct file*, char __user*, size_t, loff_t*);
+static int chardev_producer_thread(void*);
+static void chardev_producer_emit(u32);
+
+// /sys/class/chardev/chardev/stream/drops counts the records given up
+// because their ring was full or stream mode was off; a producer that waits
+// for room only counts the ones it never wrote
+
+static ssize_t chardev_stream_drops_show(struct device* dev, struct device_attribute* attr, char* buffer) {
+
+    long drops = 0;
+    int cpu = 0;
+
+    for_each_possible_cpu(cpu) {
+        drops += local_read(&per_cpu_ptr(&chardev_rings, cpu)->drops);
+    }
+
+    return sysfs_emit(buffer, "%ld\n", drops);
+
+}
+
+// /sys/class/chardev/chardev/stream/pending counts the bytes of ring entries
+// that were committed but not read yet
+
+static ssize_t chardev_stream_pending_show(struct device* dev, struct device_attribute* attr, char* buffer) {
+
+    unsigned long pending = 0;
+    int cpu = 0;
+
+    if (!chardev_param_stream) {
+        return sysfs_emit(buffer, "0\n");
+    }
+
+    for_each_possible_cpu(cpu) {
+        struct chardev_ring* ring = per_cpu_ptr(&chardev_rings, cpu);
+        pending += local_read(&ring->commit) - READ_ONCE(ring->tail);
+    }
+
+    return sysfs_emit(buffer, "%lu\n", pending);
+
+}
+
+static struct device_attribute chardev_stream_drops_attr = __ATTR(drops, 0444, chardev_stream_drops_show, NULL);
+static struct device_attribute chardev_stream_pending_attr = __ATTR(pending, 0444, chardev_stream_pending_show, NULL);
+
+static struct attribute* chardev_stream_attrs[] = {
+    &chardev_stream_drops_attr.attr,
+    &chardev_stream_pending_attr.attr,
+    NULL,
+};
+
+static const struct attribute_group chardev_stream_group = {
+    .name = "stream",
+    .attrs = chardev_stream_attrs,
+};
+
+// /sys/class/chardev/chardev/producer/<name> shows one counter
+
+#define CHARDEV_PRODUCER_ATTR(name) \
+    static ssize_t chardev_producer_##name##_show(struct device* dev, struct device_attribute* attr, char* buffer) { \
+        return sysfs_emit(buffer, "%lld\n", (long long) atomic64_read(&chardev_producer_stats.name)); \
+    } \
+    static struct device_attribute chardev_producer_##name##_attr = __ATTR(name, 0444, chardev_producer_##name##_show, NULL)
+
+CHARDEV_PRODUCER_ATTR(records);
+CHARDEV_PRODUCER_ATTR(bytes);
+CHARDEV_PRODUCER_ATTR(drops);
+CHARDEV_PRODUCER_ATTR(stalls);
+CHARDEV_PRODUCER_ATTR(stall_ns);
+CHARDEV_PRODUCER_ATTR(late);
+
+static struct attribute* chardev_producer_attrs[] = {
+    &chardev_producer_records_attr.attr,
+    &chardev_producer_bytes_attr.attr,
+    &chardev_producer_drops_attr.attr,
+    &chardev_producer_stalls_attr.attr,
+    &chardev_producer_stall_ns_attr.attr,
+    &chardev_producer_late_attr.attr,
+    NULL,
+};
+
+static const struct attribute_group chardev_producer_group = {
+    .name = "producer",
+    .attrs = chardev_producer_attrs,
+};
+
+static const struct attribute_group* chardev_device_groups[] = {
+    &chardev_stream_group,
+    &chardev_producer_group,
+    NULL,
+};
+
 int __init init_chardev(void) {
 
     int rc = 0;
@@ -59,11 +318,29 @@ int __init init_chardev(void) {
         pr_info("[%s] Initializing character device\n", CHARDEV_DEVICE_NAME);
     }
 
+    // the rings are allocated before the device exists so that readers never
+    // see stream mode without them
+
+    if (chardev_param_producer) {
+
+        if (chardev_param_producer_cpu >= nr_cpu_ids || !cpu_online(chardev_param_producer_cpu)) {
+            pr_alert("[%s] Producer cpu %u is not online\n", CHARDEV_DEVICE_NAME, chardev_param_producer_cpu);
+            return -EINVAL;
+        }
+
+        chardev_param_stream = true;
+
+    }
+
+    if (chardev_param_stream && (rc = chardev_stream_create())) {
+        return rc;
+    }
+
     // allocate a range of device numbers
 
     if ((rc = alloc_chrdev_region(&chardev_number, 0, 1, CHARDEV_DEVICE_NAME)) < 0) {
         pr_alert("[%s] Failed to allocate device numbers for character device with error code %d\n", CHARDEV_DEVICE_NAME, rc);
-        return rc;
+        goto CHARDEV_INIT_EXIT_STREAM;
     }
 
     if (debug) {
@@ -81,7 +358,8 @@ int __init init_chardev(void) {
     if (IS_ERR(chardev_class)) {
         unregister_chrdev_region(chardev_number, 1);
         pr_alert("[%s] Failed to create device class for character device\n", CHARDEV_DEVICE_NAME);
-        return PTR_ERR(chardev_class);
+        rc = PTR_ERR(chardev_class);
+        goto CHARDEV_INIT_EXIT_STREAM;
     }
 
     if (debug) {
@@ -97,29 +375,70 @@ int __init init_chardev(void) {
         class_destroy(chardev_class);
         unregister_chrdev_region(chardev_number, 1);
         pr_alert("[%s] Failed to initialize or register cdev structure for character device\n", CHARDEV_DEVICE_NAME);
-        return rc;
+        goto CHARDEV_INIT_EXIT_STREAM;
     }
 
     if (debug) {
         pr_info("[%s] Initialized and registered cdev struct for character device\n", CHARDEV_DEVICE_NAME);
     }
 
-    // create device node and register it with sysfs
+    // create device node and register it with sysfs, together with the
+    // producer counters
 
-    chardev_device = device_create(chardev_class, NULL, chardev_number, NULL, CHARDEV_DEVICE_NAME);
+    chardev_device = device_create_with_groups(chardev_class, NULL, chardev_number, NULL, chardev_device_groups, CHARDEV_DEVICE_NAME);
 
     if (IS_ERR(chardev_device)) {
         cdev_del(&chardev_cdev);
         class_destroy(chardev_class);
         unregister_chrdev_region(chardev_number, 1);
         pr_alert("[%s] Failed to create or register character device\n", CHARDEV_DEVICE_NAME);
-        return PTR_ERR(chardev_device);
+        rc = PTR_ERR(chardev_device);
+        goto CHARDEV_INIT_EXIT_STREAM;
     }
 
     if (debug) {
         pr_info("[%s] Created and registered character device\n", CHARDEV_DEVICE_NAME);
     }
 
+    // the histograms are diagnostics only, so the device works without them
+
+    if (lkmpg_latency_register(&chardev_latency_set, CHARDEV_DEVICE_NAME, chardev_latency, CHARDEV_LATENCY_COUNT)) {
+        pr_alert("[%s] Failed to create latency histograms for character device\n", CHARDEV_DEVICE_NAME);
+    }
+
+    // bound to one cpu, the producer keeps writing into the same ring, so
+    // its records are read in order and backpressure knows which ring to
+    // wait for
+
+    if (chardev_param_producer) {
+
+        chardev_producer_task = kthread_create(chardev_producer_thread, NULL, CHARDEV_PRODUCER_NAME);
+
+        if (IS_ERR(chardev_producer_task)) {
+            rc = PTR_ERR(chardev_producer_task);
+            chardev_producer_task = NULL;
+            lkmpg_latency_unregister(&chardev_latency_set);
+            device_destroy(chardev_class, chardev_number);
+            cdev_del(&chardev_cdev);
+            class_destroy(chardev_class);
+            unregister_chrdev_region(chardev_number, 1);
+            pr_alert("[%s] Failed to start producer thread\n", CHARDEV_DEVICE_NAME);
+            goto CHARDEV_INIT_EXIT_STREAM;
+        }
+
+        kthread_bind(chardev_producer_task, chardev_param_producer_cpu);
+        wake_up_process(chardev_producer_task);
+
+    }
+
+    return 0;
+
+CHARDEV_INIT_EXIT_STREAM:
+
+    if (chardev_param_stream) {
+        chardev_stream_destroy();
+    }
+
     return rc;
 
 }
@@ -130,24 +449,35 @@ void __exit exit_chardev(void) {
         pr_info("[%s] Destroying character device\n", CHARDEV_DEVICE_NAME);
     }
 
+    // the device cannot be open and no module using the producer api can be
+    // loaded here, so only the producer can still touch the rings
+
+    if (chardev_producer_task) {
+        kthread_stop(chardev_producer_task);
+    }
+
     // most cleanup functions do not require checking for null
 
+    lkmpg_latency_unregister(&chardev_latency_set);
     cdev_del(&chardev_cdev);
     device_destroy(chardev_class, chardev_number);
     class_destroy(chardev_class);
     unregister_chrdev_region(chardev_number, 1);
 
+    if (chardev_param_stream) {
+        chardev_stream_destroy();
+    }
+
 }
 
 int chardev_device_open(struct inode* inode, struct file* filp) {
 
-    if (debug) {
-        pr_info("[%s] Opening character device file\n", CHARDEV_DEVICE_NAME);
-    }
-
     // called when a process opens the device file
 
     static unsigned counter = 0;
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
 
     // if chardev_already_open is CHARDEV_NOT_OPEN then atomically set it to
     // CHARDEV_OPEN and return CHARDEV_NOT_OPEN (in which case the conditional
@@ -158,61 +488,97 @@ int chardev_device_open(struct inode* inode, struct file* filp) {
 
     if (atomic_cmpxchg(&chardev_already_open, CHARDEV_NOT_OPEN, CHARDEV_OPEN)) {
         pr_alert("[%s] Failed to open character device file\n", CHARDEV_DEVICE_NAME);
+        trace_chardev_open(filp, -EBUSY);
+        lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_OPEN], &timer);
         return -EBUSY;
     }
 
-    // sprintf is safe because the atomic lock ensures only one opener
-
-    snprintf(chardev_message_buffer, sizeof(chardev_message_buffer), "[%s] Character device file has been opened %d times\n", CHARDEV_DEVICE_NAME, ++counter);
-
-    // this is safe because the atomic lock ensures only one opener
-    // sprintf is safe because the message will not overrun the buffer by construction
-
-    sprintf(chardev_message_buffer, "[%s] Character device file has been opened %d times\n", CHARDEV_DEVICE_NAME, ++counter);
-
     // attempt to increment reference count
 
     if (!try_module_get(THIS_MODULE)) {
+        atomic_set(&chardev_already_open, CHARDEV_NOT_OPEN);
         pr_alert("[%s] Failed to increment reference count for character device file\n", CHARDEV_DEVICE_NAME);
+        trace_chardev_open(filp, -ENODEV);
+        lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_OPEN], &timer);
         return -ENODEV;
     }
 
+    // stream mode reads records instead of a message
+
+    if (chardev_param_stream) {
+        filp->private_data = NULL;
+        trace_chardev_open(filp, 0);
+        lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_OPEN], &timer);
+        return 0;
+    }
+
+    // the message only lives while the device is open, so no memory is held
+    // for it while nobody reads; the counter is safe to update because the
+    // atomic lock ensures only one opener
+
+    filp->private_data = kmalloc(CHARDEV_BUFFER_LEN + 1, GFP_KERNEL);
+
+    if (!filp->private_data) {
+        module_put(THIS_MODULE);
+        atomic_set(&chardev_already_open, CHARDEV_NOT_OPEN);
+        pr_alert("[%s] Failed to allocate message buffer for character device file\n", CHARDEV_DEVICE_NAME);
+        trace_chardev_open(filp, -ENOMEM);
+        lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_OPEN], &timer);
+        return -ENOMEM;
+    }
+
+    snprintf(filp->private_data, CHARDEV_BUFFER_LEN + 1, "[%s] Character device file has been opened %d times\n", CHARDEV_DEVICE_NAME, ++counter);
+
+    trace_chardev_open(filp, 0);
+    lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_OPEN], &timer);
+
     return 0;
 
 }
 
 int chardev_device_release(struct inode* inode, struct file* file) {
 
-    if (debug) {
-        pr_info("[%s] Closing character device file\n", CHARDEV_DEVICE_NAME);
-    }
-
     // called when a process closes the device file
 
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+    kfree(file->private_data);
     atomic_set(&chardev_already_open, CHARDEV_NOT_OPEN);
 
     // decrement reference count
 
     module_put(THIS_MODULE);
 
+    trace_chardev_release(file, 0);
+    lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_RELEASE], &timer);
+
     return 0;
 
 }
 
 ssize_t chardev_device_read(struct file* file, char* buffer, size_t length, loff_t* offset) {
 
-    if (debug) {
-        pr_info("[%s] Reading character device file\n", CHARDEV_DEVICE_NAME);
-    }
-
     // called when a process reads from an open device file
 
-    ssize_t message_length = strlen(chardev_message_buffer);
+    ssize_t retval = 0;
+    loff_t position = *offset;
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    if (chardev_param_stream) {
+        retval = chardev_stream_read(file, buffer, length, offset);
+        goto CHARDEV_DEVICE_READ_EXIT;
+    }
+
+    const char* message = file->private_data;
+    ssize_t message_length = strlen(message);
 
     // return EOF if nothing to read (null terminator not counted)
 
     if (message_length <= *offset) {
-        return 0;
+        goto CHARDEV_DEVICE_READ_EXIT;
     }
 
     // number of bytes to read from message buffer
@@ -226,18 +592,441 @@ ssize_t chardev_device_read(struct file* file, char* buffer, size_t length, loff
     // return EOF if nothing to read
 
     if (!bytes_to_read) {
-        return 0;
+        goto CHARDEV_DEVICE_READ_EXIT;
     }
 
     // copy specified number of bytes to userspace
 
-    if (copy_to_user(buffer, &chardev_message_buffer[*offset], bytes_to_read)) {
-        return -EFAULT;
+    if (copy_to_user(buffer, &message[*offset], bytes_to_read)) {
+        retval = -EFAULT;
+        goto CHARDEV_DEVICE_READ_EXIT;
     }
 
     *offset += bytes_to_read;
+    retval = bytes_to_read;
+
+CHARDEV_DEVICE_READ_EXIT:
+
+    trace_chardev_read(file, length, position, retval);
+    lkmpg_latency_stop(&chardev_latency[CHARDEV_LATENCY_READ], &timer);
+    return retval;
+
+}
+
+int chardev_stream_create(void) {
+
+    int cpu = 0;
+
+    if (!is_power_of_2(chardev_param_stream_ring_size) || chardev_param_stream_ring_size < CHARDEV_RING_SIZE_MIN) {
+        pr_alert("[%s] Stream ring size %u is not a power of two of at least %d\n", CHARDEV_DEVICE_NAME, chardev_param_stream_ring_size, CHARDEV_RING_SIZE_MIN);
+        return -EINVAL;
+    }
+
+    // each ring lives on the node of its cpu, since only that cpu writes it
+
+    for_each_possible_cpu(cpu) {
+
+        struct chardev_ring* ring = per_cpu_ptr(&chardev_rings, cpu);
+
+        ring->cpu = cpu;
+        ring->data = kzalloc_node(chardev_param_stream_ring_size, GFP_KERNEL, cpu_to_node(cpu));
+
+        if (!ring->data) {
+            chardev_stream_destroy();
+            pr_alert("[%s] Failed to allocate stream ring for cpu %d\n", CHARDEV_DEVICE_NAME, cpu);
+            return -ENOMEM;
+        }
+
+        init_irq_work(&ring->wakeup, chardev_stream_wakeup);
+
+    }
+
+    return 0;
+
+}
+
+void chardev_stream_destroy(void) {
+
+    int cpu = 0;
+
+    for_each_possible_cpu(cpu) {
+
+        struct chardev_ring* ring = per_cpu_ptr(&chardev_rings, cpu);
+
+        if (ring->data) {
+            irq_work_sync(&ring->wakeup);
+            kfree(ring->data);
+            ring->data = NULL;
+        }
+
+    }
+
+}
+
+void chardev_stream_wakeup(struct irq_work* work) {
 
-    return bytes_to_read;
+    // producers in nmi context cannot wake the reader themselves, so the
+    // wakeup runs from an interrupt they raise
+
+    wake_up_interruptible(&chardev_stream_wait);
+
+}
+
+struct chardev_ring_entry* chardev_ring_entry(struct chardev_ring* ring, unsigned long position) {
+    return (struct chardev_ring_entry*) (ring->data + (position & (chardev_param_stream_ring_size - 1)));
+}
+
+size_t chardev_ring_free(struct chardev_ring* ring) {
+    return chardev_param_stream_ring_size - (local_read(&ring->head) - smp_load_acquire(&ring->tail));
+}
+
+void* chardev_reserve(struct chardev_reservation* reservation, size_t length) {
+    return chardev_ring_reserve(reservation, length, true);
+}
+EXPORT_SYMBOL_GPL(chardev_reserve);
+
+void* chardev_ring_reserve(struct chardev_reservation* reservation, size_t length, bool drop) {
+
+    // a caller that retries a failed reservation passes drop = false and
+    // counts the record with chardev_ring_drop() only once it gives up
+
+    struct chardev_ring* ring = NULL;
+    struct chardev_ring_entry* entry = NULL;
+    unsigned long size = ALIGN(sizeof(*entry) + length, CHARDEV_RING_ALIGN);
+    unsigned long head = 0;
+    unsigned long index = 0;
+    unsigned long gap = 0;
+
+    preempt_disable_notrace();
+    ring = this_cpu_ptr(&chardev_rings);
+
+    if (!chardev_param_stream || length > CHARDEV_RECORD_SIZE_MAX) {
+        if (drop) {
+            local_inc(&ring->drops);
+        }
+        preempt_enable_notrace();
+        return NULL;
+    }
+
+    local_inc(&ring->nesting);
+
+    // an interrupt that reserves meanwhile claims the space after head, so
+    // head is claimed with a cmpxchg that retries until nothing interrupted
+
+    do {
+
+        head = local_read(&ring->head);
+        index = head & (chardev_param_stream_ring_size - 1);
+        gap = index + size > chardev_param_stream_ring_size ? chardev_param_stream_ring_size - index : 0;
+
+        if (head + gap + size - smp_load_acquire(&ring->tail) > chardev_param_stream_ring_size) {
+            if (drop) {
+                local_inc(&ring->drops);
+            }
+            chardev_ring_end(ring);
+            return NULL;
+        }
+
+    } while ((unsigned long) local_cmpxchg(&ring->head, head, head + gap + size) != head);
+
+    // entries are aligned, so the gap always has room for the size of the
+    // discarded entry that covers it
+
+    if (gap) {
+        chardev_ring_entry(ring, head)->size = gap | CHARDEV_RING_COMMITTED | CHARDEV_RING_DISCARDED;
+    }
+
+    entry = chardev_ring_entry(ring, head + gap);
+    entry->size = size;
+    entry->length = length;
+    entry->timestamp_ns = ktime_get_mono_fast_ns();
+
+    reservation->ring = ring;
+    reservation->entry = entry;
+
+    return entry->payload;
+
+}
+
+void chardev_ring_drop(void) {
+
+    preempt_disable_notrace();
+    local_inc(&this_cpu_ptr(&chardev_rings)->drops);
+    preempt_enable_notrace();
+
+}
+
+void chardev_commit(struct chardev_reservation* reservation) {
+
+    struct chardev_ring_entry* entry = reservation->entry;
+
+    entry->size |= CHARDEV_RING_COMMITTED;
+    chardev_ring_end(reservation->ring);
+
+}
+EXPORT_SYMBOL_GPL(chardev_commit);
+
+void chardev_discard(struct chardev_reservation* reservation) {
+
+    struct chardev_ring_entry* entry = reservation->entry;
+
+    entry->size |= CHARDEV_RING_COMMITTED | CHARDEV_RING_DISCARDED;
+    chardev_ring_end(reservation->ring);
+
+}
+EXPORT_SYMBOL_GPL(chardev_discard);
+
+void chardev_ring_end(struct chardev_ring* ring) {
+
+    unsigned long commit = 0;
+    u32 size = 0;
+
+    // entries are only published once no reservation is in progress on the
+    // cpu, since one could still be filling in an entry in front of them;
+    // interrupts that reserve meanwhile publish their own entries
+
+    barrier();
+
+    if (local_dec_return(&ring->nesting)) {
+        preempt_enable_notrace();
+        return;
+    }
+
+    while ((commit = local_read(&ring->commit)) != (unsigned long) local_read(&ring->head)) {
+
+        size = READ_ONCE(chardev_ring_entry(ring, commit)->size);
+
+        if (!(size & CHARDEV_RING_COMMITTED)) {
+            break;
+        }
+
+        // the entry must be complete before a reader on another cpu sees it
+
+        smp_wmb();
+        local_cmpxchg(&ring->commit, commit, commit + (size & ~CHARDEV_RING_FLAGS));
+
+    }
+
+    // pairs with the barrier in chardev_stream_read() between setting
+    // chardev_stream_waiting and looking for records
+
+    smp_mb();
+
+    if (READ_ONCE(chardev_stream_waiting)) {
+        irq_work_queue(&ring->wakeup);
+    }
+
+    preempt_enable_notrace();
+
+}
+
+struct chardev_ring* chardev_stream_next(void) {
+
+    // returns the ring whose first unread record is the oldest of all, or
+    // null when no record is committed; discarded entries in front of the
+    // rings are skipped on the way
+
+    struct chardev_ring* next = NULL;
+    u64 oldest = 0;
+    int cpu = 0;
+
+    for_each_possible_cpu(cpu) {
+
+        struct chardev_ring* ring = per_cpu_ptr(&chardev_rings, cpu);
+        struct chardev_ring_entry* entry = NULL;
+        unsigned long commit = local_read(&ring->commit);
+
+        // pairs with the barrier in chardev_ring_end() before commit moves
+
+        smp_rmb();
+
+        while (ring->tail != commit) {
+
+            entry = chardev_ring_entry(ring, ring->tail);
+
+            if (!(entry->size & CHARDEV_RING_DISCARDED)) {
+                break;
+            }
+
+            smp_store_release(&ring->tail, ring->tail + (entry->size & ~CHARDEV_RING_FLAGS));
+            entry = NULL;
+
+        }
+
+        if (entry && (!next || entry->timestamp_ns < oldest)) {
+            next = ring;
+            oldest = entry->timestamp_ns;
+        }
+
+    }
+
+    return next;
+
+}
+
+ssize_t chardev_stream_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+
+    // reads return whole records, as many as fit in length, and fail with
+    // EINVAL when not even the next one does; 4112 bytes always fit one
+
+    int rc = 0;
+    size_t copied = 0;
+    struct chardev_ring* ring = NULL;
+
+    if (mutex_lock_interruptible(&chardev_stream_lock)) {
+        return -ERESTARTSYS;
+    }
+
+    if (!chardev_stream_next()) {
+
+        if (file->f_flags & O_NONBLOCK) {
+            rc = -EAGAIN;
+            goto CHARDEV_STREAM_READ_EXIT;
+        }
+
+        // producers look at chardev_stream_waiting after publishing records,
+        // so either they see it set or the records are seen here
+
+        WRITE_ONCE(chardev_stream_waiting, true);
+        smp_mb();
+        rc = wait_event_interruptible(chardev_stream_wait, chardev_stream_next());
+        WRITE_ONCE(chardev_stream_waiting, false);
+
+        if (rc) {
+            goto CHARDEV_STREAM_READ_EXIT;
+        }
+
+    }
+
+    while ((ring = chardev_stream_next())) {
+
+        struct chardev_ring_entry* entry = chardev_ring_entry(ring, ring->tail);
+        struct chardev_stream_header header = {
+            .length = entry->length,
+            .cpu = ring->cpu,
+            .timestamp_ns = entry->timestamp_ns,
+        };
+
+        if (sizeof(header) + header.length > length - copied) {
+            break;
+        }
+
+        if (copy_to_user(buffer + copied, &header, sizeof(header)) || copy_to_user(buffer + copied + sizeof(header), entry->payload, header.length)) {
+            rc = -EFAULT;
+            break;
+        }
+
+        copied += sizeof(header) + header.length;
+
+        // producers reuse the entry as soon as tail moves past it
+
+        smp_store_release(&ring->tail, ring->tail + (entry->size & ~CHARDEV_RING_FLAGS));
+
+    }
+
+    if (copied) {
+        *offset += copied;
+        wake_up_interruptible(&chardev_producer_wait);
+    } else if (!rc) {
+        rc = -EINVAL;
+    }
+
+CHARDEV_STREAM_READ_EXIT:
+
+    mutex_unlock(&chardev_stream_lock);
+    return copied ? (ssize_t) copied : rc;
+
+}
+
+void chardev_producer_emit(u32 sequence) {
+
+    struct chardev_reservation reservation;
+    struct chardev_ring* ring = per_cpu_ptr(&chardev_rings, chardev_param_producer_cpu);
+    unsigned int size_min = clamp_t(unsigned int, READ_ONCE(chardev_param_record_size_min), sizeof(u32), CHARDEV_RECORD_SIZE_MAX);
+    unsigned int size_max = clamp_t(unsigned int, READ_ONCE(chardev_param_record_size_max), size_min, CHARDEV_RECORD_SIZE_MAX);
+    unsigned int length = size_min + (size_max > size_min ? get_random_u32() % (size_max - size_min + 1) : 0);
+    bool block = READ_ONCE(chardev_param_producer_block);
+    u8* payload = chardev_ring_reserve(&reservation, length, !block);
+    u64 stall = 0;
+
+    // a ring with twice the size of the entry free has room for it and for
+    // any gap in front of it
+
+    if (!payload && block) {
+
+        stall = ktime_get_ns();
+        atomic64_inc(&chardev_producer_stats.stalls);
+
+        do {
+            wait_event_interruptible(chardev_producer_wait, chardev_ring_free(ring) >= 2 * ALIGN(sizeof(struct chardev_ring_entry) + length, CHARDEV_RING_ALIGN) || kthread_should_stop());
+        } while (!kthread_should_stop() && !(payload = chardev_ring_reserve(&reservation, length, false)));
+
+        atomic64_add(ktime_get_ns() - stall, &chardev_producer_stats.stall_ns);
+
+        // only a producer stopped while it waits gives the record up
+
+        if (!payload) {
+            chardev_ring_drop();
+        }
+
+    }
+
+    if (!payload) {
+        atomic64_inc(&chardev_producer_stats.drops);
+        return;
+    }
+
+    *(u32*) payload = sequence;
+    memset(payload + sizeof(u32), (u8) sequence, length - sizeof(u32));
+    chardev_commit(&reservation);
+
+    atomic64_inc(&chardev_producer_stats.records);
+    atomic64_add(length, &chardev_producer_stats.bytes);
+
+}
+
+int chardev_producer_thread(void* data) {
+
+    u32 sequence = 0;
+    ktime_t deadline = ktime_get();
+
+    while (!kthread_should_stop()) {
+
+        unsigned int rate = READ_ONCE(chardev_param_producer_rate);
+        unsigned int burst = max(READ_ONCE(chardev_param_producer_burst), 1U);
+        ktime_t now = 0;
+
+        if (!rate) {
+            schedule_timeout_interruptible(msecs_to_jiffies(CHARDEV_PRODUCER_IDLE_MS));
+            deadline = ktime_get();
+            continue;
+        }
+
+        // one burst per period keeps the average at rate records per second;
+        // deadlines are absolute so that the time spent writing records does
+        // not slow the rate down, and a producer that fell more than a period
+        // behind starts over from now instead of catching up in one burst;
+        // the sleep has no slack, since the default slack of a thread would
+        // delay every period by up to 50us and lower the rate at high rates
+
+        deadline = ktime_add_ns(deadline, div_u64((u64) burst * NSEC_PER_SEC, rate));
+        now = ktime_get();
+
+        if (ktime_before(deadline, now)) {
+            atomic64_inc(&chardev_producer_stats.late);
+            deadline = now;
+        } else {
+            set_current_state(TASK_INTERRUPTIBLE);
+            schedule_hrtimeout_range(&deadline, 0, HRTIMER_MODE_ABS);
+        }
+
+        for (unsigned int i = 0; i < burst && !kthread_should_stop(); ++i) {
+            chardev_producer_emit(sequence++);
+        }
+
+    }
+
+    return 0;
 
 }
 
@@ -0,0 +1,54 @@
+#ifndef CHARDEV_H
+#define CHARDEV_H
+
+// producer api for other modules to stream records to readers of
+// /dev/chardev
+//
+// records are written into per-cpu rings without locks or waiting, so the
+// api can be called from any context, hard interrupts and nmis included; a
+// reservation fails (and is counted as a drop) when the ring of the cpu is
+// full or when chardev was loaded without stream=1
+//
+//     struct chardev_reservation reservation;
+//     struct my_event* event = chardev_reserve(&reservation, sizeof(*event));
+//
+//     if (event) {
+//         event->value = value;
+//         chardev_commit(&reservation);
+//     }
+//
+// preemption is disabled from chardev_reserve() until the reservation is
+// committed or discarded, so the code in between must not sleep; a
+// reservation made from an interrupt must end before the one it interrupted
+// does, which interrupts always do
+//
+// every record reads as a struct chardev_stream_header followed by length
+// bytes of payload, in native byte order; records of one cpu are read in the
+// order they were reserved, and records of different cpus are merged by
+// timestamp
+//
+// modules using the api build with KBUILD_EXTRA_SYMBOLS pointing at the
+// Module.symvers of 04-chardev
+
+#include <linux/types.h>
+
+#define CHARDEV_RECORD_SIZE_MAX 4096
+
+struct chardev_stream_header {
+    u32 length;
+    u32 cpu;
+    u64 timestamp_ns;
+};
+
+struct chardev_reservation {
+    void* ring;
+    void* entry;
+};
+
+// returns length bytes to fill in, or null when the record is dropped
+
+void* chardev_reserve(struct chardev_reservation* reservation, size_t length);
+void chardev_commit(struct chardev_reservation* reservation);
+void chardev_discard(struct chardev_reservation* reservation);
+
+#endif
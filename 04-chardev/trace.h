@@ -0,0 +1,36 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM chardev
+
+// tracepoints for the chardev device file, enabled at runtime with
+//
+// echo 1 > /sys/kernel/tracing/events/chardev/enable
+// perf trace -e 'chardev:*'
+
+#if !defined(_CHARDEV_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _CHARDEV_TRACE_H
+
+#include "lkmpg-trace.h"
+
+DEFINE_EVENT(lkmpg_file, chardev_open,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_file, chardev_release,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, chardev_read,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+#include <trace/define_trace.h>
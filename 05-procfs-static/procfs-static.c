@@ -1,13 +1,22 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/init.h>
+#include <linux/firmware.h>
+#include <linux/mm.h>
 #include <linux/proc_fs.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/errno.h>
 #include <linux/version.h>
 #include <linux/moduleparam.h>
 #include <linux/minmax.h>
 
+#include "lkmpg-buffer.h"
+#include "lkmpg-latency.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
 MODULE_DESCRIPTION("05-procfs-static");
@@ -19,21 +28,42 @@ MODULE_VERSION("0.1");
 
 static int __init procfs_static_init(void);
 static void __exit procfs_static_exit(void);
+static int procfs_static_load(void);
 
 // static buffer with read-only access
 
 static const char procfs_static_buffer[] = "Hello, World!";
 static const size_t procfs_static_buffer_length = sizeof(procfs_static_buffer) - 1;
 
+// large read-only datasets (lookup tables, certificate bundles) are served
+// instead of the buffer by naming a file under /lib/firmware:
+//
+// insmod procfs-static.ko firmware=lkmpg/table.bin
+//
+// the contents are copied once at load into vmalloc_user() pages, which are
+// never swapped out or moved, so reads, splice() and sendfile() copy straight
+// from them and mmap() maps them into the reader without copying at all
+
+static char* procfs_static_param_firmware = NULL;
+module_param_named(firmware, procfs_static_param_firmware, charp, 0444);
+MODULE_PARM_DESC(firmware, "Serve this file from the firmware search path instead of the built-in buffer");
+
+static char* procfs_static_data = NULL;
+static size_t procfs_static_size = 0;
+
 // struct proc_ops defined in linux/proc_fs.h
 
-static ssize_t procfs_static_proc_read(struct file*, char __user*, size_t, loff_t*);
+static ssize_t procfs_static_proc_read_iter(struct kiocb*, struct iov_iter*);
 static int procfs_static_proc_open(struct inode*, struct file*);
+static loff_t procfs_static_proc_lseek(struct file*, loff_t, int);
+static int procfs_static_proc_mmap(struct file*, struct vm_area_struct*);
 static int procfs_static_proc_release(struct inode*, struct file*);
 
 static const struct proc_ops procfs_static_proc_ops = {
-    .proc_read = procfs_static_proc_read,
+    .proc_read_iter = procfs_static_proc_read_iter,
     .proc_open = procfs_static_proc_open,
+    .proc_lseek = procfs_static_proc_lseek,
+    .proc_mmap = procfs_static_proc_mmap,
     .proc_release = procfs_static_proc_release
 };
 
@@ -41,7 +71,28 @@ static const struct proc_ops procfs_static_proc_ops = {
 
 static struct proc_dir_entry* procfs_static_proc_file = NULL;
 
-// enable debug messages
+// per-operation latency histograms, built with LATENCY=1; the buffer is
+// read-only and takes no lock, so only service times are recorded
+
+enum {
+    PROCFS_STATIC_LATENCY_OPEN,
+    PROCFS_STATIC_LATENCY_READ,
+    PROCFS_STATIC_LATENCY_SEEK,
+    PROCFS_STATIC_LATENCY_RELEASE,
+    PROCFS_STATIC_LATENCY_COUNT
+};
+
+static struct lkmpg_latency procfs_static_latency[PROCFS_STATIC_LATENCY_COUNT] = {
+    [PROCFS_STATIC_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [PROCFS_STATIC_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [PROCFS_STATIC_LATENCY_SEEK] = LKMPG_LATENCY_OP("seek"),
+    [PROCFS_STATIC_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+};
+
+static struct lkmpg_latency_set procfs_static_latency_set;
+
+// enable debug messages during initialization and cleanup; file operations
+// are traced through the procfs_static tracepoints instead
 
 static bool debug = false;
 module_param(debug, bool, 0);
@@ -49,17 +100,35 @@ MODULE_PARM_DESC(debug, "Enable debug messages");
 
 int __init procfs_static_init(void) {
 
+    int rc = 0;
+
+    // the contents are in place before the file exists, so readers never see
+    // it empty
+
+    if ((rc = procfs_static_load())) {
+        return rc;
+    }
+
     procfs_static_proc_file = proc_create(PROCFS_STATIC_FILE_NAME, PROCFS_STATIC_FILE_PERMS, NULL, &procfs_static_proc_ops);
 
     if (!procfs_static_proc_file) {
+        vfree(procfs_static_data);
         pr_err("[%s:%s] failed to create /proc/%s with permissions %o\n", PROCFS_STATIC_MODULE_NAME, __func__, PROCFS_STATIC_FILE_NAME, PROCFS_STATIC_FILE_PERMS);
         return -ENOMEM;
     }
 
+    // stat() and SEEK_END see the size of the contents
+
+    proc_set_size(procfs_static_proc_file, procfs_static_size);
+
     if (debug) {
         pr_info("[%s:%s] created /proc/%s with permissions %04o\n", PROCFS_STATIC_MODULE_NAME, __func__, PROCFS_STATIC_FILE_NAME, PROCFS_STATIC_FILE_PERMS);
     }
 
+    if (lkmpg_latency_register(&procfs_static_latency_set, PROCFS_STATIC_MODULE_NAME, procfs_static_latency, PROCFS_STATIC_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", PROCFS_STATIC_MODULE_NAME, __func__);
+    }
+
     return 0;
 
 }
@@ -67,6 +136,8 @@ int __init procfs_static_init(void) {
 void __exit procfs_static_exit(void) {
 
     proc_remove(procfs_static_proc_file);
+    lkmpg_latency_unregister(&procfs_static_latency_set);
+    vfree(procfs_static_data);
 
     if (debug) {
         pr_info("[%s:%s] removed /proc/%s\n", PROCFS_STATIC_MODULE_NAME, __func__, PROCFS_STATIC_FILE_NAME);
@@ -76,49 +147,140 @@ void __exit procfs_static_exit(void) {
 
 }
 
-int procfs_static_proc_open(struct inode* inode, struct file* file) {
+int procfs_static_load(void) {
+
+    int rc = 0;
+    const struct firmware* firmware = NULL;
+    const char* source = procfs_static_buffer;
+    size_t size = procfs_static_buffer_length;
+
+    if (procfs_static_param_firmware) {
+
+        if ((rc = request_firmware(&firmware, procfs_static_param_firmware, NULL))) {
+            pr_err("[%s:%s] failed to load firmware %s with error code %d\n", PROCFS_STATIC_MODULE_NAME, __func__, procfs_static_param_firmware, rc);
+            return rc;
+        }
+
+        source = firmware->data;
+        size = firmware->size;
+
+    }
+
+    // vmalloc_user() zeroes the pages and marks them for remap_vmalloc_range(),
+    // and the copy lets the firmware loader free its own buffer right away
+
+    procfs_static_data = vmalloc_user(max_t(size_t, size, 1));
+
+    if (!procfs_static_data) {
+        release_firmware(firmware);
+        pr_err("[%s:%s] failed to allocate %zu bytes\n", PROCFS_STATIC_MODULE_NAME, __func__, size);
+        return -ENOMEM;
+    }
+
+    memcpy(procfs_static_data, source, size);
+    procfs_static_size = size;
+    release_firmware(firmware);
 
     if (debug) {
-        pr_info("[%s:%s] opening /proc/%s (procfs_buffer = \"%s\", buffer.size = %zu)\n", PROCFS_STATIC_MODULE_NAME, __func__, file->f_path.dentry->d_name.name,
-                procfs_static_buffer, procfs_static_buffer_length);
+        pr_info("[%s:%s] loaded %zu bytes from %s\n", PROCFS_STATIC_MODULE_NAME, __func__, size, procfs_static_param_firmware ? procfs_static_param_firmware : "the built-in buffer");
     }
 
     return 0;
 
 }
 
+int procfs_static_proc_open(struct inode* inode, struct file* file) {
+
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    // without FMODE_NOWAIT, preadv2() with RWF_NOWAIT fails with -EOPNOTSUPP
+    // before it reaches procfs_static_proc_read_iter()
+
+#ifdef FMODE_NOWAIT
+    file->f_mode |= FMODE_NOWAIT;
+#endif
+
+    trace_procfs_static_open(file, 0);
+    lkmpg_latency_stop(&procfs_static_latency[PROCFS_STATIC_LATENCY_OPEN], &timer);
+
+    return 0;
+
+}
+
 int procfs_static_proc_release(struct inode* inode, struct file* file) {
 
-    if (debug) {
-        pr_info("[%s:%s] closing /proc/%s (buffer = \"%s\", buffer.size = %zu)\n", PROCFS_STATIC_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_static_buffer, procfs_static_buffer_length);
-    }
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+    trace_procfs_static_release(file, 0);
+    lkmpg_latency_stop(&procfs_static_latency[PROCFS_STATIC_LATENCY_RELEASE], &timer);
 
     return 0;
 
 }
 
-ssize_t procfs_static_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+ssize_t procfs_static_proc_read_iter(struct kiocb* iocb, struct iov_iter* to) {
 
-    if (*offset < 0) {
-        return -EINVAL;
-    }
+    ssize_t retval = 0;
+    loff_t position = iocb->ki_pos;
+    size_t length = iov_iter_count(to);
+    struct lkmpg_latency_timer timer;
 
-    if ((size_t) *offset >= procfs_static_buffer_length) {
-        return 0;
-    }
+    // the contents never change and are always resident, so reads
+    // (including IOCB_NOWAIT ones) never block, and the iterator also serves
+    // readv(), pread() at any offset, splice() and sendfile()
 
-    size_t bytes_to_read = min(length, procfs_static_buffer_length - *offset);
+    lkmpg_latency_start(&timer);
+    retval = lkmpg_buffer_copy_to_iter(procfs_static_data, procfs_static_size, &iocb->ki_pos, to);
+    trace_procfs_static_read(iocb->ki_filp, length, position, retval);
+    lkmpg_latency_stop(&procfs_static_latency[PROCFS_STATIC_LATENCY_READ], &timer);
 
-    if (debug) {
-        pr_info("[%s:%s] reading /proc/%s (message.size = %zu, message.offset = %lld, requested.length = %zu, bytes.read = %zu)\n", PROCFS_STATIC_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_static_buffer_length, *offset, length, bytes_to_read);
-    }
+    return retval;
+
+}
+
+loff_t procfs_static_proc_lseek(struct file* file, loff_t offset, int whence) {
+
+    // offsets are bounded by the size of the contents, so SEEK_END works
+    // and seeking past the end fails with -EINVAL
+
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    loff_t retval = fixed_size_llseek(file, offset, whence, procfs_static_size);
+
+    trace_procfs_static_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_static_latency[PROCFS_STATIC_LATENCY_SEEK], &timer);
+
+    return retval;
+
+}
+
+int procfs_static_proc_mmap(struct file* file, struct vm_area_struct* vma) {
+
+    // maps the pages of the contents directly; root can open the file for
+    // writing despite its mode, so shared mappings are refused write access
+    // here and cannot gain it with mprotect() later, while private ones copy
+    // on write; the rest of the last page reads as zeroes
+
+    if (vma->vm_flags & VM_SHARED) {
+
+        if (vma->vm_flags & VM_WRITE) {
+            return -EPERM;
+        }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+        vm_flags_clear(vma, VM_MAYWRITE);
+#else
+        vma->vm_flags &= ~VM_MAYWRITE;
+#endif
 
-    if (copy_to_user(buffer, &procfs_static_buffer[*offset], bytes_to_read)) {
-        return -EFAULT;
     }
 
-    *offset += bytes_to_read;
-    return bytes_to_read;
+    return remap_vmalloc_range(vma, procfs_static_data, vma->vm_pgoff);
 
 }
 
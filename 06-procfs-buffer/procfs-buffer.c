@@ -9,6 +9,15 @@
 #include <linux/minmax.h>
 #include <linux/mutex.h>
 
+#include "lkmpg-buffer.h"
+#include "lkmpg-genl.h"
+#include "lkmpg-latency.h"
+#include "lkmpg-shrinker.h"
+#include "lkmpg-state.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
 MODULE_DESCRIPTION("06-procfs-buffer");
@@ -19,6 +28,13 @@ MODULE_VERSION("0.1");
 #define PROCFS_BUFFER_SIZE 1024
 #define PROCFS_BUFFER_FILE_PERMS 0644
 
+// /proc/procfs-buffer-state dumps and restores the buffer contents as the
+// payload of an include/lkmpg-state.h dump
+
+#define PROCFS_BUFFER_STATE_NAME "procfs-buffer-state"
+#define PROCFS_BUFFER_STATE_MAGIC 0x70666273
+#define PROCFS_BUFFER_STATE_VERSION 1
+
 static int __init procfs_buffer_init(void);
 static void __exit procfs_buffer_exit(void);
 
@@ -26,30 +42,98 @@ static void __exit procfs_buffer_exit(void);
 
 static int procfs_buffer_proc_open(struct inode*, struct file*);
 static int procfs_buffer_proc_release(struct inode*, struct file*);
-static ssize_t procfs_buffer_proc_read(struct file*, char __user*, size_t, loff_t*);
+static ssize_t procfs_buffer_proc_read_iter(struct kiocb*, struct iov_iter*);
 static ssize_t procfs_buffer_proc_write(struct file*, const char __user*, size_t, loff_t*);
+static loff_t procfs_buffer_proc_lseek(struct file*, loff_t, int);
 
 static const struct proc_ops procfs_buffer_proc_ops = {
     .proc_open = procfs_buffer_proc_open,
     .proc_release = procfs_buffer_proc_release,
-    .proc_read = procfs_buffer_proc_read,
-    .proc_write = procfs_buffer_proc_write
+    .proc_read_iter = procfs_buffer_proc_read_iter,
+    .proc_write = procfs_buffer_proc_write,
+    .proc_lseek = procfs_buffer_proc_lseek
 };
 
 // opaque pointer to a struct proc_dir_entry
 
 static struct proc_dir_entry* procfs_buffer_proc_file = NULL;
 
-// buffer to read and write (null-terminated string)
+// buffer to read and write (null-terminated string), allocated on the first
+// write and compacted by the shrinker once it has been idle
 
-static size_t procfs_buffer_size = 0;
-static char procfs_buffer[PROCFS_BUFFER_SIZE + 1] = {};
+static struct lkmpg_buffer procfs_buffer = {};
 
-// mutex protecting procfs_buffer and procfs_buffer size
+// mutex protecting procfs_buffer
 
 static DEFINE_MUTEX(procfs_buffer_mutex);
 
-// enable debug messages
+// shrinker releasing the slack of an idle buffer, or all of an empty one
+
+static unsigned long procfs_buffer_shrinker_count(struct shrinker*, struct shrink_control*);
+static unsigned long procfs_buffer_shrinker_scan(struct shrinker*, struct shrink_control*);
+
+static struct lkmpg_shrinker procfs_buffer_shrinker;
+
+static size_t procfs_buffer_state_size(void);
+static ssize_t procfs_buffer_state_dump(void*, size_t);
+static int procfs_buffer_state_restore(const void*, size_t);
+
+static const struct lkmpg_state_ops procfs_buffer_state_ops = {
+    .magic = PROCFS_BUFFER_STATE_MAGIC,
+    .version = PROCFS_BUFFER_STATE_VERSION,
+    .size = procfs_buffer_state_size,
+    .dump = procfs_buffer_state_dump,
+    .restore = procfs_buffer_state_restore,
+};
+
+static struct proc_dir_entry* procfs_buffer_state_file = NULL;
+
+// generic netlink family (see include/lkmpg-genl.h); GET and events carry the
+// SIZE and DATA of the buffer, and SET writes DATA at OFFSET like write()
+// except that data that does not fit fails instead of being truncated
+
+static int procfs_buffer_genl_fill(struct sk_buff*, const struct lkmpg_genl_change*);
+static int procfs_buffer_genl_set(struct genl_info*);
+
+static const struct lkmpg_genl_ops procfs_buffer_genl_ops = {
+    .set_attrs = BIT(LKMPG_GENL_ATTR_OFFSET) | BIT(LKMPG_GENL_ATTR_DATA),
+    .fill = procfs_buffer_genl_fill,
+    .set = procfs_buffer_genl_set,
+};
+
+static struct lkmpg_genl procfs_buffer_genl = {
+    .family = {.name = PROCFS_BUFFER_MODULE_NAME},
+    .ops = &procfs_buffer_genl_ops,
+};
+
+static unsigned long procfs_buffer_param_reclaimed_bytes = 0;
+module_param_named(reclaimed_bytes, procfs_buffer_param_reclaimed_bytes, ulong, 0444);
+MODULE_PARM_DESC(reclaimed_bytes, "bytes of the buffer released by the shrinker");
+
+// per-operation latency histograms, built with LATENCY=1; read and write
+// record the wait for procfs_buffer_mutex separately from the copy
+
+enum {
+    PROCFS_BUFFER_LATENCY_OPEN,
+    PROCFS_BUFFER_LATENCY_READ,
+    PROCFS_BUFFER_LATENCY_WRITE,
+    PROCFS_BUFFER_LATENCY_SEEK,
+    PROCFS_BUFFER_LATENCY_RELEASE,
+    PROCFS_BUFFER_LATENCY_COUNT
+};
+
+static struct lkmpg_latency procfs_buffer_latency[PROCFS_BUFFER_LATENCY_COUNT] = {
+    [PROCFS_BUFFER_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [PROCFS_BUFFER_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [PROCFS_BUFFER_LATENCY_WRITE] = LKMPG_LATENCY_OP("write"),
+    [PROCFS_BUFFER_LATENCY_SEEK] = LKMPG_LATENCY_OP("seek"),
+    [PROCFS_BUFFER_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+};
+
+static struct lkmpg_latency_set procfs_buffer_latency_set;
+
+// enable debug messages during initialization and cleanup; file operations
+// are traced through the procfs_buffer tracepoints instead
 
 static bool debug = false;
 module_param(debug, bool, 0);
@@ -57,6 +141,8 @@ MODULE_PARM_DESC(debug, "enable debug messages");
 
 int __init procfs_buffer_init(void) {
 
+    int retval = 0;
+
     procfs_buffer_proc_file = proc_create(PROCFS_BUFFER_FILE_NAME, PROCFS_BUFFER_FILE_PERMS, NULL, &procfs_buffer_proc_ops);
 
     if (!procfs_buffer_proc_file) {
@@ -64,17 +150,50 @@ int __init procfs_buffer_init(void) {
         return -ENOMEM;
     }
 
+    procfs_buffer_state_file = lkmpg_state_create(PROCFS_BUFFER_STATE_NAME, &procfs_buffer_state_ops);
+
+    if (!procfs_buffer_state_file) {
+        proc_remove(procfs_buffer_proc_file);
+        pr_err("[%s:%s] failed to create /proc/%s\n", PROCFS_BUFFER_MODULE_NAME, __func__, PROCFS_BUFFER_STATE_NAME);
+        return -ENOMEM;
+    }
+
+    if ((retval = lkmpg_genl_register(&procfs_buffer_genl))) {
+        proc_remove(procfs_buffer_state_file);
+        proc_remove(procfs_buffer_proc_file);
+        pr_err("[%s:%s] failed to register generic netlink family: %d\n", PROCFS_BUFFER_MODULE_NAME, __func__, retval);
+        return retval;
+    }
+
     if (debug) {
         pr_info("[%s:%s] created /proc/%s with permissions %04o\n", PROCFS_BUFFER_MODULE_NAME, __func__, PROCFS_BUFFER_FILE_NAME, PROCFS_BUFFER_FILE_PERMS);
     }
 
+    if (lkmpg_latency_register(&procfs_buffer_latency_set, PROCFS_BUFFER_MODULE_NAME, procfs_buffer_latency, PROCFS_BUFFER_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", PROCFS_BUFFER_MODULE_NAME, __func__);
+    }
+
+    // without the shrinker the buffer stays allocated until the module is
+    // unloaded
+
+    if (lkmpg_shrinker_register(&procfs_buffer_shrinker, PROCFS_BUFFER_MODULE_NAME, procfs_buffer_shrinker_count, procfs_buffer_shrinker_scan)) {
+        pr_err("[%s:%s] failed to register shrinker\n", PROCFS_BUFFER_MODULE_NAME, __func__);
+    }
+
     return 0;
 
 }
 
 void __exit procfs_buffer_exit(void) {
 
+    // files before the family, see lkmpg_genl_register()
+
+    proc_remove(procfs_buffer_state_file);
     proc_remove(procfs_buffer_proc_file);
+    lkmpg_genl_unregister(&procfs_buffer_genl);
+    lkmpg_shrinker_unregister(&procfs_buffer_shrinker);
+    lkmpg_latency_unregister(&procfs_buffer_latency_set);
+    lkmpg_buffer_free(&procfs_buffer);
 
     if (debug) {
         pr_info("[%s:%s] removed /proc/%s\n", PROCFS_BUFFER_MODULE_NAME, __func__, PROCFS_BUFFER_FILE_NAME);
@@ -86,9 +205,19 @@ void __exit procfs_buffer_exit(void) {
 
 int procfs_buffer_proc_open(struct inode* inode, struct file* file) {
 
-    if (debug) {
-        pr_info("[%s:%s] opening /proc/%s (procfs_buffer = \"%s\", buffer.size = %zu)\n", PROCFS_BUFFER_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_buffer, procfs_buffer_size);
-    }
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    // without FMODE_NOWAIT, preadv2() with RWF_NOWAIT fails with -EOPNOTSUPP
+    // before it reaches procfs_buffer_proc_read_iter()
+
+#ifdef FMODE_NOWAIT
+    file->f_mode |= FMODE_NOWAIT;
+#endif
+
+    trace_procfs_buffer_open(file, 0);
+    lkmpg_latency_stop(&procfs_buffer_latency[PROCFS_BUFFER_LATENCY_OPEN], &timer);
 
     return 0;
 
@@ -96,105 +225,261 @@ int procfs_buffer_proc_open(struct inode* inode, struct file* file) {
 
 int procfs_buffer_proc_release(struct inode* inode, struct file* file) {
 
-    if (debug) {
-        pr_info("[%s:%s] closing /proc/%s (buffer = \"%s\", buffer.size = %zu)\n", PROCFS_BUFFER_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_buffer, procfs_buffer_size);
-    }
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+    trace_procfs_buffer_release(file, 0);
+    lkmpg_latency_stop(&procfs_buffer_latency[PROCFS_BUFFER_LATENCY_RELEASE], &timer);
 
     return 0;
 
 }
 
-ssize_t procfs_buffer_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+ssize_t procfs_buffer_proc_read_iter(struct kiocb* iocb, struct iov_iter* to) {
+
+    ssize_t retval = 0;
+    loff_t position = iocb->ki_pos;
+    size_t length = iov_iter_count(to);
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    // RWF_NOWAIT readers get -EAGAIN instead of sleeping on a held mutex,
+    // everyone else sleeps until the mutex is available
+
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        if (!mutex_trylock(&procfs_buffer_mutex)) {
+            trace_procfs_buffer_read(iocb->ki_filp, length, position, -EAGAIN);
+            return -EAGAIN;
+        }
+    } else if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
+        trace_procfs_buffer_read(iocb->ki_filp, length, position, -ERESTARTSYS);
+        return -ERESTARTSYS;
+    }
+
+    lkmpg_latency_locked(&timer);
+    procfs_buffer.used = jiffies;
+    retval = lkmpg_buffer_copy_to_iter(procfs_buffer.data, procfs_buffer.size, &iocb->ki_pos, to);
+    mutex_unlock(&procfs_buffer_mutex);
+
+    trace_procfs_buffer_read(iocb->ki_filp, length, position, retval);
+    lkmpg_latency_stop(&procfs_buffer_latency[PROCFS_BUFFER_LATENCY_READ], &timer);
+
+    return retval;
+
+}
+
+ssize_t procfs_buffer_proc_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
 
     ssize_t retval = 0;
+    loff_t position = *offset;
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
 
     // return zero if the mutex was acquired or sleep until the mutex is available
 
     if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
+        trace_procfs_buffer_write(file, length, position, -ERESTARTSYS);
         return -ERESTARTSYS;
     }
 
-    if (*offset < 0) {
-        retval = -EINVAL;
-        goto PROCFS_BUFFER_PROC_READ_EXIT;
-    }
+    lkmpg_latency_locked(&timer);
 
-    if ((size_t) *offset >= procfs_buffer_size) {
-        retval = 0;
-        goto PROCFS_BUFFER_PROC_READ_EXIT;
-    }
+    ssize_t bytes_to_write = lkmpg_buffer_write_span(*offset, PROCFS_BUFFER_SIZE, length);
 
-    size_t bytes_to_read = min(length, procfs_buffer_size - *offset);
+    if (bytes_to_write < 0) {
+        retval = bytes_to_write;
+        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
+    }
 
-    if (debug) {
-        pr_info("[%s:%s] reading /proc/%s (message.size = %zu, message.offset = %lld, requested.length = %zu, bytes.read = %zu)\n", PROCFS_BUFFER_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_buffer_size, *offset, length, bytes_to_read);
+    if (lkmpg_buffer_reserve(&procfs_buffer, PROCFS_BUFFER_SIZE)) {
+        retval = -ENOMEM;
+        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
     }
 
-    if (copy_to_user(buffer, &procfs_buffer[*offset], bytes_to_read)) {
+    if (copy_from_user(procfs_buffer.data + *offset, buffer, bytes_to_write)) {
         retval = -EFAULT;
-        goto PROCFS_BUFFER_PROC_READ_EXIT;
+        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
     }
 
-    *offset += bytes_to_read;
-    retval = bytes_to_read;
+    // truncate on write instead of growing buffer size
 
-PROCFS_BUFFER_PROC_READ_EXIT:
+    *offset += bytes_to_write;
+    procfs_buffer.size = *offset;
+    procfs_buffer.data[procfs_buffer.size] = '\0';
+    retval = bytes_to_write;
+
+PROCFS_BUFFER_PROC_WRITE_EXIT:
 
     mutex_unlock(&procfs_buffer_mutex);
+    trace_procfs_buffer_write(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_buffer_latency[PROCFS_BUFFER_LATENCY_WRITE], &timer);
+
+    if (retval > 0) {
+        lkmpg_genl_notify(&procfs_buffer_genl, NULL);
+    }
+
     return retval;
 
 }
 
-ssize_t procfs_buffer_proc_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
+loff_t procfs_buffer_proc_lseek(struct file* file, loff_t offset, int whence) {
 
-    ssize_t retval = 0;
+    // same as the default_llseek() fallback used when .proc_lseek is unset
 
-    // return zero if the mutex was acquired or sleep until the mutex is available
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    loff_t retval = default_llseek(file, offset, whence);
+
+    trace_procfs_buffer_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_buffer_latency[PROCFS_BUFFER_LATENCY_SEEK], &timer);
+
+    return retval;
+
+}
+
+size_t procfs_buffer_state_size(void) {
+    return PROCFS_BUFFER_SIZE;
+}
+
+ssize_t procfs_buffer_state_dump(void* payload, size_t size) {
+
+    ssize_t length = 0;
 
     if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
         return -ERESTARTSYS;
     }
 
-    if (*offset < 0) {
-        retval = -EINVAL;
-        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
+    length = min(size, procfs_buffer.size);
+    memcpy(payload, procfs_buffer.data, length);
+    mutex_unlock(&procfs_buffer_mutex);
+
+    return length;
+
+}
+
+int procfs_buffer_state_restore(const void* payload, size_t length) {
+
+    int retval = 0;
+
+    if (length > PROCFS_BUFFER_SIZE) {
+        return -EINVAL;
     }
 
-    if (*offset >= PROCFS_BUFFER_SIZE) {
-        retval = -ENOSPC;
-        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
+    if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
+        return -ERESTARTSYS;
     }
 
-    size_t bytes_available = PROCFS_BUFFER_SIZE - *offset;
-    size_t bytes_to_write = min(length, bytes_available);
+    // an empty dump leaves an empty buffer for the shrinker to release
 
-    if (debug) {
-        pr_info("[%s:%s] writing /proc/%s (message.size = %zu, message.offset = %lld, requested.length = %zu, bytes.available = %zu, bytes.write = %zu)\n", PROCFS_BUFFER_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, procfs_buffer_size, *offset, length, bytes_available, bytes_to_write);
+    if (!length) {
+        procfs_buffer.size = 0;
+        goto PROCFS_BUFFER_STATE_RESTORE_EXIT;
     }
 
-    if (!bytes_to_write) {
-        retval = -ENOSPC;
-        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
+    if ((retval = lkmpg_buffer_reserve(&procfs_buffer, PROCFS_BUFFER_SIZE))) {
+        goto PROCFS_BUFFER_STATE_RESTORE_EXIT;
     }
 
-    if (copy_from_user(procfs_buffer + *offset, buffer, bytes_to_write)) {
-        retval = -EFAULT;
-        goto PROCFS_BUFFER_PROC_WRITE_EXIT;
+    memcpy(procfs_buffer.data, payload, length);
+    procfs_buffer.size = length;
+    procfs_buffer.data[length] = '\0';
+
+PROCFS_BUFFER_STATE_RESTORE_EXIT:
+
+    mutex_unlock(&procfs_buffer_mutex);
+
+    if (!retval) {
+        lkmpg_genl_notify(&procfs_buffer_genl, NULL);
     }
 
-    // truncate on write instead of growing buffer size
+    return retval;
 
-    *offset += bytes_to_write;
-    procfs_buffer_size = *offset;
-    procfs_buffer[procfs_buffer_size] = '\0';
-    retval = bytes_to_write;
+}
 
-PROCFS_BUFFER_PROC_WRITE_EXIT:
+int procfs_buffer_genl_fill(struct sk_buff* skb, const struct lkmpg_genl_change* change) {
+
+    // GET and events both carry the whole buffer
+
+    int retval = 0;
+
+    if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    procfs_buffer.used = jiffies;
+
+    if (nla_put_u32(skb, LKMPG_GENL_ATTR_SIZE, procfs_buffer.size) || nla_put(skb, LKMPG_GENL_ATTR_DATA, procfs_buffer.size, procfs_buffer.data)) {
+        retval = -EMSGSIZE;
+    }
 
     mutex_unlock(&procfs_buffer_mutex);
+
     return retval;
 
 }
 
+int procfs_buffer_genl_set(struct genl_info* info) {
+
+    int retval = 0;
+    u32 offset = 0;
+    const struct nlattr* data = lkmpg_genl_data(info, PROCFS_BUFFER_SIZE, &offset);
+
+    if (IS_ERR(data)) {
+        return PTR_ERR(data);
+    }
+
+    if (mutex_lock_interruptible(&procfs_buffer_mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    if (!(retval = lkmpg_buffer_reserve(&procfs_buffer, PROCFS_BUFFER_SIZE))) {
+        memcpy(procfs_buffer.data + offset, nla_data(data), nla_len(data));
+        procfs_buffer.size = offset + nla_len(data);
+        procfs_buffer.data[procfs_buffer.size] = '\0';
+    }
+
+    mutex_unlock(&procfs_buffer_mutex);
+
+    if (!retval) {
+        lkmpg_genl_notify(&procfs_buffer_genl, NULL);
+    }
+
+    return retval;
+
+}
+
+unsigned long procfs_buffer_shrinker_count(struct shrinker* shrinker, struct shrink_control* control) {
+
+    unsigned long count = 0;
+
+    if (mutex_trylock(&procfs_buffer_mutex)) {
+        count = lkmpg_buffer_reclaimable(&procfs_buffer);
+        mutex_unlock(&procfs_buffer_mutex);
+    }
+
+    return count;
+
+}
+
+unsigned long procfs_buffer_shrinker_scan(struct shrinker* shrinker, struct shrink_control* control) {
+
+    unsigned long released = 0;
+
+    if (!mutex_trylock(&procfs_buffer_mutex)) {
+        return SHRINK_STOP;
+    }
+
+    released = lkmpg_buffer_compact(&procfs_buffer);
+    procfs_buffer_param_reclaimed_bytes += released;
+    mutex_unlock(&procfs_buffer_mutex);
+
+    return released ? released : SHRINK_STOP;
+
+}
+
 module_init(procfs_buffer_init);
 module_exit(procfs_buffer_exit);
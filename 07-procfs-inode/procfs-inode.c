@@ -10,6 +10,15 @@
 #include <linux/mutex.h>
 #include <linux/string.h>
 
+#include "lkmpg-buffer.h"
+#include "lkmpg-genl.h"
+#include "lkmpg-latency.h"
+#include "lkmpg-shrinker.h"
+#include "lkmpg-state.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
 MODULE_DESCRIPTION("07-procfs-inode");
@@ -23,6 +32,13 @@ MODULE_VERSION("0.1");
 #define PROCFS_INODE_FILE_PARENT NULL
 #define PROCFS_INODE_BUFFER_SIZE 127
 
+// /proc/procfs-inode-state dumps and restores the buffer contents as the
+// payload of an include/lkmpg-state.h dump
+
+#define PROCFS_INODE_STATE_NAME "procfs-inode-state"
+#define PROCFS_INODE_STATE_MAGIC 0x70666973
+#define PROCFS_INODE_STATE_VERSION 1
+
 static int __init procfs_inode_init(void);
 static void __exit procfs_inode_exit(void);
 
@@ -30,21 +46,23 @@ static void __exit procfs_inode_exit(void);
 
 static int procfs_inode_proc_open(struct inode*, struct file*);
 static int procfs_inode_proc_release(struct inode*, struct file*);
-static ssize_t procfs_inode_proc_read(struct file*, char __user*, size_t, loff_t*);
+static ssize_t procfs_inode_proc_read_iter(struct kiocb*, struct iov_iter*);
 static ssize_t procfs_inode_proc_write(struct file*, const char __user*, size_t, loff_t*);
+static loff_t procfs_inode_proc_lseek(struct file*, loff_t, int);
 
 static const struct proc_ops procfs_inode_proc_ops = {
     .proc_open = procfs_inode_proc_open,
     .proc_release = procfs_inode_proc_release,
-    .proc_read = procfs_inode_proc_read,
-    .proc_write = procfs_inode_proc_write
+    .proc_read_iter = procfs_inode_proc_read_iter,
+    .proc_write = procfs_inode_proc_write,
+    .proc_lseek = procfs_inode_proc_lseek
 };
 
-// private data for procfs entry
+// private data for procfs entry; the buffer is allocated on the first write
+// and compacted by the shrinker once it has been idle
 
 struct procfs_inode_proc_context {
-	char buffer[PROCFS_INODE_BUFFER_SIZE + 1];
-    size_t size;
+    struct lkmpg_buffer buffer;
     struct mutex mutex;
 };
 
@@ -56,7 +74,72 @@ static struct proc_dir_entry* procfs_inode_proc_file = NULL;
 
 static struct procfs_inode_proc_context* procfs_inode_proc_context = NULL;
 
-// enable debug messages
+// per-operation latency histograms, built with LATENCY=1; read and write
+// record the wait for the context mutex separately from the copy
+
+enum {
+    PROCFS_INODE_LATENCY_OPEN,
+    PROCFS_INODE_LATENCY_READ,
+    PROCFS_INODE_LATENCY_WRITE,
+    PROCFS_INODE_LATENCY_SEEK,
+    PROCFS_INODE_LATENCY_RELEASE,
+    PROCFS_INODE_LATENCY_COUNT
+};
+
+static struct lkmpg_latency procfs_inode_latency[PROCFS_INODE_LATENCY_COUNT] = {
+    [PROCFS_INODE_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [PROCFS_INODE_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [PROCFS_INODE_LATENCY_WRITE] = LKMPG_LATENCY_OP("write"),
+    [PROCFS_INODE_LATENCY_SEEK] = LKMPG_LATENCY_OP("seek"),
+    [PROCFS_INODE_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+};
+
+static struct lkmpg_latency_set procfs_inode_latency_set;
+
+// shrinker releasing the slack of an idle buffer, or all of an empty one
+
+static unsigned long procfs_inode_shrinker_count(struct shrinker*, struct shrink_control*);
+static unsigned long procfs_inode_shrinker_scan(struct shrinker*, struct shrink_control*);
+
+static struct lkmpg_shrinker procfs_inode_shrinker;
+
+static size_t procfs_inode_state_size(void);
+static ssize_t procfs_inode_state_dump(void*, size_t);
+static int procfs_inode_state_restore(const void*, size_t);
+
+static const struct lkmpg_state_ops procfs_inode_state_ops = {
+    .magic = PROCFS_INODE_STATE_MAGIC,
+    .version = PROCFS_INODE_STATE_VERSION,
+    .size = procfs_inode_state_size,
+    .dump = procfs_inode_state_dump,
+    .restore = procfs_inode_state_restore,
+};
+
+static struct proc_dir_entry* procfs_inode_state_file = NULL;
+
+// generic netlink family (see include/lkmpg-genl.h) for the same buffer as
+// the file; SET fails instead of truncating data that does not fit
+
+static int procfs_inode_genl_fill(struct sk_buff*, const struct lkmpg_genl_change*);
+static int procfs_inode_genl_set(struct genl_info*);
+
+static const struct lkmpg_genl_ops procfs_inode_genl_ops = {
+    .set_attrs = BIT(LKMPG_GENL_ATTR_OFFSET) | BIT(LKMPG_GENL_ATTR_DATA),
+    .fill = procfs_inode_genl_fill,
+    .set = procfs_inode_genl_set,
+};
+
+static struct lkmpg_genl procfs_inode_genl = {
+    .family = {.name = PROCFS_INODE_MODULE_NAME},
+    .ops = &procfs_inode_genl_ops,
+};
+
+static unsigned long procfs_inode_param_reclaimed_bytes = 0;
+module_param_named(reclaimed_bytes, procfs_inode_param_reclaimed_bytes, ulong, 0444);
+MODULE_PARM_DESC(reclaimed_bytes, "bytes of the buffer released by the shrinker");
+
+// enable debug messages during initialization and cleanup; file operations
+// are traced through the procfs_inode tracepoints instead
 
 static bool procfs_inode_param_debug = false;
 module_param_named(debug, procfs_inode_param_debug, bool, 0);
@@ -64,6 +147,8 @@ MODULE_PARM_DESC(debug, "enable debug messages");
 
 int __init procfs_inode_init(void) {
 
+    int retval = 0;
+
     // initialize private data context
 
     procfs_inode_proc_context = kzalloc(sizeof(*procfs_inode_proc_context), GFP_KERNEL);
@@ -72,8 +157,6 @@ int __init procfs_inode_init(void) {
         return -ENOMEM;
     }
 
-    memset(procfs_inode_proc_context->buffer, 0, sizeof(procfs_inode_proc_context->buffer));
-    procfs_inode_proc_context->size = 0;
     mutex_init(&procfs_inode_proc_context->mutex);
 
     // create procfs entry with private data context
@@ -86,8 +169,36 @@ int __init procfs_inode_init(void) {
         return -ENOMEM;
     }
 
+    procfs_inode_state_file = lkmpg_state_create(PROCFS_INODE_STATE_NAME, &procfs_inode_state_ops);
+
+    if (!procfs_inode_state_file) {
+        proc_remove(procfs_inode_proc_file);
+        kfree(procfs_inode_proc_context);
+        pr_err("[%s:%s] failed to create /proc/%s entry\n", PROCFS_INODE_MODULE_NAME, __func__, PROCFS_INODE_STATE_NAME);
+        return -ENOMEM;
+    }
+
+    if ((retval = lkmpg_genl_register(&procfs_inode_genl))) {
+        proc_remove(procfs_inode_state_file);
+        proc_remove(procfs_inode_proc_file);
+        kfree(procfs_inode_proc_context);
+        pr_err("[%s:%s] failed to register generic netlink family: %d\n", PROCFS_INODE_MODULE_NAME, __func__, retval);
+        return retval;
+    }
+
+    if (lkmpg_latency_register(&procfs_inode_latency_set, PROCFS_INODE_MODULE_NAME, procfs_inode_latency, PROCFS_INODE_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", PROCFS_INODE_MODULE_NAME, __func__);
+    }
+
+    // without the shrinker the buffer stays allocated until the module is
+    // unloaded
+
+    if (lkmpg_shrinker_register(&procfs_inode_shrinker, PROCFS_INODE_MODULE_NAME, procfs_inode_shrinker_count, procfs_inode_shrinker_scan)) {
+        pr_err("[%s:%s] failed to register shrinker\n", PROCFS_INODE_MODULE_NAME, __func__);
+    }
+
     if (procfs_inode_param_debug) {
-        pr_info("[%s:%s] created /proc/%s entry with permissions %04o (pdata.size = %zu, pdata.buffer = %pK)\n", PROCFS_INODE_MODULE_NAME, __func__, PROCFS_INODE_FILE_NAME, PROCFS_INODE_FILE_PERMS, procfs_inode_proc_context->size, procfs_inode_proc_context->buffer);
+        pr_info("[%s:%s] created /proc/%s entry with permissions %04o (pdata = %pK)\n", PROCFS_INODE_MODULE_NAME, __func__, PROCFS_INODE_FILE_NAME, PROCFS_INODE_FILE_PERMS, procfs_inode_proc_context);
     }
 
     return 0;
@@ -96,9 +207,14 @@ int __init procfs_inode_init(void) {
 
 void __exit procfs_inode_exit(void) {
 
-    // remove module before freeing private data
+    // files before the family, see lkmpg_genl_register()
 
+    proc_remove(procfs_inode_state_file);
     proc_remove(procfs_inode_proc_file);
+    lkmpg_genl_unregister(&procfs_inode_genl);
+    lkmpg_shrinker_unregister(&procfs_inode_shrinker);
+    lkmpg_latency_unregister(&procfs_inode_latency_set);
+    lkmpg_buffer_free(&procfs_inode_proc_context->buffer);
     kfree(procfs_inode_proc_context);
 
     if (procfs_inode_param_debug) {
@@ -113,18 +229,29 @@ int procfs_inode_proc_open(struct inode* inode, struct file* file) {
 
     // synchronization only required on read and writes
 
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
     struct procfs_inode_proc_context* local_context = pde_data(inode);
 
     if (!local_context) {
         pr_err("[%s:%s] failed to get private data for /proc/%s\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
+        trace_procfs_inode_open(file, -EINVAL);
         return -EINVAL;
     }
 
     file->private_data = local_context;
 
-    if (procfs_inode_param_debug) {
-        pr_info("[%s:%s] opening /proc/%s (pdata.size = %zu, pdata.buffer = %pK)\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, local_context->size, local_context->buffer);
-    }
+    // without FMODE_NOWAIT, preadv2() with RWF_NOWAIT fails with -EOPNOTSUPP
+    // before it reaches procfs_inode_proc_read_iter()
+
+#ifdef FMODE_NOWAIT
+    file->f_mode |= FMODE_NOWAIT;
+#endif
+
+    trace_procfs_inode_open(file, 0);
+    lkmpg_latency_stop(&procfs_inode_latency[PROCFS_INODE_LATENCY_OPEN], &timer);
 
     return 0;
 
@@ -132,66 +259,67 @@ int procfs_inode_proc_open(struct inode* inode, struct file* file) {
 
 int procfs_inode_proc_release(struct inode* inode, struct file* file) {
 
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
     struct procfs_inode_proc_context* local_context = pde_data(inode);
 
     if (!local_context) {
         pr_err("[%s:%s] failed to get private data for /proc/%s\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
+        trace_procfs_inode_release(file, -EINVAL);
         return -EINVAL;
     }
 
-    if (procfs_inode_param_debug) {
-        pr_info("[%s:%s] closing /proc/%s (pdata.size = %zu, pdata.buffer = %pK)\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, local_context->size, local_context->buffer);
-    }
+    trace_procfs_inode_release(file, 0);
+    lkmpg_latency_stop(&procfs_inode_latency[PROCFS_INODE_LATENCY_RELEASE], &timer);
 
     return 0;
 
 }
 
-ssize_t procfs_inode_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+ssize_t procfs_inode_proc_read_iter(struct kiocb* iocb, struct iov_iter* to) {
+
+    struct file* file = iocb->ki_filp;
+    size_t length = iov_iter_count(to);
 
     if (!file->private_data) {
         pr_err("[%s:%s] failed to get private data for /proc/%s\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
+        trace_procfs_inode_read(file, length, iocb->ki_pos, -EINVAL);
         return -EINVAL;
     }
 
     ssize_t retval = 0;
+    loff_t position = iocb->ki_pos;
+    struct lkmpg_latency_timer timer;
     struct procfs_inode_proc_context* local_context = file->private_data;
 
-    // restart system call if mutex could not be acquired
+    lkmpg_latency_start(&timer);
 
-    if (mutex_lock_interruptible(&local_context->mutex)) {
-        return -ERESTARTSYS;
-    }
+    // RWF_NOWAIT readers get -EAGAIN instead of sleeping on a held mutex,
+    // everyone else restarts the system call if the wait is interrupted
 
-    // read from the private buffer
-
-    if (*offset < 0) {
-        retval = -EINVAL;
-        goto PROCFS_INODE_PROC_READ_EXIT;
-    }
-
-    if ((size_t) *offset >= local_context->size) {
-        retval = 0;
-        goto PROCFS_INODE_PROC_READ_EXIT;
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        if (!mutex_trylock(&local_context->mutex)) {
+            trace_procfs_inode_read(file, length, position, -EAGAIN);
+            return -EAGAIN;
+        }
+    } else if (mutex_lock_interruptible(&local_context->mutex)) {
+        trace_procfs_inode_read(file, length, position, -ERESTARTSYS);
+        return -ERESTARTSYS;
     }
 
-    size_t bytes_to_read = min(length, local_context->size - *offset);
+    lkmpg_latency_locked(&timer);
 
-    if (procfs_inode_param_debug) {
-        pr_info("[%s:%s] reading private data for /proc/%s (pdata.size = %zu, pdata.buffer = %pK, requested.length = %zu, requested.offset = %lld, bytes.read = %zu)\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, local_context->size, local_context->buffer, length, *offset, bytes_to_read);
-    }
-
-    if (copy_to_user(buffer, &local_context->buffer[*offset], bytes_to_read)) {
-        retval = -EFAULT;
-        goto PROCFS_INODE_PROC_READ_EXIT;
-    }
+    // read from the private buffer
 
-    *offset += bytes_to_read;
-    retval = bytes_to_read;
+    local_context->buffer.used = jiffies;
+    retval = lkmpg_buffer_copy_to_iter(local_context->buffer.data, local_context->buffer.size, &iocb->ki_pos, to);
+    mutex_unlock(&local_context->mutex);
 
-PROCFS_INODE_PROC_READ_EXIT:
+    trace_procfs_inode_read(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_inode_latency[PROCFS_INODE_LATENCY_READ], &timer);
 
-    mutex_unlock(&local_context->mutex);
     return retval;
 
 }
@@ -200,44 +328,41 @@ ssize_t procfs_inode_proc_write(struct file* file, const char __user* buffer, si
 
     if (!file->private_data) {
         pr_err("[%s:%s] failed to get private data for /proc/%s\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
+        trace_procfs_inode_write(file, length, *offset, -EINVAL);
         return -EINVAL;
     }
 
     ssize_t retval = 0;
+    loff_t position = *offset;
+    struct lkmpg_latency_timer timer;
     struct procfs_inode_proc_context* local_context = file->private_data;
 
+    lkmpg_latency_start(&timer);
+
     // restart system call if mutex could not be acquired
 
     if (mutex_lock_interruptible(&local_context->mutex)) {
+        trace_procfs_inode_write(file, length, position, -ERESTARTSYS);
         return -ERESTARTSYS;
     }
 
+    lkmpg_latency_locked(&timer);
+
     // write to the private buffer
 
-    if (*offset < 0) {
-        retval = -EINVAL;
-        goto PROCFS_INODE_PROC_WRITE_EXIT;
-    }
+    ssize_t bytes_to_write = lkmpg_buffer_write_span(*offset, PROCFS_INODE_BUFFER_SIZE, length);
 
-    if (*offset >= PROCFS_INODE_BUFFER_SIZE) {
-        retval = -ENOSPC;
+    if (bytes_to_write < 0) {
+        retval = bytes_to_write;
         goto PROCFS_INODE_PROC_WRITE_EXIT;
     }
 
-    size_t bytes_available = PROCFS_INODE_BUFFER_SIZE - *offset;
-    size_t bytes_to_write = min(length, bytes_available);
-
-    if (procfs_inode_param_debug) {
-
-        pr_info("[%s:%s] writing private data for /proc/%s (pdata.size = %zu, pdata.buffer = %pK, requested.length = %zu, requested.offset = %lld, bytes.avilable = %zu, bytes.write = %zu)\n", PROCFS_INODE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, local_context->size, local_context->buffer, length, *offset, bytes_available, bytes_to_write);
-    }
-
-    if (!bytes_to_write) {
-        retval = -ENOSPC;
+    if (lkmpg_buffer_reserve(&local_context->buffer, PROCFS_INODE_BUFFER_SIZE)) {
+        retval = -ENOMEM;
         goto PROCFS_INODE_PROC_WRITE_EXIT;
     }
 
-    if (copy_from_user(local_context->buffer + *offset, buffer, bytes_to_write)) {
+    if (copy_from_user(local_context->buffer.data + *offset, buffer, bytes_to_write)) {
         retval = -EFAULT;
         goto PROCFS_INODE_PROC_WRITE_EXIT;
     }
@@ -245,16 +370,184 @@ ssize_t procfs_inode_proc_write(struct file* file, const char __user* buffer, si
     // truncate on write instead of growing buffer size
 
     *offset += bytes_to_write;
-    local_context->size = *offset;
-    local_context->buffer[local_context->size] = '\0';
+    local_context->buffer.size = *offset;
+    local_context->buffer.data[local_context->buffer.size] = '\0';
     retval = bytes_to_write;
 
 PROCFS_INODE_PROC_WRITE_EXIT:
 
     mutex_unlock(&local_context->mutex);
+    trace_procfs_inode_write(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_inode_latency[PROCFS_INODE_LATENCY_WRITE], &timer);
+
+    if (retval > 0) {
+        lkmpg_genl_notify(&procfs_inode_genl, NULL);
+    }
+
+    return retval;
+
+}
+
+loff_t procfs_inode_proc_lseek(struct file* file, loff_t offset, int whence) {
+
+    // default_llseek() is what procfs uses when .proc_lseek is unset
+
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    loff_t retval = default_llseek(file, offset, whence);
+
+    trace_procfs_inode_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_inode_latency[PROCFS_INODE_LATENCY_SEEK], &timer);
+
+    return retval;
+
+}
+
+size_t procfs_inode_state_size(void) {
+    return PROCFS_INODE_BUFFER_SIZE;
+}
+
+ssize_t procfs_inode_state_dump(void* payload, size_t size) {
+
+    ssize_t length = 0;
+    struct procfs_inode_proc_context* context = procfs_inode_proc_context;
+
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    length = min(size, context->buffer.size);
+    memcpy(payload, context->buffer.data, length);
+    mutex_unlock(&context->mutex);
+
+    return length;
+
+}
+
+int procfs_inode_state_restore(const void* payload, size_t length) {
+
+    int retval = 0;
+    struct procfs_inode_proc_context* context = procfs_inode_proc_context;
+
+    if (length > PROCFS_INODE_BUFFER_SIZE) {
+        return -EINVAL;
+    }
+
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    // an empty dump leaves an empty buffer for the shrinker to release
+
+    if (!length) {
+        context->buffer.size = 0;
+        goto PROCFS_INODE_STATE_RESTORE_EXIT;
+    }
+
+    if ((retval = lkmpg_buffer_reserve(&context->buffer, PROCFS_INODE_BUFFER_SIZE))) {
+        goto PROCFS_INODE_STATE_RESTORE_EXIT;
+    }
+
+    memcpy(context->buffer.data, payload, length);
+    context->buffer.size = length;
+    context->buffer.data[length] = '\0';
+
+PROCFS_INODE_STATE_RESTORE_EXIT:
+
+    mutex_unlock(&context->mutex);
+
+    if (!retval) {
+        lkmpg_genl_notify(&procfs_inode_genl, NULL);
+    }
+
     return retval;
 
 }
 
+int procfs_inode_genl_fill(struct sk_buff* skb, const struct lkmpg_genl_change* change) {
+
+    // GET and events both carry the whole buffer
+
+    int retval = 0;
+    struct procfs_inode_proc_context* context = procfs_inode_proc_context;
+
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    context->buffer.used = jiffies;
+
+    if (nla_put_u32(skb, LKMPG_GENL_ATTR_SIZE, context->buffer.size) || nla_put(skb, LKMPG_GENL_ATTR_DATA, context->buffer.size, context->buffer.data)) {
+        retval = -EMSGSIZE;
+    }
+
+    mutex_unlock(&context->mutex);
+
+    return retval;
+
+}
+
+int procfs_inode_genl_set(struct genl_info* info) {
+
+    int retval = 0;
+    u32 offset = 0;
+    const struct nlattr* data = lkmpg_genl_data(info, PROCFS_INODE_BUFFER_SIZE, &offset);
+    struct procfs_inode_proc_context* context = procfs_inode_proc_context;
+
+    if (IS_ERR(data)) {
+        return PTR_ERR(data);
+    }
+
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
+    }
+
+    if (!(retval = lkmpg_buffer_reserve(&context->buffer, PROCFS_INODE_BUFFER_SIZE))) {
+        memcpy(context->buffer.data + offset, nla_data(data), nla_len(data));
+        context->buffer.size = offset + nla_len(data);
+        context->buffer.data[context->buffer.size] = '\0';
+    }
+
+    mutex_unlock(&context->mutex);
+
+    if (!retval) {
+        lkmpg_genl_notify(&procfs_inode_genl, NULL);
+    }
+
+    return retval;
+
+}
+
+unsigned long procfs_inode_shrinker_count(struct shrinker* shrinker, struct shrink_control* control) {
+
+    unsigned long count = 0;
+
+    if (mutex_trylock(&procfs_inode_proc_context->mutex)) {
+        count = lkmpg_buffer_reclaimable(&procfs_inode_proc_context->buffer);
+        mutex_unlock(&procfs_inode_proc_context->mutex);
+    }
+
+    return count;
+
+}
+
+unsigned long procfs_inode_shrinker_scan(struct shrinker* shrinker, struct shrink_control* control) {
+
+    unsigned long released = 0;
+
+    if (!mutex_trylock(&procfs_inode_proc_context->mutex)) {
+        return SHRINK_STOP;
+    }
+
+    released = lkmpg_buffer_compact(&procfs_inode_proc_context->buffer);
+    procfs_inode_param_reclaimed_bytes += released;
+    mutex_unlock(&procfs_inode_proc_context->mutex);
+
+    return released ? released : SHRINK_STOP;
+
+}
+
 module_init(procfs_inode_init);
 module_exit(procfs_inode_exit);
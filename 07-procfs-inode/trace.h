@@ -0,0 +1,46 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM procfs_inode
+
+// tracepoints for /proc/procfs-inode, enabled at runtime with
+//
+// echo 1 > /sys/kernel/tracing/events/procfs_inode/enable
+// perf trace -e 'procfs_inode:*'
+
+#if !defined(_PROCFS_INODE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PROCFS_INODE_TRACE_H
+
+#include "lkmpg-trace.h"
+
+DEFINE_EVENT(lkmpg_file, procfs_inode_open,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_file, procfs_inode_release,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_inode_read,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_inode_write,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_seek, procfs_inode_seek,
+    TP_PROTO(const struct file* file, loff_t offset, int whence, loff_t retval),
+    TP_ARGS(file, offset, whence, retval)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+#include <trace/define_trace.h>
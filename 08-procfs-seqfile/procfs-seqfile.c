@@ -9,7 +9,18 @@
 #include <linux/minmax.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
+#include <linux/slab.h>
 #include <linux/seq_file.h>
+#include <linux/jiffies.h>
+
+#include "lkmpg-genl.h"
+#include "lkmpg-latency.h"
+#include "lkmpg-parse.h"
+#include "lkmpg-shrinker.h"
+#include "lkmpg-state.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
 
 // read four entries from the sequence file starting at offset ten
 // - sed -n '10,14p' /proc/procfs-seqfile
@@ -28,52 +39,148 @@ MODULE_VERSION("0.1");
 #define PROCFS_SEQFILE_FILE_NAME "procfs-seqfile"
 
 #define PROCFS_SEQFILE_DATA_SIZE 256
+#define PROCFS_SEQFILE_DELIMITERS " ,\n"
 #define PROCFS_SEQFILE_FILE_PERMS 0666
 #define PROCFS_SEQFILE_FILE_PARENT NULL
 
+// /proc/procfs-seqfile-state dumps and restores all entries as the payload of
+// an include/lkmpg-state.h dump
+
+#define PROCFS_SEQFILE_STATE_NAME "procfs-seqfile-state"
+#define PROCFS_SEQFILE_STATE_MAGIC 0x70667373
+#define PROCFS_SEQFILE_STATE_VERSION 1
+
+// entry i holds i until it is written; the buffer is only allocated by the
+// first write, and released by the shrinker once it is idle and holds the
+// initial values again
+
+#define PROCFS_SEQFILE_IDLE_MS 1000
+
+// every entry reads as three digits and a newline, so the text of the file
+// has a fixed size, fits in the single page a seq_file starts with, and entry
+// i always starts at byte 4 * i
+
+#define PROCFS_SEQFILE_LINE_SIZE 4
+#define PROCFS_SEQFILE_TEXT_SIZE (PROCFS_SEQFILE_DATA_SIZE * PROCFS_SEQFILE_LINE_SIZE)
+
+// the file is a single_open() seq_file whose show copies text, which is
+// rendered by the first show after a change and released by the shrinker
+// once it is idle; seq_read_iter() then serves every read of that open file
+// from its own copy, from any offset
+
 struct procfs_seqfile_data {
-    u8 buffer[PROCFS_SEQFILE_DATA_SIZE];
+    u8* buffer;
+    char* text;
+    bool text_valid;
+    unsigned long used;
     struct mutex mutex;
 };
 
 static int __init procfs_seqfile_init(void);
 static void __exit procfs_seqfile_exit(void);
 
-static void* procfs_seqfile_seq_start(struct seq_file*, loff_t*);
-static void procfs_seqfile_seq_stop(struct seq_file*, void*);
-static void* procfs_seqfile_seq_next(struct seq_file*, void*, loff_t*);
-static int procfs_seqfile_seq_show(struct seq_file*, void*);
+static int procfs_seqfile_data_reserve(struct procfs_seqfile_data*);
+static bool procfs_seqfile_data_reclaimable(const struct procfs_seqfile_data*);
+static int procfs_seqfile_text_render(struct procfs_seqfile_data*);
+static bool procfs_seqfile_text_reclaimable(const struct procfs_seqfile_data*);
+static unsigned long procfs_seqfile_shrinker_count(struct shrinker*, struct shrink_control*);
+static unsigned long procfs_seqfile_shrinker_scan(struct shrinker*, struct shrink_control*);
 
-static const struct seq_operations procfs_seqfile_seq_ops = {
-    .start = procfs_seqfile_seq_start,
-    .stop = procfs_seqfile_seq_stop,
-    .next = procfs_seqfile_seq_next,
-    .show = procfs_seqfile_seq_show
-};
+int procfs_seqfile_seq_show(struct seq_file*, void*);
 
 int procfs_seqfile_proc_open(struct inode*, struct file*);
-ssize_t procfs_seqfile_proc_read(struct file*, char __user*, size_t, loff_t*);
+ssize_t procfs_seqfile_proc_read_iter(struct kiocb*, struct iov_iter*);
 ssize_t procfs_seqfile_proc_write(struct file*, const char __user*, size_t, loff_t*);
 loff_t procfs_seqfile_proc_lseek(struct file*, loff_t, int);
 int procfs_seqfile_proc_release(struct inode*, struct file*);
 
 static const struct proc_ops procfs_seqfile_proc_ops = {
     .proc_open = procfs_seqfile_proc_open,
-    .proc_read = procfs_seqfile_proc_read,
+    .proc_read_iter = procfs_seqfile_proc_read_iter,
     .proc_write = procfs_seqfile_proc_write,
-    .proc_lseek = seq_lseek,
+    .proc_lseek = procfs_seqfile_proc_lseek,
     .proc_release = procfs_seqfile_proc_release
 };
 
 static struct procfs_seqfile_data* procfs_seqfile_data = NULL;
 static struct proc_dir_entry* procfs_seqfile_file = NULL;
 
+// per-operation latency histograms, built with LATENCY=1; write records the
+// wait for the data mutex separately from the parse under it, while a read
+// takes the mutex inside seq_read_iter(), if at all, and is timed as a whole
+
+enum {
+    PROCFS_SEQFILE_LATENCY_OPEN,
+    PROCFS_SEQFILE_LATENCY_READ,
+    PROCFS_SEQFILE_LATENCY_WRITE,
+    PROCFS_SEQFILE_LATENCY_SEEK,
+    PROCFS_SEQFILE_LATENCY_RELEASE,
+    PROCFS_SEQFILE_LATENCY_COUNT
+};
+
+static struct lkmpg_latency procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_COUNT] = {
+    [PROCFS_SEQFILE_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [PROCFS_SEQFILE_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [PROCFS_SEQFILE_LATENCY_WRITE] = LKMPG_LATENCY_OP("write"),
+    [PROCFS_SEQFILE_LATENCY_SEEK] = LKMPG_LATENCY_OP("seek"),
+    [PROCFS_SEQFILE_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+};
+
+static struct lkmpg_latency_set procfs_seqfile_latency_set;
+
+static struct lkmpg_shrinker procfs_seqfile_shrinker;
+
+static size_t procfs_seqfile_state_size(void);
+static ssize_t procfs_seqfile_state_dump(void*, size_t);
+static int procfs_seqfile_state_restore(const void*, size_t);
+
+static const struct lkmpg_state_ops procfs_seqfile_state_ops = {
+    .magic = PROCFS_SEQFILE_STATE_MAGIC,
+    .version = PROCFS_SEQFILE_STATE_VERSION,
+    .size = procfs_seqfile_state_size,
+    .dump = procfs_seqfile_state_dump,
+    .restore = procfs_seqfile_state_restore,
+};
+
+static struct proc_dir_entry* procfs_seqfile_state_file = NULL;
+
+// generic netlink family (see include/lkmpg-genl.h); GET returns the SIZE and
+// DATA of all entries, or chunks of them with NLM_F_DUMP, SET writes DATA at
+// OFFSET and events carry the OFFSET, LENGTH and DATA of the entries written
+
+static int procfs_seqfile_genl_fill(struct sk_buff*, const struct lkmpg_genl_change*);
+static int procfs_seqfile_genl_fill_entries(struct sk_buff*, const struct procfs_seqfile_data*, size_t, size_t);
+static int procfs_seqfile_genl_set(struct genl_info*);
+static int procfs_seqfile_genl_dump(struct sk_buff*, struct netlink_callback*);
+static int procfs_seqfile_genl_dump_fill(struct sk_buff*, size_t);
+
+static const struct lkmpg_genl_ops procfs_seqfile_genl_ops = {
+    .set_attrs = BIT(LKMPG_GENL_ATTR_OFFSET) | BIT(LKMPG_GENL_ATTR_DATA),
+    .fill = procfs_seqfile_genl_fill,
+    .set = procfs_seqfile_genl_set,
+    .dumpit = procfs_seqfile_genl_dump,
+};
+
+static struct lkmpg_genl procfs_seqfile_genl = {
+    .family = {.name = PROCFS_SEQFILE_MODULE_NAME},
+    .ops = &procfs_seqfile_genl_ops,
+};
+
+static unsigned long procfs_seqfile_param_reclaimed_bytes = 0;
+module_param_named(reclaimed_bytes, procfs_seqfile_param_reclaimed_bytes, ulong, 0444);
+MODULE_PARM_DESC(reclaimed_bytes, "bytes of entries and rendered text released by the shrinker");
+
+// enable debug messages during initialization and cleanup; file operations
+// are traced through the procfs_seqfile tracepoints instead
+
 static bool procfs_seqfile_param_debug = false;
 module_param_named(debug, procfs_seqfile_param_debug, bool, 0);
 MODULE_PARM_DESC(debug, "enable debug messages");
 
 int __init procfs_seqfile_init(void) {
 
+    int retval = 0;
+
     // initialize private data for sequence file
 
     procfs_seqfile_data = kzalloc(sizeof(*procfs_seqfile_data), GFP_KERNEL);
@@ -85,10 +192,6 @@ int __init procfs_seqfile_init(void) {
 
     mutex_init(&procfs_seqfile_data->mutex);
 
-    for (int i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
-        procfs_seqfile_data->buffer[i] = i;
-    }
-
     // initialize sequence file in proc file system
 
     procfs_seqfile_file = proc_create_data(PROCFS_SEQFILE_FILE_NAME, PROCFS_SEQFILE_FILE_PERMS, PROCFS_SEQFILE_FILE_PARENT, &procfs_seqfile_proc_ops, procfs_seqfile_data);
@@ -99,6 +202,34 @@ int __init procfs_seqfile_init(void) {
         return -ENOMEM;
     }
 
+    procfs_seqfile_state_file = lkmpg_state_create(PROCFS_SEQFILE_STATE_NAME, &procfs_seqfile_state_ops);
+
+    if (!procfs_seqfile_state_file) {
+        proc_remove(procfs_seqfile_file);
+        kfree(procfs_seqfile_data);
+        pr_err("[%s:%s] failed to create /proc/%s\n", PROCFS_SEQFILE_MODULE_NAME, __func__, PROCFS_SEQFILE_STATE_NAME);
+        return -ENOMEM;
+    }
+
+    if ((retval = lkmpg_genl_register(&procfs_seqfile_genl))) {
+        proc_remove(procfs_seqfile_state_file);
+        proc_remove(procfs_seqfile_file);
+        kfree(procfs_seqfile_data);
+        pr_err("[%s:%s] failed to register generic netlink family: %d\n", PROCFS_SEQFILE_MODULE_NAME, __func__, retval);
+        return retval;
+    }
+
+    if (lkmpg_latency_register(&procfs_seqfile_latency_set, PROCFS_SEQFILE_MODULE_NAME, procfs_seqfile_latency, PROCFS_SEQFILE_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", PROCFS_SEQFILE_MODULE_NAME, __func__);
+    }
+
+    // without the shrinker the entries and their text stay allocated until
+    // the module is unloaded
+
+    if (lkmpg_shrinker_register(&procfs_seqfile_shrinker, PROCFS_SEQFILE_MODULE_NAME, procfs_seqfile_shrinker_count, procfs_seqfile_shrinker_scan)) {
+        pr_err("[%s:%s] failed to register shrinker\n", PROCFS_SEQFILE_MODULE_NAME, __func__);
+    }
+
     if (procfs_seqfile_param_debug) {
         pr_info("[%s:%s] created seqfile \"%s\" in procfs with permissions %04o\n", PROCFS_SEQFILE_MODULE_NAME, __func__, PROCFS_SEQFILE_FILE_NAME, PROCFS_SEQFILE_FILE_PERMS);
     }
@@ -109,9 +240,15 @@ int __init procfs_seqfile_init(void) {
 
 void __exit procfs_seqfile_exit(void) {
 
-    // remove module before freeing private data
+    // files before the family, see lkmpg_genl_register()
 
+    proc_remove(procfs_seqfile_state_file);
     proc_remove(procfs_seqfile_file);
+    lkmpg_genl_unregister(&procfs_seqfile_genl);
+    lkmpg_shrinker_unregister(&procfs_seqfile_shrinker);
+    lkmpg_latency_unregister(&procfs_seqfile_latency_set);
+    kfree(procfs_seqfile_data->buffer);
+    kfree(procfs_seqfile_data->text);
     kfree(procfs_seqfile_data);
 
     if (procfs_seqfile_param_debug) {
@@ -124,36 +261,60 @@ void __exit procfs_seqfile_exit(void) {
 
 int procfs_seqfile_proc_open(struct inode* inode, struct file* file) {
 
-    // open sequence file in proc file system with given sequence operations
+    int retval = 0;
+    struct lkmpg_latency_timer timer;
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] opening seqfile \"%s\" in procfs\n", PROCFS_SEQFILE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
-    }
+    lkmpg_latency_start(&timer);
+    retval = single_open(file, procfs_seqfile_seq_show, pde_data(inode));
+    trace_procfs_seqfile_open(file, retval);
+    lkmpg_latency_stop(&procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_OPEN], &timer);
 
-    return seq_open(file, &procfs_seqfile_seq_ops);
+    return retval;
 
 }
 
-ssize_t procfs_seqfile_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+int procfs_seqfile_seq_show(struct seq_file* seq, void* unused) {
 
-    // could set .proc_read to seq_read in proc_ops struct instead
+    // called by seq_read_iter() when a read starts at offset 0 or seeks back, so
+    // an unchanged file costs a copy of the cached text per open
 
-    if (!offset) {
-        pr_err("[%s:%s] invalid offset: %pK\n", PROCFS_SEQFILE_MODULE_NAME, __func__, offset);
-        return -EINVAL;
-    }
+    int retval = 0;
+    struct procfs_seqfile_data* context = seq->private;
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] reading seqfile \"%s\" in procfs (buffer.length = %zu, offset = %lld)\n", PROCFS_SEQFILE_MODULE_NAME, __func__, PROCFS_SEQFILE_FILE_NAME, length, *offset);
+    mutex_lock(&context->mutex);
+    context->used = jiffies;
+
+    if (!(retval = procfs_seqfile_text_render(context))) {
+        seq_write(seq, context->text, PROCFS_SEQFILE_TEXT_SIZE);
     }
 
-    return seq_read(file, buffer, length, offset);
+    mutex_unlock(&context->mutex);
+
+    return retval;
+
+}
+
+ssize_t procfs_seqfile_proc_read_iter(struct kiocb* iocb, struct iov_iter* to) {
+
+    ssize_t retval = 0;
+    loff_t position = iocb->ki_pos;
+    size_t length = iov_iter_count(to);
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+    retval = seq_read_iter(iocb, to);
+    lkmpg_latency_stop(&procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_READ], &timer);
+    trace_procfs_seqfile_read(iocb->ki_filp, length, position, retval);
+
+    return retval;
 
 }
 
 ssize_t procfs_seqfile_proc_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
 
     ssize_t retval = 0;
+    bool changed = false;
+    struct lkmpg_latency_timer timer;
     struct procfs_seqfile_data* context = pde_data(file_inode(file));
 
     if (!context) {
@@ -177,39 +338,47 @@ ssize_t procfs_seqfile_proc_write(struct file* file, const char __user* buffer,
     }
 
     kbuffer[length] = '\0';
+
+    // only the wait for the mutex and the update under it are timed
+
+    lkmpg_latency_start(&timer);
     mutex_lock(&context->mutex);
+    lkmpg_latency_locked(&timer);
+    context->used = jiffies;
 
-    // always write from buffer[0]
+    if ((retval = procfs_seqfile_data_reserve(context))) {
+        goto PROCFS_SEQFILE_PROC_WRITE_EXIT_UNLOCK;
+    }
 
-    int parsed = 0;
-    char* token = NULL;
-    char* iterator = kbuffer;
+    // a write that fails part way has still changed the entries before the
+    // bad token, so the text is invalidated either way
 
-    for (size_t i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
+    context->text_valid = false;
 
-        if (!(token = strsep(&iterator, " ,\n"))) {
-            break;
-        }
+    // always write from buffer[0]
 
-        if (token[0] == '\0') {
-            continue;
-        }
+    const char* token = NULL;
 
-        if ((retval = kstrtoint(token, 0, &parsed)) != 0) {
-            pr_err("[%s:%s] failed to parse token \"%s\" with error code %zd\n", PROCFS_SEQFILE_MODULE_NAME, __func__, token, retval);
-            goto PROCFS_SEQFILE_PROC_WRITE_EXIT_UNLOCK;
-        }
+    if ((retval = lkmpg_parse_u8_clamped(kbuffer, PROCFS_SEQFILE_DELIMITERS, context->buffer, PROCFS_SEQFILE_DATA_SIZE, &token))) {
+
+        pr_err("[%s:%s] failed to parse token \"%s\" with error code %zd\n", PROCFS_SEQFILE_MODULE_NAME, __func__, token, retval);
 
-        parsed = clamp(parsed, 0, U8_MAX);
-        context->buffer[i] = parsed;
+        // every token before the bad one was applied, and strsep() has
+        // turned the delimiters between them into nuls, so any other byte
+        // before it belongs to an entry that was written
+
+        changed = memchr_inv(kbuffer, '\0', token - kbuffer) != NULL;
+        goto PROCFS_SEQFILE_PROC_WRITE_EXIT_UNLOCK;
 
     }
 
+    changed = true;
     retval = length;
 
 PROCFS_SEQFILE_PROC_WRITE_EXIT_UNLOCK:
 
     mutex_unlock(&context->mutex);
+    lkmpg_latency_stop(&procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_WRITE], &timer);
 
 PROCFS_SEQFILE_PROC_WRITE_EXIT_FREE:
 
@@ -217,154 +386,319 @@ PROCFS_SEQFILE_PROC_WRITE_EXIT_FREE:
 
 PROCFS_SEQFILE_PROC_WRITE_EXIT:
 
+    trace_procfs_seqfile_write(file, length, *offset, retval);
+
+    // a write may change any number of entries from the first one, even
+    // when it fails
+
+    if (changed) {
+        lkmpg_genl_notify(&procfs_seqfile_genl, &(struct lkmpg_genl_change) {.length = PROCFS_SEQFILE_DATA_SIZE});
+    }
+
     return retval;
 
 }
 
 loff_t procfs_seqfile_proc_lseek(struct file* file, loff_t offset, int whence) {
 
-    // could set .proc_lseek to seq_lseek in proc_ops struct instead
+    // offsets are bytes of the text; seq_lseek() shows the file again to
+    // reach them, and like any seq_file it has no SEEK_END
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] seeking in seqfile \"%s\" in procfs (offset = %lld, whence = %d)\n", PROCFS_SEQFILE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name, offset, whence);
-    }
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    loff_t retval = seq_lseek(file, offset, whence);
 
-    return seq_lseek(file, offset, whence);
+    trace_procfs_seqfile_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_SEEK], &timer);
+
+    return retval;
 
 }
 
 int procfs_seqfile_proc_release(struct inode* inode, struct file* file) {
 
-    // could set .proc_release to seq_release in proc_ops struct instead
+    int retval = 0;
+    struct lkmpg_latency_timer timer;
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] releasing seqfile \"%s\" in procfs\n", PROCFS_SEQFILE_MODULE_NAME, __func__, file->f_path.dentry->d_name.name);
+    lkmpg_latency_start(&timer);
+    retval = single_release(inode, file);
+    trace_procfs_seqfile_release(file, retval);
+    lkmpg_latency_stop(&procfs_seqfile_latency[PROCFS_SEQFILE_LATENCY_RELEASE], &timer);
+
+    return retval;
+
+}
+
+size_t procfs_seqfile_state_size(void) {
+    return PROCFS_SEQFILE_DATA_SIZE;
+}
+
+ssize_t procfs_seqfile_state_dump(void* payload, size_t size) {
+
+    u8* entries = payload;
+    struct procfs_seqfile_data* context = procfs_seqfile_data;
+
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
     }
 
-    return seq_release(inode, file);
+    for (int i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
+        entries[i] = context->buffer ? context->buffer[i] : (u8) i;
+    }
+
+    mutex_unlock(&context->mutex);
+
+    return PROCFS_SEQFILE_DATA_SIZE;
 
 }
 
-static void* procfs_seqfile_seq_start(struct seq_file* seq, loff_t *pos) {
+int procfs_seqfile_state_restore(const void* payload, size_t length) {
 
-    // called at the beginning of a read operation
+    struct procfs_seqfile_data* context = procfs_seqfile_data;
 
-    if (!pos) {
-        pr_err("[%s:%s] invalid offset: %pK\n", PROCFS_SEQFILE_MODULE_NAME, __func__, pos);
-        return NULL;
+    if (length != PROCFS_SEQFILE_DATA_SIZE) {
+        return -EINVAL;
     }
 
-    if (*pos < 0) {
-        pr_err("[%s:%s] invalid offset: %lld\n", PROCFS_SEQFILE_MODULE_NAME, __func__, *pos);
-        return NULL;
+    if (mutex_lock_interruptible(&context->mutex)) {
+        return -ERESTARTSYS;
     }
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] starting sequence (offset = %lld)\n", PROCFS_SEQFILE_MODULE_NAME, __func__, *pos);
+    if (!context->buffer && !(context->buffer = kmalloc(PROCFS_SEQFILE_DATA_SIZE, GFP_KERNEL))) {
+        mutex_unlock(&context->mutex);
+        return -ENOMEM;
     }
 
-    // return null when the iterator is exhausted
+    // a dump of the initial values leaves the buffer for the shrinker
+
+    memcpy(context->buffer, payload, PROCFS_SEQFILE_DATA_SIZE);
+    context->text_valid = false;
+    context->used = jiffies;
+    mutex_unlock(&context->mutex);
+
+    lkmpg_genl_notify(&procfs_seqfile_genl, &(struct lkmpg_genl_change) {.length = PROCFS_SEQFILE_DATA_SIZE});
+
+    return 0;
+
+}
+
+int procfs_seqfile_data_reserve(struct procfs_seqfile_data* context) {
 
-    if (*pos >= PROCFS_SEQFILE_DATA_SIZE) {
-        return NULL;
+    // called with the data mutex held; the first write allocates the buffer
+    // with the values entries show until then
+
+    if (context->buffer) {
+        return 0;
     }
 
-    struct procfs_seqfile_data* context = pde_data(file_inode(seq->file));
+    if (!(context->buffer = kmalloc(PROCFS_SEQFILE_DATA_SIZE, GFP_KERNEL))) {
+        return -ENOMEM;
+    }
 
-    if (!context) {
-        pr_err("[%s:%s] failed to get private data for seqfile \"%s\" in procfs\n", PROCFS_SEQFILE_MODULE_NAME, __func__, seq->file->f_path.dentry->d_name.name);
-        return NULL;
+    for (int i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
+        context->buffer[i] = i;
     }
 
-    mutex_lock(&context->mutex);
-    seq->private = context;
+    return 0;
+
+}
 
-    return pos;
+bool procfs_seqfile_data_reclaimable(const struct procfs_seqfile_data* context) {
+
+    if (!context->buffer || time_before(jiffies, context->used + msecs_to_jiffies(PROCFS_SEQFILE_IDLE_MS))) {
+        return false;
+    }
+
+    for (int i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
+        if (context->buffer[i] != (u8) i) {
+            return false;
+        }
+    }
+
+    return true;
 
 }
 
-static void procfs_seqfile_seq_stop(struct seq_file* seq, void *iter) {
+int procfs_seqfile_text_render(struct procfs_seqfile_data* context) {
 
-    // called at the end of a read operation
+    // called with the data mutex held; each line is written digit by digit,
+    // which is all "%03u\n" does for a u8
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] stopping sequence\n", PROCFS_SEQFILE_MODULE_NAME, __func__);
+    if (context->text_valid) {
+        return 0;
     }
 
-    struct procfs_seqfile_data* context = seq->private;
+    if (!context->text && !(context->text = kmalloc(PROCFS_SEQFILE_TEXT_SIZE, GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < PROCFS_SEQFILE_DATA_SIZE; ++i) {
+
+        u8 value = context->buffer ? context->buffer[i] : (u8) i;
+        char* line = context->text + i * PROCFS_SEQFILE_LINE_SIZE;
+
+        line[0] = '0' + value / 100;
+        line[1] = '0' + value / 10 % 10;
+        line[2] = '0' + value % 10;
+        line[3] = '\n';
 
-    if (!context) {
-        pr_err("[%s:%s] failed to get private data for sequence file \"%s\" in proc file system\n", PROCFS_SEQFILE_MODULE_NAME, __func__, seq->file->f_path.dentry->d_name.name);
-        return;
     }
 
-    // the above check ensures that mutex_unlock is always correct
+    context->text_valid = true;
 
-    mutex_unlock(&context->mutex);
+    return 0;
 
-    return;
+}
+
+bool procfs_seqfile_text_reclaimable(const struct procfs_seqfile_data* context) {
+
+    // the text can always be rendered again, so it only has to be idle
+
+    return context->text && !time_before(jiffies, context->used + msecs_to_jiffies(PROCFS_SEQFILE_IDLE_MS));
 
 }
 
-static void* procfs_seqfile_seq_next(struct seq_file* seq, void *iter, loff_t* pos) {
+unsigned long procfs_seqfile_shrinker_count(struct shrinker* shrinker, struct shrink_control* control) {
 
-    // advance the iterator based on current position
+    unsigned long count = 0;
 
-    if (!pos) {
-        pr_err("[%s:%s] invalid offset: %pK\n", PROCFS_SEQFILE_MODULE_NAME, __func__, pos);
-        return NULL;
+    if (mutex_trylock(&procfs_seqfile_data->mutex)) {
+        count += procfs_seqfile_data_reclaimable(procfs_seqfile_data) ? PROCFS_SEQFILE_DATA_SIZE : 0;
+        count += procfs_seqfile_text_reclaimable(procfs_seqfile_data) ? PROCFS_SEQFILE_TEXT_SIZE : 0;
+        mutex_unlock(&procfs_seqfile_data->mutex);
     }
 
-    if (*pos < 0 || *pos >= PROCFS_SEQFILE_DATA_SIZE) {
-        pr_err("[%s:%s] invalid offset: %lld\n", PROCFS_SEQFILE_MODULE_NAME, __func__, *pos);
-        return NULL;
+    return count;
+
+}
+
+unsigned long procfs_seqfile_shrinker_scan(struct shrinker* shrinker, struct shrink_control* control) {
+
+    unsigned long released = 0;
+
+    if (!mutex_trylock(&procfs_seqfile_data->mutex)) {
+        return SHRINK_STOP;
     }
 
-    if (procfs_seqfile_param_debug) {
-        pr_info("[%s:%s] advancing iterator (position = %lld)\n", PROCFS_SEQFILE_MODULE_NAME, __func__, *pos);
+    if (procfs_seqfile_data_reclaimable(procfs_seqfile_data)) {
+        kfree(procfs_seqfile_data->buffer);
+        procfs_seqfile_data->buffer = NULL;
+        released += PROCFS_SEQFILE_DATA_SIZE;
     }
 
-    struct procfs_seqfile_data* context = seq->private;
+    if (procfs_seqfile_text_reclaimable(procfs_seqfile_data)) {
+        kfree(procfs_seqfile_data->text);
+        procfs_seqfile_data->text = NULL;
+        procfs_seqfile_data->text_valid = false;
+        released += PROCFS_SEQFILE_TEXT_SIZE;
+    }
 
-    if (!context) {
-        pr_err("[%s:%s] failed to get private data for seqfile \"%s\" in procfs\n", PROCFS_SEQFILE_MODULE_NAME, __func__, seq->file->f_path.dentry->d_name.name);
-        return NULL;
+    procfs_seqfile_param_reclaimed_bytes += released;
+
+    mutex_unlock(&procfs_seqfile_data->mutex);
+
+    return released ? released : SHRINK_STOP;
+
+}
+
+int procfs_seqfile_genl_fill(struct sk_buff* skb, const struct lkmpg_genl_change* change) {
+
+    // GET carries every entry, events the entries written
+
+    int retval = 0;
+    size_t offset = change ? change->offset : 0;
+    size_t length = change ? min_t(size_t, change->length, LKMPG_GENL_CHUNK_SIZE) : PROCFS_SEQFILE_DATA_SIZE;
+    struct procfs_seqfile_data* context = procfs_seqfile_data;
+
+    if (!change && nla_put_u32(skb, LKMPG_GENL_ATTR_SIZE, PROCFS_SEQFILE_DATA_SIZE)) {
+        return -EMSGSIZE;
+    }
+
+    mutex_lock(&context->mutex);
+    context->used = jiffies;
+    retval = procfs_seqfile_genl_fill_entries(skb, context, offset, length);
+    mutex_unlock(&context->mutex);
+
+    return retval;
+
+}
+
+int procfs_seqfile_genl_fill_entries(struct sk_buff* skb, const struct procfs_seqfile_data* context, size_t offset, size_t length) {
+
+    // called with the data mutex held; adds entries offset to offset + length
+
+    struct nlattr* data = nla_reserve(skb, LKMPG_GENL_ATTR_DATA, length);
+    u8* entries = NULL;
+
+    if (!data) {
+        return -EMSGSIZE;
     }
 
-    if (++*pos >= PROCFS_SEQFILE_DATA_SIZE) {
-        return NULL;
+    entries = nla_data(data);
+
+    for (size_t i = 0; i < length; ++i) {
+        entries[i] = context->buffer ? context->buffer[offset + i] : (u8) (offset + i);
     }
 
-    return pos;
+    return 0;
+
+}
 
+int procfs_seqfile_genl_dump(struct sk_buff* skb, struct netlink_callback* cb) {
+    return lkmpg_genl_dump_chunks(skb, cb, &procfs_seqfile_genl.family, procfs_seqfile_genl_dump_fill);
 }
 
-static int procfs_seqfile_seq_show(struct seq_file* seq, void *iter) {
+int procfs_seqfile_genl_dump_fill(struct sk_buff* skb, size_t offset) {
 
-    loff_t* pos = iter;
+    int retval = 0;
+    size_t length = 0;
+    struct procfs_seqfile_data* context = procfs_seqfile_data;
 
-    if (!pos) {
-        pr_err("[%s:%s] invalid iterator: %pK\n", PROCFS_SEQFILE_MODULE_NAME, __func__, pos);
-        return -EINVAL;
+    if (offset >= PROCFS_SEQFILE_DATA_SIZE) {
+        return 0;
     }
 
-    if (*pos < 0 || *pos >= PROCFS_SEQFILE_DATA_SIZE) {
-        pr_err("[%s:%s] invalid iterator: %lld\n", PROCFS_SEQFILE_MODULE_NAME, __func__, *pos);
-        return -EINVAL;
+    length = min_t(size_t, LKMPG_GENL_CHUNK_SIZE, PROCFS_SEQFILE_DATA_SIZE - offset);
+
+    mutex_lock(&context->mutex);
+    context->used = jiffies;
+    retval = procfs_seqfile_genl_fill_entries(skb, context, offset, length);
+    mutex_unlock(&context->mutex);
+
+    return retval ? retval : (int) length;
+
+}
+
+int procfs_seqfile_genl_set(struct genl_info* info) {
+
+    // entries are raw bytes here, so there is nothing to parse or clamp
+
+    int retval = 0;
+    u32 offset = 0;
+    const struct nlattr* data = lkmpg_genl_data(info, PROCFS_SEQFILE_DATA_SIZE, &offset);
+    struct procfs_seqfile_data* context = procfs_seqfile_data;
+
+    if (IS_ERR(data)) {
+        return PTR_ERR(data);
     }
 
-	struct procfs_seqfile_data* context = seq->private;
+    mutex_lock(&context->mutex);
+    context->used = jiffies;
 
-    if (!context) {
-        pr_err("[%s:%s] failed to get private data for seqfile \"%s\" in procfs\n", PROCFS_SEQFILE_MODULE_NAME, __func__, seq->file->f_path.dentry->d_name.name);
-        return -EINVAL;
+    if (!(retval = procfs_seqfile_data_reserve(context))) {
+        memcpy(context->buffer + offset, nla_data(data), nla_len(data));
+        context->text_valid = false;
     }
 
-    // always show four bytes for easy testing with dd
+    mutex_unlock(&context->mutex);
 
-    seq_printf(seq, "%03u\n", context->buffer[*pos]);
+    if (!retval) {
+        lkmpg_genl_notify(&procfs_seqfile_genl, &(struct lkmpg_genl_change) {.offset = offset, .length = nla_len(data)});
+    }
 
-    return 0;
+    return retval;
 
 }
 
@@ -0,0 +1,46 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM procfs_seqfile
+
+// tracepoints for /proc/procfs-seqfile, enabled at runtime with
+//
+// echo 1 > /sys/kernel/tracing/events/procfs_seqfile/enable
+// perf trace -e 'procfs_seqfile:*'
+
+#if !defined(_PROCFS_SEQFILE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PROCFS_SEQFILE_TRACE_H
+
+#include "lkmpg-trace.h"
+
+DEFINE_EVENT(lkmpg_file, procfs_seqfile_open,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_file, procfs_seqfile_release,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_seqfile_read,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_seqfile_write,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_seek, procfs_seqfile_seek,
+    TP_PROTO(const struct file* file, loff_t offset, int whence, loff_t retval),
+    TP_ARGS(file, offset, whence, retval)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+#include <trace/define_trace.h>
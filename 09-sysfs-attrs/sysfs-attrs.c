@@ -2,11 +2,29 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/moduleparam.h>
-#include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/cache.h>
 #include <linux/kobject.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/sysfs.h>
+#include <linux/types.h>
 #include <linux/minmax.h>
+#include <linux/version.h>
+
+#include "lkmpg-genl.h"
+#include "lkmpg-latency.h"
+#include "lkmpg-parse.h"
+#include "lkmpg-state.h"
+#include "tunables.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
@@ -20,6 +38,35 @@ static void __exit sysfs_attrs_exit(void);
 
 static struct kobject* sysfs_attrs_kobj = NULL;
 
+// per-operation latency histograms, built with LATENCY=1 and shared by all
+// attributes of a kind; stores record the wait for the seqlock or the staging
+// mutex separately from the update, shows are lock-free except in staging
+
+enum {
+    SYSFS_ATTRS_LATENCY_SHOW,
+    SYSFS_ATTRS_LATENCY_STORE,
+    SYSFS_ATTRS_LATENCY_READ,
+    SYSFS_ATTRS_LATENCY_WRITE,
+    SYSFS_ATTRS_LATENCY_MMAP,
+    SYSFS_ATTRS_LATENCY_COUNT
+};
+
+static struct lkmpg_latency sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_COUNT] = {
+    [SYSFS_ATTRS_LATENCY_SHOW] = LKMPG_LATENCY_OP("show"),
+    [SYSFS_ATTRS_LATENCY_STORE] = LKMPG_LATENCY_OP("store"),
+    [SYSFS_ATTRS_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [SYSFS_ATTRS_LATENCY_WRITE] = LKMPG_LATENCY_OP("write"),
+    [SYSFS_ATTRS_LATENCY_MMAP] = LKMPG_LATENCY_OP("mmap"),
+};
+
+static struct lkmpg_latency_set sysfs_attrs_latency_set;
+
+// every show and store returns through these so that the tracepoints and the
+// histograms see the final result without a second exit path in each attribute
+
+static ssize_t sysfs_attrs_show_done(const struct kobj_attribute*, struct lkmpg_latency_timer*, ssize_t);
+static ssize_t sysfs_attrs_store_done(const struct kobj_attribute*, struct lkmpg_latency_timer*, size_t, ssize_t);
+
 // boolean, signed integer and string attributes
 
 #define SYSFS_ATTRS_ATTR_BOOL_NAME attr-bool
@@ -44,27 +91,43 @@ static ssize_t sysfs_attrs_attr_int_store(struct kobject* kobj, struct kobj_attr
 static ssize_t sysfs_attrs_attr_string_show(struct kobject* kobj, struct kobj_attribute* attr, char* buf);
 static ssize_t sysfs_attrs_attr_string_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
 
+// show never sleeps or contends: the scalars are single atomic words and the
+// string is an immutable buffer published with rcu and freed with kfree_rcu;
+// each attribute sits on its own cache line so that a store to one attribute
+// does not invalidate the line holding another
+
+struct sysfs_attrs_string_value {
+    struct rcu_head rcu;
+    size_t length;
+    char data[];
+};
+
+static struct sysfs_attrs_string_value* sysfs_attrs_string_value_alloc(const char* buffer, size_t size, ssize_t* copied);
+static void sysfs_attrs_notify(const struct kobj_attribute* kattr);
+
+// the generation of an attribute counts the stores that changed its value; it
+// is only modified with the seqlock held for writing
+
 struct sysfs_attrs_attr_bool {
-    bool value;
-    struct mutex mutex;
+    atomic_t value;
+    u32 generation;
     struct kobj_attribute kattr;
-};
+} ____cacheline_aligned_in_smp;
 
 struct sysfs_attrs_attr_int {
-    int value;
-    struct mutex mutex;
+    atomic_t value;
+    u32 generation;
     struct kobj_attribute kattr;
-};
+} ____cacheline_aligned_in_smp;
 
 struct sysfs_attrs_attr_string {
-    char value[SYSFS_ATTRS_ATTR_STRING_SIZE];
-    struct mutex mutex;
+    struct sysfs_attrs_string_value __rcu* value;
+    u32 generation;
     struct kobj_attribute kattr;
-};
+} ____cacheline_aligned_in_smp;
 
 static struct sysfs_attrs_attr_bool sysfs_attrs_attr_bool = {
-    .value = SYSFS_ATTRS_ATTR_BOOL_INIT,
-    .mutex = __MUTEX_INITIALIZER(sysfs_attrs_attr_bool.mutex),
+    .value = ATOMIC_INIT(SYSFS_ATTRS_ATTR_BOOL_INIT),
     .kattr = __ATTR(
         SYSFS_ATTRS_ATTR_BOOL_NAME,
         SYSFS_ATTRS_ATTR_BOOL_MODE,
@@ -74,8 +137,7 @@ static struct sysfs_attrs_attr_bool sysfs_attrs_attr_bool = {
 };
 
 static struct sysfs_attrs_attr_int sysfs_attrs_attr_int = {
-    .value = SYSFS_ATTRS_ATTR_INT_INIT,
-    .mutex = __MUTEX_INITIALIZER(sysfs_attrs_attr_int.mutex),
+    .value = ATOMIC_INIT(SYSFS_ATTRS_ATTR_INT_INIT),
     .kattr = __ATTR(
         SYSFS_ATTRS_ATTR_INT_NAME,
         SYSFS_ATTRS_ATTR_INT_MODE,
@@ -84,9 +146,10 @@ static struct sysfs_attrs_attr_int sysfs_attrs_attr_int = {
     )
 };
 
+// the string value is published in sysfs_attrs_init()
+
 static struct sysfs_attrs_attr_string sysfs_attrs_attr_string = {
-    .value = SYSFS_ATTRS_ATTR_STRING_INIT,
-    .mutex = __MUTEX_INITIALIZER(sysfs_attrs_attr_string.mutex),
+    .value = NULL,
     .kattr = __ATTR(
         SYSFS_ATTRS_ATTR_STRING_NAME,
         SYSFS_ATTRS_ATTR_STRING_MODE,
@@ -95,6 +158,18 @@ static struct sysfs_attrs_attr_string sysfs_attrs_attr_string = {
     )
 };
 
+// writers serialize on the seqlock so that readers which need all values at
+// once can take a consistent snapshot without blocking the writers
+
+static DEFINE_SEQLOCK(sysfs_attrs_seqlock);
+
+// apply a new value to an attribute with the seqlock held for writing and
+// return whether the value changed (a replaced string is returned in value)
+
+static bool sysfs_attrs_attr_bool_apply(struct sysfs_attrs_attr_bool* self, bool value);
+static bool sysfs_attrs_attr_int_apply(struct sysfs_attrs_attr_int* self, int value);
+static bool sysfs_attrs_attr_string_apply(struct sysfs_attrs_attr_string* self, struct sysfs_attrs_string_value** value);
+
 // attribute group for boolean, signed integer and string attributes
 
 static struct attribute* sysfs_attrs_array[] = {
@@ -108,126 +183,2139 @@ static const struct attribute_group sysfs_attrs_group = {
     .attrs = sysfs_attrs_array,
 };
 
+// staged attributes under staging/ hold shadow values that writing 1 to
+// staging/commit publishes in a single seqlock write section (writing 0
+// discards them); readers of the snapshot or the page never observe a
+// partially applied set of staged values
+
+#define SYSFS_ATTRS_STAGING_NAME "staging"
+#define SYSFS_ATTRS_STAGING_COMMIT_NAME commit
+#define SYSFS_ATTRS_STAGING_COMMIT_MODE 0220
+
+enum {
+    SYSFS_ATTRS_STAGED_BOOL = 0,
+    SYSFS_ATTRS_STAGED_INT,
+    SYSFS_ATTRS_STAGED_STRING,
+};
+
+static ssize_t sysfs_attrs_staging_bool_show(struct kobject* kobj, struct kobj_attribute* attr, char* buf);
+static ssize_t sysfs_attrs_staging_bool_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
+
+static ssize_t sysfs_attrs_staging_int_show(struct kobject* kobj, struct kobj_attribute* attr, char* buf);
+static ssize_t sysfs_attrs_staging_int_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
+
+static ssize_t sysfs_attrs_staging_string_show(struct kobject* kobj, struct kobj_attribute* attr, char* buf);
+static ssize_t sysfs_attrs_staging_string_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
+
+static ssize_t sysfs_attrs_staging_commit_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
+
+// the mutex only serializes staging writers and is never taken by the live
+// show paths; a staged attribute shows its live value until it is staged
+
+struct sysfs_attrs_staging {
+    struct mutex mutex;
+    unsigned long staged;
+    bool attr_bool;
+    int attr_int;
+    struct sysfs_attrs_string_value* attr_string;
+};
+
+static struct sysfs_attrs_staging sysfs_attrs_staging = {
+    .mutex = __MUTEX_INITIALIZER(sysfs_attrs_staging.mutex),
+    .staged = 0,
+    .attr_bool = SYSFS_ATTRS_ATTR_BOOL_INIT,
+    .attr_int = SYSFS_ATTRS_ATTR_INT_INIT,
+    .attr_string = NULL,
+};
+
+static struct kobj_attribute sysfs_attrs_staging_bool_attr = __ATTR(
+    SYSFS_ATTRS_ATTR_BOOL_NAME,
+    SYSFS_ATTRS_ATTR_BOOL_MODE,
+    sysfs_attrs_staging_bool_show,
+    sysfs_attrs_staging_bool_store
+);
+
+static struct kobj_attribute sysfs_attrs_staging_int_attr = __ATTR(
+    SYSFS_ATTRS_ATTR_INT_NAME,
+    SYSFS_ATTRS_ATTR_INT_MODE,
+    sysfs_attrs_staging_int_show,
+    sysfs_attrs_staging_int_store
+);
+
+static struct kobj_attribute sysfs_attrs_staging_string_attr = __ATTR(
+    SYSFS_ATTRS_ATTR_STRING_NAME,
+    SYSFS_ATTRS_ATTR_STRING_MODE,
+    sysfs_attrs_staging_string_show,
+    sysfs_attrs_staging_string_store
+);
+
+static struct kobj_attribute sysfs_attrs_staging_commit_attr = __ATTR(
+    SYSFS_ATTRS_STAGING_COMMIT_NAME,
+    SYSFS_ATTRS_STAGING_COMMIT_MODE,
+    NULL,
+    sysfs_attrs_staging_commit_store
+);
+
+static struct attribute* sysfs_attrs_staging_array[] = {
+    &sysfs_attrs_staging_bool_attr.attr,
+    &sysfs_attrs_staging_int_attr.attr,
+    &sysfs_attrs_staging_string_attr.attr,
+    &sysfs_attrs_staging_commit_attr.attr,
+    NULL,
+};
+
+static const struct attribute_group sysfs_attrs_staging_group = {
+    .name = SYSFS_ATTRS_STAGING_NAME,
+    .attrs = sysfs_attrs_staging_array,
+};
+
+// tunables from the table in tunables.h, in a "tunables" directory of their
+// own: a tunable costs its value, a struct attribute and a descriptor, with
+// no lock, show or store of its own; the directory dispatches every show and
+// store through one sysfs_ops, which finds the descriptor of an attribute
+// from its index in sysfs_attrs_tunable_attrs
+//
+// values are at most 32 bits wide, so READ_ONCE() and WRITE_ONCE() keep them
+// consistent without a lock, and concurrent stores simply race to the last
+
+#define SYSFS_ATTRS_TUNABLES_NAME "tunables"
+#define SYSFS_ATTRS_TUNABLES_MODE 0644
+
+#define SYSFS_ATTRS_TUNABLE(name) READ_ONCE(sysfs_attrs_tunables.name)
+
+enum sysfs_attrs_tunable_type {
+    SYSFS_ATTRS_TUNABLE_TYPE_bool = 0,
+    SYSFS_ATTRS_TUNABLE_TYPE_u8,
+    SYSFS_ATTRS_TUNABLE_TYPE_u16,
+    SYSFS_ATTRS_TUNABLE_TYPE_u32,
+    SYSFS_ATTRS_TUNABLE_TYPE_s32,
+};
+
+enum {
+#define SYSFS_ATTRS_TUNABLE_INDEX(name, type, min, max, init) SYSFS_ATTRS_TUNABLE_##name,
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_INDEX)
+#undef SYSFS_ATTRS_TUNABLE_INDEX
+    SYSFS_ATTRS_TUNABLE_COUNT
+};
+
+struct sysfs_attrs_tunables {
+#define SYSFS_ATTRS_TUNABLE_FIELD(name, type, min, max, init) type name;
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_FIELD)
+#undef SYSFS_ATTRS_TUNABLE_FIELD
+};
+
+struct sysfs_attrs_tunable {
+    s64 min;
+    s64 max;
+    u16 offset;
+    u8 type;
+};
+
+static struct sysfs_attrs_tunables sysfs_attrs_tunables = {
+#define SYSFS_ATTRS_TUNABLE_INIT(name, type, min, max, init) .name = (init),
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_INIT)
+#undef SYSFS_ATTRS_TUNABLE_INIT
+};
+
+static const struct sysfs_attrs_tunable sysfs_attrs_tunable_table[SYSFS_ATTRS_TUNABLE_COUNT] = {
+#define SYSFS_ATTRS_TUNABLE_DESC(name, type, min, max, init) \
+    [SYSFS_ATTRS_TUNABLE_##name] = { \
+        .min = (min), \
+        .max = (max), \
+        .offset = offsetof(struct sysfs_attrs_tunables, name), \
+        .type = SYSFS_ATTRS_TUNABLE_TYPE_##type, \
+    },
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_DESC)
+#undef SYSFS_ATTRS_TUNABLE_DESC
+};
+
+static struct attribute sysfs_attrs_tunable_attrs[SYSFS_ATTRS_TUNABLE_COUNT] = {
+#define SYSFS_ATTRS_TUNABLE_ATTR(name, type, min, max, init) \
+    [SYSFS_ATTRS_TUNABLE_##name] = { .name = #name, .mode = SYSFS_ATTRS_TUNABLES_MODE },
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_ATTR)
+#undef SYSFS_ATTRS_TUNABLE_ATTR
+};
+
+// filled in by sysfs_attrs_init() rather than spelled out a second time
+
+static struct attribute* sysfs_attrs_tunables_array[SYSFS_ATTRS_TUNABLE_COUNT + 1];
+
+static const struct attribute_group sysfs_attrs_tunables_group = {
+    .attrs = sysfs_attrs_tunables_array,
+};
+
+static struct kobject* sysfs_attrs_tunables_kobj = NULL;
+
+static s64 sysfs_attrs_tunable_get(const struct sysfs_attrs_tunable* tunable);
+static void sysfs_attrs_tunable_set(const struct sysfs_attrs_tunable* tunable, s64 value);
+static void sysfs_attrs_tunable_notify(size_t index);
+static ssize_t sysfs_attrs_tunables_show(struct kobject* kobj, struct attribute* attr, char* buf);
+static ssize_t sysfs_attrs_tunables_store(struct kobject* kobj, struct attribute* attr, const char* buf, size_t count);
+static void sysfs_attrs_tunables_release(struct kobject* kobj);
+
+static const struct sysfs_ops sysfs_attrs_tunables_sysfs_ops = {
+    .show = sysfs_attrs_tunables_show,
+    .store = sysfs_attrs_tunables_store,
+};
+
+static struct kobj_type sysfs_attrs_tunables_ktype = {
+    .release = sysfs_attrs_tunables_release,
+    .sysfs_ops = &sysfs_attrs_tunables_sysfs_ops,
+};
+
+// binary attribute returning every attribute value in one read, taken as a
+// single consistent snapshot (all fields are in native byte order)
+
+#define SYSFS_ATTRS_SNAPSHOT_NAME "snapshot"
+#define SYSFS_ATTRS_SNAPSHOT_MODE 0444
+#define SYSFS_ATTRS_SNAPSHOT_MAGIC 0x73617474
+#define SYSFS_ATTRS_SNAPSHOT_VERSION 2
+
+struct sysfs_attrs_snapshot {
+    u32 magic;
+    u16 version;
+    u16 size;
+    u32 sequence;
+    u8 attr_bool;
+    u8 reserved[3];
+    s32 attr_int;
+    u32 attr_string_length;
+    char attr_string[SYSFS_ATTRS_ATTR_STRING_SIZE];
+    u32 attr_bool_generation;
+    u32 attr_int_generation;
+    u32 attr_string_generation;
+} __packed;
+
+// the bin_attribute argument of read() is const since 6.16
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 16, 0)
+#define SYSFS_ATTRS_BIN_ATTR_CONST const
+#else
+#define SYSFS_ATTRS_BIN_ATTR_CONST
+#endif
+
+static void sysfs_attrs_snapshot_fill(struct sysfs_attrs_snapshot* snapshot);
+static ssize_t sysfs_attrs_snapshot_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count);
+
+static struct bin_attribute sysfs_attrs_snapshot_attr = {
+    .attr = {
+        .name = SYSFS_ATTRS_SNAPSHOT_NAME,
+        .mode = SYSFS_ATTRS_SNAPSHOT_MODE,
+    },
+    .size = sizeof(struct sysfs_attrs_snapshot),
+    .read = sysfs_attrs_snapshot_read,
+};
+
+// binary attribute exposing a read-only page that userspace can map to read
+// the attribute values with plain loads; the page is rewritten by every store
+// and follows the usual sequence counter protocol: read sequence, retry while
+// it is odd, read the values, then retry if sequence has changed
+//
+//     offset  size  field
+//          0     4  magic
+//          4     2  version
+//          6     2  size
+//          8     4  sequence
+//         12     4  reserved
+//         16     1  attr_bool
+//         17     3  reserved
+//         20     4  attr_int
+//         24     4  attr_string_length
+//         28  1024  attr_string (null-terminated)
+//       1052     4  attr_bool_generation
+//       1056     4  attr_int_generation
+//       1060     4  attr_string_generation
+
+#define SYSFS_ATTRS_PAGE_NAME "page"
+#define SYSFS_ATTRS_PAGE_MODE 0444
+#define SYSFS_ATTRS_PAGE_MAGIC 0x73617470
+#define SYSFS_ATTRS_PAGE_VERSION 2
+
+struct sysfs_attrs_page {
+    u32 magic;
+    u16 version;
+    u16 size;
+    u32 sequence;
+    u32 reserved;
+    u8 attr_bool;
+    u8 reserved_bool[3];
+    s32 attr_int;
+    u32 attr_string_length;
+    char attr_string[SYSFS_ATTRS_ATTR_STRING_SIZE];
+    u32 attr_bool_generation;
+    u32 attr_int_generation;
+    u32 attr_string_generation;
+};
+
+// the bin_attribute argument of mmap() is const since 6.13
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define SYSFS_ATTRS_BIN_MMAP_CONST const
+#else
+#define SYSFS_ATTRS_BIN_MMAP_CONST
+#endif
+
+static struct sysfs_attrs_page* sysfs_attrs_page = NULL;
+
+static void sysfs_attrs_page_update(void);
+static int sysfs_attrs_page_mmap(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_MMAP_CONST struct bin_attribute* battr, struct vm_area_struct* vma);
+
+static struct bin_attribute sysfs_attrs_page_attr = {
+    .attr = {
+        .name = SYSFS_ATTRS_PAGE_NAME,
+        .mode = SYSFS_ATTRS_PAGE_MODE,
+    },
+    .size = PAGE_SIZE,
+    .mmap = sysfs_attrs_page_mmap,
+};
+
+// unsigned 32-bit and signed 64-bit vector attributes sized by a module
+// parameter; the text attribute parses or formats the whole vector in one
+// pass (a store may update a prefix of the vector) and the binary attribute
+// loads or dumps the raw native-endian elements with memcpy; the text output
+// is truncated to PAGE_SIZE by sysfs so large vectors should use the binary
+// attribute
+
+#define SYSFS_ATTRS_ATTR_U32_VECTOR_NAME attr-u32-vector
+#define SYSFS_ATTRS_ATTR_S64_VECTOR_NAME attr-s64-vector
+#define SYSFS_ATTRS_ATTR_U32_VECTOR_BIN_NAME "attr-u32-vector-bin"
+#define SYSFS_ATTRS_ATTR_S64_VECTOR_BIN_NAME "attr-s64-vector-bin"
+
+#define SYSFS_ATTRS_ATTR_VECTOR_MODE 0664
+#define SYSFS_ATTRS_ATTR_VECTOR_SIZE 512
+#define SYSFS_ATTRS_ATTR_VECTOR_SIZE_MAX 65536
+#define SYSFS_ATTRS_ATTR_VECTOR_DELIMITERS " ,\t\n"
+
+static unsigned int sysfs_attrs_param_vector_size = SYSFS_ATTRS_ATTR_VECTOR_SIZE;
+module_param_named(vector_size, sysfs_attrs_param_vector_size, uint, 0444);
+MODULE_PARM_DESC(vector_size, "number of elements in each vector attribute");
+
+enum sysfs_attrs_vector_type {
+    SYSFS_ATTRS_VECTOR_U32 = 0,
+    SYSFS_ATTRS_VECTOR_S64,
+};
+
+// readers retry on the seqlock instead of blocking the writers
+
+struct sysfs_attrs_attr_vector {
+    seqlock_t seqlock;
+    enum sysfs_attrs_vector_type type;
+    size_t element_size;
+    size_t length;
+    void* values;
+    struct kobj_attribute kattr;
+    struct bin_attribute battr;
+} ____cacheline_aligned_in_smp;
+
+static ssize_t sysfs_attrs_attr_vector_show(struct kobject* kobj, struct kobj_attribute* attr, char* buf);
+static ssize_t sysfs_attrs_attr_vector_store(struct kobject* kobj, struct kobj_attribute* attr, const char* buf, size_t count);
+
+static ssize_t sysfs_attrs_attr_vector_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count);
+static ssize_t sysfs_attrs_attr_vector_write(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count);
+
+static int sysfs_attrs_attr_vector_alloc(struct sysfs_attrs_attr_vector* self, size_t length);
+static void sysfs_attrs_vector_notify(struct sysfs_attrs_attr_vector* self, size_t offset, size_t length);
+static int sysfs_attrs_vector_parse(enum sysfs_attrs_vector_type type, char* input, void* values, size_t length, size_t* parsed);
+static size_t sysfs_attrs_vector_format(enum sysfs_attrs_vector_type type, char* buffer, size_t size, const void* values, size_t length);
+
+static struct sysfs_attrs_attr_vector sysfs_attrs_attr_u32_vector = {
+    .seqlock = __SEQLOCK_UNLOCKED(sysfs_attrs_attr_u32_vector.seqlock),
+    .type = SYSFS_ATTRS_VECTOR_U32,
+    .element_size = sizeof(u32),
+    .kattr = __ATTR(
+        SYSFS_ATTRS_ATTR_U32_VECTOR_NAME,
+        SYSFS_ATTRS_ATTR_VECTOR_MODE,
+        sysfs_attrs_attr_vector_show,
+        sysfs_attrs_attr_vector_store
+    ),
+    .battr = {
+        .attr = {
+            .name = SYSFS_ATTRS_ATTR_U32_VECTOR_BIN_NAME,
+            .mode = SYSFS_ATTRS_ATTR_VECTOR_MODE,
+        },
+        .read = sysfs_attrs_attr_vector_read,
+        .write = sysfs_attrs_attr_vector_write,
+        .private = &sysfs_attrs_attr_u32_vector,
+    },
+};
+
+static struct sysfs_attrs_attr_vector sysfs_attrs_attr_s64_vector = {
+    .seqlock = __SEQLOCK_UNLOCKED(sysfs_attrs_attr_s64_vector.seqlock),
+    .type = SYSFS_ATTRS_VECTOR_S64,
+    .element_size = sizeof(s64),
+    .kattr = __ATTR(
+        SYSFS_ATTRS_ATTR_S64_VECTOR_NAME,
+        SYSFS_ATTRS_ATTR_VECTOR_MODE,
+        sysfs_attrs_attr_vector_show,
+        sysfs_attrs_attr_vector_store
+    ),
+    .battr = {
+        .attr = {
+            .name = SYSFS_ATTRS_ATTR_S64_VECTOR_BIN_NAME,
+            .mode = SYSFS_ATTRS_ATTR_VECTOR_MODE,
+        },
+        .read = sysfs_attrs_attr_vector_read,
+        .write = sysfs_attrs_attr_vector_write,
+        .private = &sysfs_attrs_attr_s64_vector,
+    },
+};
+
+static struct attribute* sysfs_attrs_vector_array[] = {
+    &sysfs_attrs_attr_u32_vector.kattr.attr,
+    &sysfs_attrs_attr_s64_vector.kattr.attr,
+    NULL,
+};
+
+static const struct attribute_group sysfs_attrs_vector_group = {
+    .attrs = sysfs_attrs_vector_array,
+};
+
+// binary attribute holding a checksummed dump of every attribute value and
+// vector element in the format of lkmpg-state.h, for restoring the values
+// after a reload; sysfs moves binary data at most a page at a time, so a
+// dump is taken when a read starts at offset 0 and later chunks are copied
+// from it, and a restore is staged chunk by chunk and applied when the last
+// byte of the dump has been written (cat and dd both loop over the chunks)
+//
+// the scalars and each vector are consistent on their own, and a dump can be
+// restored into a module loaded with the same or a larger vector_size, which
+// updates a prefix of the vectors like the text attributes do
+//
+//     offset  size  field
+//          0     1  attr_bool
+//          1     1  tunable_count
+//          2     2  reserved
+//          4     4  attr_int
+//          8     4  attr_string_length
+//         12     4  vector_length
+//         16  1024  attr_string (null-terminated)
+//       1040   8*t  tunables (s64, in the order of tunables.h)
+//          -   4*n  u32 vector
+//          -   8*n  s64 vector
+
+#define SYSFS_ATTRS_STATE_NAME "state"
+#define SYSFS_ATTRS_STATE_MODE 0600
+#define SYSFS_ATTRS_STATE_MAGIC 0x73617373
+#define SYSFS_ATTRS_STATE_VERSION 2
+
+struct sysfs_attrs_state_payload {
+    u8 attr_bool;
+    u8 tunable_count;
+    u8 reserved[2];
+    s32 attr_int;
+    u32 attr_string_length;
+    u32 vector_length;
+    char attr_string[SYSFS_ATTRS_ATTR_STRING_SIZE];
+    s64 tunables[SYSFS_ATTRS_TUNABLE_COUNT];
+    u8 vectors[];
+} __packed;
+
+// the dump and the staged restore are shared by every open file, so
+// interleaved readers or writers can mix chunks of different dumps; the
+// checksum rejects such a mix on restore
+
+struct sysfs_attrs_state {
+    struct mutex mutex;
+    struct lkmpg_state_header* dump;
+    struct lkmpg_state_header* restore;
+};
+
+static struct sysfs_attrs_state sysfs_attrs_state = {
+    .mutex = __MUTEX_INITIALIZER(sysfs_attrs_state.mutex),
+    .dump = NULL,
+    .restore = NULL,
+};
+
+static size_t sysfs_attrs_state_size(size_t vector_length);
+static void sysfs_attrs_state_dump(struct lkmpg_state_header* header);
+static int sysfs_attrs_state_restore(const struct sysfs_attrs_state_payload* payload, size_t length);
+
+static ssize_t sysfs_attrs_state_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count);
+static ssize_t sysfs_attrs_state_write(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count);
+
+static struct bin_attribute sysfs_attrs_state_attr = {
+    .attr = {
+        .name = SYSFS_ATTRS_STATE_NAME,
+        .mode = SYSFS_ATTRS_STATE_MODE,
+    },
+    .read = sysfs_attrs_state_read,
+    .write = sysfs_attrs_state_write,
+};
+
+// generic netlink family (see include/lkmpg-genl.h); GET returns BOOL, INT,
+// STRING, TUNABLES and the SIZE of the vectors, and with NLM_F_DUMP the
+// vectors as chunks holding both U32_VECTOR and S64_VECTOR from the same
+// OFFSET
+//
+// SET applies TUNABLES, then BOOL, INT and STRING under the seqlock at once,
+// like a staging commit, then writes U32_VECTOR and S64_VECTOR at OFFSET;
+// every value is validated before anything is applied
+//
+// events carry what GET returns after a scalar changed, or the OFFSET,
+// LENGTH and first elements of the changed part of a vector
+
+static int sysfs_attrs_genl_fill(struct sk_buff*, const struct lkmpg_genl_change*);
+static int sysfs_attrs_genl_fill_vector(struct sk_buff*, const struct sysfs_attrs_attr_vector*, size_t, size_t);
+static int sysfs_attrs_genl_dump(struct sk_buff*, struct netlink_callback*);
+static int sysfs_attrs_genl_dump_fill(struct sk_buff*, size_t);
+static int sysfs_attrs_genl_fill_tunables(struct sk_buff*);
+static int sysfs_attrs_genl_check_vector(struct genl_info*, const struct sysfs_attrs_attr_vector*, int, size_t);
+static int sysfs_attrs_genl_check_tunables(struct genl_info*, s64*, unsigned long*);
+static int sysfs_attrs_genl_set(struct genl_info*);
+
+static const struct lkmpg_genl_ops sysfs_attrs_genl_ops = {
+    .set_attrs = BIT(LKMPG_GENL_ATTR_OFFSET) | BIT(LKMPG_GENL_ATTR_BOOL) | BIT(LKMPG_GENL_ATTR_INT) | BIT(LKMPG_GENL_ATTR_STRING) | BIT(LKMPG_GENL_ATTR_U32_VECTOR) | BIT(LKMPG_GENL_ATTR_S64_VECTOR) | BIT(LKMPG_GENL_ATTR_TUNABLES),
+    .fill = sysfs_attrs_genl_fill,
+    .set = sysfs_attrs_genl_set,
+    .dumpit = sysfs_attrs_genl_dump,
+};
+
+static struct lkmpg_genl sysfs_attrs_genl = {
+    .family = {.name = SYSFS_ATTRS_MODULE_NAME},
+    .ops = &sysfs_attrs_genl_ops,
+};
+
+// binary attributes are created one at a time because the type of
+// attribute_group.bin_attrs differs between kernel versions
+
+static struct bin_attribute* sysfs_attrs_bin_array[] = {
+    &sysfs_attrs_snapshot_attr,
+    &sysfs_attrs_page_attr,
+    &sysfs_attrs_attr_u32_vector.battr,
+    &sysfs_attrs_attr_s64_vector.battr,
+    &sysfs_attrs_state_attr,
+    NULL,
+};
+
 int __init sysfs_attrs_init(void) {
 
     int retval = 0;
+    ssize_t copied = 0;
+    struct bin_attribute** battr = NULL;
+    struct sysfs_attrs_string_value* string_value = NULL;
+
+    // the page layout is naturally aligned so the offsets above are fixed
+
+    BUILD_BUG_ON(offsetof(struct sysfs_attrs_page, attr_string) != 28);
+    BUILD_BUG_ON(offsetof(struct sysfs_attrs_page, attr_bool_generation) != 1052);
+    BUILD_BUG_ON(sizeof(struct sysfs_attrs_page) > PAGE_SIZE);
+    BUILD_BUG_ON(offsetof(struct sysfs_attrs_state_payload, tunables) != 1040);
+
+    // descriptors store offsets in 16 bits, the state dump counts tunables in
+    // 8 bits, and initial values must be in range for a dump of the tunables
+    // to be storable again
+
+    BUILD_BUG_ON(sizeof(struct sysfs_attrs_tunables) > U16_MAX);
+    BUILD_BUG_ON(SYSFS_ATTRS_TUNABLE_COUNT > U8_MAX);
+
+#define SYSFS_ATTRS_TUNABLE_CHECK(name, type, min, max, init) BUILD_BUG_ON((init) < (min) || (init) > (max));
+    SYSFS_ATTRS_TUNABLES(SYSFS_ATTRS_TUNABLE_CHECK)
+#undef SYSFS_ATTRS_TUNABLE_CHECK
+
+    // publish the initial string value before the attribute becomes visible
+
+    string_value = sysfs_attrs_string_value_alloc(SYSFS_ATTRS_ATTR_STRING_INIT, sizeof(SYSFS_ATTRS_ATTR_STRING_INIT), &copied);
+
+    if (!string_value) {
+        pr_err("[%s:%s] failed to allocate initial string value\n", SYSFS_ATTRS_MODULE_NAME, __func__);
+        return -ENOMEM;
+    }
+
+    RCU_INIT_POINTER(sysfs_attrs_attr_string.value, string_value);
+
+    // populate the mappable page before it can be mapped
+
+    sysfs_attrs_page = (struct sysfs_attrs_page*) get_zeroed_page(GFP_KERNEL);
+
+    if (!sysfs_attrs_page) {
+        pr_err("[%s:%s] failed to allocate attribute page\n", SYSFS_ATTRS_MODULE_NAME, __func__);
+        retval = -ENOMEM;
+        goto SYSFS_ATTRS_INIT_EXIT_STRING;
+    }
+
+    sysfs_attrs_page->magic = SYSFS_ATTRS_PAGE_MAGIC;
+    sysfs_attrs_page->version = SYSFS_ATTRS_PAGE_VERSION;
+    sysfs_attrs_page->size = sizeof(*sysfs_attrs_page);
+    sysfs_attrs_page_update();
+
+    // allocate vectors before sizing their binary attributes
+
+    if (!sysfs_attrs_param_vector_size || sysfs_attrs_param_vector_size > SYSFS_ATTRS_ATTR_VECTOR_SIZE_MAX) {
+        pr_err("[%s:%s] invalid vector size %u (maximum = %u)\n", SYSFS_ATTRS_MODULE_NAME, __func__, sysfs_attrs_param_vector_size, SYSFS_ATTRS_ATTR_VECTOR_SIZE_MAX);
+        retval = -EINVAL;
+        goto SYSFS_ATTRS_INIT_EXIT_PAGE;
+    }
+
+    if ((retval = sysfs_attrs_attr_vector_alloc(&sysfs_attrs_attr_u32_vector, sysfs_attrs_param_vector_size))) {
+        pr_err("[%s:%s] failed to allocate vector (length = %u)\n", SYSFS_ATTRS_MODULE_NAME, __func__, sysfs_attrs_param_vector_size);
+        goto SYSFS_ATTRS_INIT_EXIT_PAGE;
+    }
+
+    if ((retval = sysfs_attrs_attr_vector_alloc(&sysfs_attrs_attr_s64_vector, sysfs_attrs_param_vector_size))) {
+        pr_err("[%s:%s] failed to allocate vector (length = %u)\n", SYSFS_ATTRS_MODULE_NAME, __func__, sysfs_attrs_param_vector_size);
+        goto SYSFS_ATTRS_INIT_EXIT_VECTORS;
+    }
+
+    // the state dump covers both vectors, so it is sized after them and
+    // filled once so that a read starting past offset 0 sees a valid dump
+
+    sysfs_attrs_state_attr.size = sysfs_attrs_state_size(sysfs_attrs_param_vector_size);
+    sysfs_attrs_state.dump = kvzalloc(sysfs_attrs_state_attr.size, GFP_KERNEL);
+    sysfs_attrs_state.restore = kvzalloc(sysfs_attrs_state_attr.size, GFP_KERNEL);
+
+    if (!sysfs_attrs_state.dump || !sysfs_attrs_state.restore) {
+        pr_err("[%s:%s] failed to allocate state buffers (size = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, sysfs_attrs_state_attr.size);
+        retval = -ENOMEM;
+        goto SYSFS_ATTRS_INIT_EXIT_STATE;
+    }
+
+    sysfs_attrs_state_dump(sysfs_attrs_state.dump);
 
     sysfs_attrs_kobj = kobject_create_and_add(SYSFS_ATTRS_MODULE_NAME, kernel_kobj);
 
     if (!sysfs_attrs_kobj) {
         pr_err("[%s:%s] failed to create or add kobject: %pK\n", SYSFS_ATTRS_MODULE_NAME, __func__, sysfs_attrs_kobj);
-        return -ENOMEM;
+        retval = -ENOMEM;
+        goto SYSFS_ATTRS_INIT_EXIT_STATE;
     }
 
     retval = sysfs_create_group(sysfs_attrs_kobj, &sysfs_attrs_group);
 
     if (retval) {
         pr_err("[%s:%s] failed to create attribute group: %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, retval);
-        kobject_put(sysfs_attrs_kobj);
-        return retval;
+        goto SYSFS_ATTRS_INIT_EXIT_KOBJ;
+    }
+
+    retval = sysfs_create_group(sysfs_attrs_kobj, &sysfs_attrs_staging_group);
+
+    if (retval) {
+        pr_err("[%s:%s] failed to create attribute group \"%s\": %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, SYSFS_ATTRS_STAGING_NAME, retval);
+        goto SYSFS_ATTRS_INIT_EXIT_GROUP;
+    }
+
+    retval = sysfs_create_group(sysfs_attrs_kobj, &sysfs_attrs_vector_group);
+
+    if (retval) {
+        pr_err("[%s:%s] failed to create vector attribute group: %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, retval);
+        goto SYSFS_ATTRS_INIT_EXIT_STAGING;
+    }
+
+    for (battr = sysfs_attrs_bin_array; *battr; ++battr) {
+
+        retval = sysfs_create_bin_file(sysfs_attrs_kobj, *battr);
+
+        if (retval) {
+            pr_err("[%s:%s] failed to create binary attribute \"%s\": %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, (*battr)->attr.name, retval);
+            goto SYSFS_ATTRS_INIT_EXIT_BIN;
+        }
+
+    }
+
+    // the tunables directory needs its own kobject, since its attributes
+    // are plain struct attributes rather than kobj_attributes
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        sysfs_attrs_tunables_array[i] = &sysfs_attrs_tunable_attrs[i];
+    }
+
+    if (!(sysfs_attrs_tunables_kobj = kzalloc(sizeof(*sysfs_attrs_tunables_kobj), GFP_KERNEL))) {
+        pr_err("[%s:%s] failed to allocate kobject \"%s\"\n", SYSFS_ATTRS_MODULE_NAME, __func__, SYSFS_ATTRS_TUNABLES_NAME);
+        retval = -ENOMEM;
+        goto SYSFS_ATTRS_INIT_EXIT_BIN;
+    }
+
+    if ((retval = kobject_init_and_add(sysfs_attrs_tunables_kobj, &sysfs_attrs_tunables_ktype, sysfs_attrs_kobj, SYSFS_ATTRS_TUNABLES_NAME))) {
+        pr_err("[%s:%s] failed to add kobject \"%s\": %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, SYSFS_ATTRS_TUNABLES_NAME, retval);
+        goto SYSFS_ATTRS_INIT_EXIT_TUNABLES;
+    }
+
+    if ((retval = sysfs_create_group(sysfs_attrs_tunables_kobj, &sysfs_attrs_tunables_group))) {
+        pr_err("[%s:%s] failed to create attribute group \"%s\": %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, SYSFS_ATTRS_TUNABLES_NAME, retval);
+        goto SYSFS_ATTRS_INIT_EXIT_TUNABLES;
+    }
+
+    if ((retval = lkmpg_genl_register(&sysfs_attrs_genl))) {
+        pr_err("[%s:%s] failed to register generic netlink family: %d\n", SYSFS_ATTRS_MODULE_NAME, __func__, retval);
+        goto SYSFS_ATTRS_INIT_EXIT_TUNABLES_GROUP;
+    }
+
+    // the histograms are diagnostics only, so the attributes work without them
+
+    if (lkmpg_latency_register(&sysfs_attrs_latency_set, SYSFS_ATTRS_MODULE_NAME, sysfs_attrs_latency, SYSFS_ATTRS_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", SYSFS_ATTRS_MODULE_NAME, __func__);
+    }
+
+    return retval;
+
+SYSFS_ATTRS_INIT_EXIT_TUNABLES_GROUP:
+
+    sysfs_remove_group(sysfs_attrs_tunables_kobj, &sysfs_attrs_tunables_group);
+
+SYSFS_ATTRS_INIT_EXIT_TUNABLES:
+
+    // frees the kobject through sysfs_attrs_tunables_release(), also when
+    // kobject_init_and_add() failed
+
+    kobject_put(sysfs_attrs_tunables_kobj);
+
+SYSFS_ATTRS_INIT_EXIT_BIN:
+
+    while (battr-- != sysfs_attrs_bin_array) {
+        sysfs_remove_bin_file(sysfs_attrs_kobj, *battr);
     }
 
+    sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_vector_group);
+
+SYSFS_ATTRS_INIT_EXIT_STAGING:
+
+    sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_staging_group);
+
+SYSFS_ATTRS_INIT_EXIT_GROUP:
+
+    sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_group);
+
+SYSFS_ATTRS_INIT_EXIT_KOBJ:
+
+    kobject_put(sysfs_attrs_kobj);
+
+SYSFS_ATTRS_INIT_EXIT_STATE:
+
+    kvfree(sysfs_attrs_state.restore);
+    kvfree(sysfs_attrs_state.dump);
+
+SYSFS_ATTRS_INIT_EXIT_VECTORS:
+
+    kvfree(sysfs_attrs_attr_s64_vector.values);
+    kvfree(sysfs_attrs_attr_u32_vector.values);
+
+SYSFS_ATTRS_INIT_EXIT_PAGE:
+
+    free_page((unsigned long) sysfs_attrs_page);
+
+SYSFS_ATTRS_INIT_EXIT_STRING:
+
+    kfree(string_value);
     return retval;
 
 }
 
 void __exit sysfs_attrs_exit(void) {
 
+    // attributes before the family and sysfs_attrs_kobj after it, see
+    // lkmpg_genl_register()
+
+    sysfs_remove_group(sysfs_attrs_tunables_kobj, &sysfs_attrs_tunables_group);
+    kobject_put(sysfs_attrs_tunables_kobj);
+
+    for (struct bin_attribute** battr = sysfs_attrs_bin_array; *battr; ++battr) {
+        sysfs_remove_bin_file(sysfs_attrs_kobj, *battr);
+    }
+
+    sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_vector_group);
+    sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_staging_group);
     sysfs_remove_group(sysfs_attrs_kobj, &sysfs_attrs_group);
+    lkmpg_genl_unregister(&sysfs_attrs_genl);
     kobject_put(sysfs_attrs_kobj);
+    lkmpg_latency_unregister(&sysfs_attrs_latency_set);
+
+    // no readers remain once the attributes and the family are gone
+
+    kfree(sysfs_attrs_staging.attr_string);
+    kfree(rcu_dereference_protected(sysfs_attrs_attr_string.value, 1));
+    kvfree(sysfs_attrs_state.restore);
+    kvfree(sysfs_attrs_state.dump);
+    kvfree(sysfs_attrs_attr_s64_vector.values);
+    kvfree(sysfs_attrs_attr_u32_vector.values);
+
+    // existing mappings hold their own reference to the page
+
+    free_page((unsigned long) sysfs_attrs_page);
 
     return;
 
 }
 
+struct sysfs_attrs_string_value* sysfs_attrs_string_value_alloc(const char* buffer, size_t size, ssize_t* copied) {
+
+    struct sysfs_attrs_string_value* value = kmalloc(struct_size(value, data, size), GFP_KERNEL);
+
+    if (!value) {
+        return NULL;
+    }
+
+    *copied = strscpy(value->data, buffer, size);
+    value->length = strlen(value->data);
+
+    return value;
+
+}
+
+ssize_t sysfs_attrs_show_done(const struct kobj_attribute* kattr, struct lkmpg_latency_timer* timer, ssize_t retval) {
+
+    trace_sysfs_attrs_show(kattr->attr.name, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_SHOW], timer);
+
+    return retval;
+
+}
+
+ssize_t sysfs_attrs_store_done(const struct kobj_attribute* kattr, struct lkmpg_latency_timer* timer, size_t bytes, ssize_t retval) {
+
+    trace_sysfs_attrs_store(kattr->attr.name, bytes, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_STORE], timer);
+
+    return retval;
+
+}
+
 ssize_t sysfs_attrs_attr_bool_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
 
-    ssize_t bytes = 0;
+    struct lkmpg_latency_timer timer;
     struct sysfs_attrs_attr_bool* self = container_of(kattr, struct sysfs_attrs_attr_bool, kattr);
 
-    mutex_lock(&self->mutex);
-    bytes = sysfs_emit(buffer, "%d\n", self->value);
-    mutex_unlock(&self->mutex);
+    lkmpg_latency_start(&timer);
 
-    return bytes;
+    return sysfs_attrs_show_done(kattr, &timer, sysfs_emit(buffer, "%d\n", atomic_read(&self->value)));
 
 }
 
 ssize_t sysfs_attrs_attr_bool_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
 
+    struct lkmpg_latency_timer timer;
     ssize_t error = 0;
     bool value = false;
+    bool changed = false;
     struct sysfs_attrs_attr_bool* self = container_of(kattr, struct sysfs_attrs_attr_bool, kattr);
 
+    lkmpg_latency_start(&timer);
+
     if ((error = kstrtobool(buffer, &value))) {
         pr_err("[%s:%s] failed to parse input as bool (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
-        return error;
+        return sysfs_attrs_store_done(kattr, &timer, bytes, error);
     }
 
-    mutex_lock(&self->mutex);
-    self->value = value;
-    mutex_unlock(&self->mutex);
+    write_seqlock(&sysfs_attrs_seqlock);
+    lkmpg_latency_locked(&timer);
 
-    return bytes;
+    if ((changed = sysfs_attrs_attr_bool_apply(self, value))) {
+        sysfs_attrs_page_update();
+    }
+
+    write_sequnlock(&sysfs_attrs_seqlock);
+
+    if (changed) {
+        sysfs_attrs_notify(kattr);
+    }
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, bytes);
 
 }
 
 ssize_t sysfs_attrs_attr_int_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
 
-    ssize_t bytes = 0;
+    struct lkmpg_latency_timer timer;
     struct sysfs_attrs_attr_int* self = container_of(kattr, struct sysfs_attrs_attr_int, kattr);
 
-    mutex_lock(&self->mutex);
-    bytes = sysfs_emit(buffer, "%d\n", self->value);
-    mutex_unlock(&self->mutex);
+    lkmpg_latency_start(&timer);
 
-    return bytes;
+    return sysfs_attrs_show_done(kattr, &timer, sysfs_emit(buffer, "%d\n", atomic_read(&self->value)));
 
 }
 
 ssize_t sysfs_attrs_attr_int_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
 
+    struct lkmpg_latency_timer timer;
     ssize_t error = 0;
     int value = 0;
+    bool changed = false;
     struct sysfs_attrs_attr_int* self = container_of(kattr, struct sysfs_attrs_attr_int, kattr);
 
+    lkmpg_latency_start(&timer);
+
     if ((error = kstrtoint(buffer, 0, &value))) {
         pr_err("[%s:%s] failed to parse input as signed integer (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
-        return error;
+        return sysfs_attrs_store_done(kattr, &timer, bytes, error);
     }
 
-    mutex_lock(&self->mutex);
-    self->value = value;
-    mutex_unlock(&self->mutex);
+    write_seqlock(&sysfs_attrs_seqlock);
+    lkmpg_latency_locked(&timer);
 
-    return bytes;
+    if ((changed = sysfs_attrs_attr_int_apply(self, value))) {
+        sysfs_attrs_page_update();
+    }
+
+    write_sequnlock(&sysfs_attrs_seqlock);
+
+    if (changed) {
+        sysfs_attrs_notify(kattr);
+    }
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, bytes);
 
 }
 
 ssize_t sysfs_attrs_attr_string_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
 
+    struct lkmpg_latency_timer timer;
     ssize_t bytes = 0;
     struct sysfs_attrs_attr_string* self = container_of(kattr, struct sysfs_attrs_attr_string, kattr);
 
-    mutex_lock(&self->mutex);
-    bytes = sysfs_emit(buffer, "%s\n", self->value);
-    mutex_unlock(&self->mutex);
+    lkmpg_latency_start(&timer);
 
-    return bytes;
+    rcu_read_lock();
+    bytes = sysfs_emit(buffer, "%s\n", rcu_dereference(self->value)->data);
+    rcu_read_unlock();
+
+    return sysfs_attrs_show_done(kattr, &timer, bytes);
 
 }
 
 ssize_t sysfs_attrs_attr_string_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
 
+    struct lkmpg_latency_timer timer;
     ssize_t copied = 0;
+    bool changed = false;
+    struct sysfs_attrs_string_value* value = NULL;
     struct sysfs_attrs_attr_string* self = container_of(kattr, struct sysfs_attrs_attr_string, kattr);
 
-    mutex_lock(&self->mutex);
-    copied = strscpy(self->value, buffer, SYSFS_ATTRS_ATTR_STRING_SIZE);
-    mutex_unlock(&self->mutex);
+    lkmpg_latency_start(&timer);
+
+    // sysfs null-terminates buffer so bytes + 1 is enough to hold the input
+
+    value = sysfs_attrs_string_value_alloc(buffer, min_t(size_t, bytes + 1, SYSFS_ATTRS_ATTR_STRING_SIZE), &copied);
+
+    if (!value) {
+        pr_err("[%s:%s] failed to allocate string value (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        return sysfs_attrs_store_done(kattr, &timer, bytes, -ENOMEM);
+    }
+
+    write_seqlock(&sysfs_attrs_seqlock);
+    lkmpg_latency_locked(&timer);
+
+    if ((changed = sysfs_attrs_attr_string_apply(self, &value))) {
+        sysfs_attrs_page_update();
+    }
 
-    return copied == bytes ? bytes : copied;
+    write_sequnlock(&sysfs_attrs_seqlock);
+
+    // the value being replaced is freed once all current readers have left
+    // their rcu read-side critical sections; an unchanged value is dropped
+    // without ever being published
+
+    if (changed) {
+        sysfs_attrs_notify(kattr);
+        kfree_rcu(value, rcu);
+    } else {
+        kfree(value);
+    }
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, copied == bytes ? bytes : copied);
+
+}
+
+bool sysfs_attrs_attr_bool_apply(struct sysfs_attrs_attr_bool* self, bool value) {
+
+    if (atomic_xchg(&self->value, value) == value) {
+        return false;
+    }
+
+    ++self->generation;
+    return true;
+
+}
+
+bool sysfs_attrs_attr_int_apply(struct sysfs_attrs_attr_int* self, int value) {
+
+    if (atomic_xchg(&self->value, value) == value) {
+        return false;
+    }
+
+    ++self->generation;
+    return true;
+
+}
+
+bool sysfs_attrs_attr_string_apply(struct sysfs_attrs_attr_string* self, struct sysfs_attrs_string_value** value) {
+
+    const struct sysfs_attrs_string_value* current_value = rcu_dereference_protected(self->value, lockdep_is_held(&sysfs_attrs_seqlock.lock));
+
+    if (!strcmp(current_value->data, (*value)->data)) {
+        return false;
+    }
+
+    *value = rcu_replace_pointer(self->value, *value, lockdep_is_held(&sysfs_attrs_seqlock.lock));
+    ++self->generation;
+    return true;
+
+}
+
+ssize_t sysfs_attrs_staging_bool_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t bytes = 0;
+
+    lkmpg_latency_start(&timer);
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+
+    if (test_bit(SYSFS_ATTRS_STAGED_BOOL, &sysfs_attrs_staging.staged)) {
+        bytes = sysfs_emit(buffer, "%d\n", sysfs_attrs_staging.attr_bool);
+    } else {
+        bytes = sysfs_emit(buffer, "%d\n", atomic_read(&sysfs_attrs_attr_bool.value));
+    }
+
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    return sysfs_attrs_show_done(kattr, &timer, bytes);
+
+}
+
+ssize_t sysfs_attrs_staging_bool_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t error = 0;
+    bool value = false;
+
+    lkmpg_latency_start(&timer);
+
+    if ((error = kstrtobool(buffer, &value))) {
+        pr_err("[%s:%s] failed to parse input as bool (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        return sysfs_attrs_store_done(kattr, &timer, bytes, error);
+    }
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+    sysfs_attrs_staging.attr_bool = value;
+    __set_bit(SYSFS_ATTRS_STAGED_BOOL, &sysfs_attrs_staging.staged);
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, bytes);
+
+}
+
+ssize_t sysfs_attrs_staging_int_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t bytes = 0;
+
+    lkmpg_latency_start(&timer);
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+
+    if (test_bit(SYSFS_ATTRS_STAGED_INT, &sysfs_attrs_staging.staged)) {
+        bytes = sysfs_emit(buffer, "%d\n", sysfs_attrs_staging.attr_int);
+    } else {
+        bytes = sysfs_emit(buffer, "%d\n", atomic_read(&sysfs_attrs_attr_int.value));
+    }
+
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    return sysfs_attrs_show_done(kattr, &timer, bytes);
+
+}
+
+ssize_t sysfs_attrs_staging_int_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t error = 0;
+    int value = 0;
+
+    lkmpg_latency_start(&timer);
+
+    if ((error = kstrtoint(buffer, 0, &value))) {
+        pr_err("[%s:%s] failed to parse input as signed integer (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        return sysfs_attrs_store_done(kattr, &timer, bytes, error);
+    }
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+    sysfs_attrs_staging.attr_int = value;
+    __set_bit(SYSFS_ATTRS_STAGED_INT, &sysfs_attrs_staging.staged);
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, bytes);
+
+}
+
+ssize_t sysfs_attrs_staging_string_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t bytes = 0;
+
+    lkmpg_latency_start(&timer);
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+
+    if (test_bit(SYSFS_ATTRS_STAGED_STRING, &sysfs_attrs_staging.staged)) {
+        bytes = sysfs_emit(buffer, "%s\n", sysfs_attrs_staging.attr_string->data);
+    } else {
+        rcu_read_lock();
+        bytes = sysfs_emit(buffer, "%s\n", rcu_dereference(sysfs_attrs_attr_string.value)->data);
+        rcu_read_unlock();
+    }
+
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    return sysfs_attrs_show_done(kattr, &timer, bytes);
+
+}
+
+ssize_t sysfs_attrs_staging_string_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t copied = 0;
+    struct sysfs_attrs_string_value* value = NULL;
+
+    lkmpg_latency_start(&timer);
+
+    value = sysfs_attrs_string_value_alloc(buffer, min_t(size_t, bytes + 1, SYSFS_ATTRS_ATTR_STRING_SIZE), &copied);
+
+    if (!value) {
+        pr_err("[%s:%s] failed to allocate string value (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        return sysfs_attrs_store_done(kattr, &timer, bytes, -ENOMEM);
+    }
+
+    // staged strings are never visible to rcu readers so they are swapped and
+    // freed directly
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+    lkmpg_latency_locked(&timer);
+    swap(sysfs_attrs_staging.attr_string, value);
+    __set_bit(SYSFS_ATTRS_STAGED_STRING, &sysfs_attrs_staging.staged);
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    kfree(value);
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, copied == bytes ? bytes : copied);
+
+}
+
+ssize_t sysfs_attrs_staging_commit_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t error = 0;
+    bool commit = false;
+    unsigned long changed = 0;
+    struct sysfs_attrs_string_value* string_value = NULL;
+
+    lkmpg_latency_start(&timer);
+
+    if ((error = kstrtobool(buffer, &commit))) {
+        pr_err("[%s:%s] failed to parse input as bool (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        return sysfs_attrs_store_done(kattr, &timer, bytes, error);
+    }
+
+    mutex_lock(&sysfs_attrs_staging.mutex);
+
+    // take ownership of the staged string so that it is either published or
+    // freed below, together with whatever value it replaces
+
+    string_value = sysfs_attrs_staging.attr_string;
+    sysfs_attrs_staging.attr_string = NULL;
+
+    if (commit && sysfs_attrs_staging.staged) {
+
+        write_seqlock(&sysfs_attrs_seqlock);
+        lkmpg_latency_locked(&timer);
+
+        if (test_bit(SYSFS_ATTRS_STAGED_BOOL, &sysfs_attrs_staging.staged) && sysfs_attrs_attr_bool_apply(&sysfs_attrs_attr_bool, sysfs_attrs_staging.attr_bool)) {
+            __set_bit(SYSFS_ATTRS_STAGED_BOOL, &changed);
+        }
+
+        if (test_bit(SYSFS_ATTRS_STAGED_INT, &sysfs_attrs_staging.staged) && sysfs_attrs_attr_int_apply(&sysfs_attrs_attr_int, sysfs_attrs_staging.attr_int)) {
+            __set_bit(SYSFS_ATTRS_STAGED_INT, &changed);
+        }
+
+        if (test_bit(SYSFS_ATTRS_STAGED_STRING, &sysfs_attrs_staging.staged) && sysfs_attrs_attr_string_apply(&sysfs_attrs_attr_string, &string_value)) {
+            __set_bit(SYSFS_ATTRS_STAGED_STRING, &changed);
+        }
+
+        if (changed) {
+            sysfs_attrs_page_update();
+        }
+
+        write_sequnlock(&sysfs_attrs_seqlock);
+
+    }
+
+    sysfs_attrs_staging.staged = 0;
+    mutex_unlock(&sysfs_attrs_staging.mutex);
+
+    if (test_bit(SYSFS_ATTRS_STAGED_BOOL, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_bool.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_INT, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_int.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_STRING, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_string.kattr);
+        kfree_rcu(string_value, rcu);
+    } else {
+        kfree(string_value);
+    }
+
+    return sysfs_attrs_store_done(kattr, &timer, bytes, bytes);
+
+}
+
+void sysfs_attrs_notify(const struct kobj_attribute* kattr) {
+
+    // sysfs_notify() may sleep so it is called after the seqlock is released;
+    // it wakes pollers waiting for POLLPRI on the attribute and on the
+    // snapshot, and netlink listeners get the new values as an event
+
+    if (!SYSFS_ATTRS_TUNABLE(notify)) {
+        return;
+    }
+
+    sysfs_notify(sysfs_attrs_kobj, NULL, kattr->attr.name);
+    sysfs_notify(sysfs_attrs_kobj, NULL, SYSFS_ATTRS_SNAPSHOT_NAME);
+    lkmpg_genl_notify(&sysfs_attrs_genl, NULL);
+
+}
+
+void sysfs_attrs_vector_notify(struct sysfs_attrs_attr_vector* self, size_t offset, size_t length) {
+
+    // offset and length count elements
+
+    if (!SYSFS_ATTRS_TUNABLE(notify)) {
+        return;
+    }
+
+    sysfs_notify(sysfs_attrs_kobj, NULL, self->kattr.attr.name);
+    sysfs_notify(sysfs_attrs_kobj, NULL, self->battr.attr.name);
+    lkmpg_genl_notify(&sysfs_attrs_genl, &(struct lkmpg_genl_change) {.array = self, .offset = offset, .length = length});
+
+}
+
+void sysfs_attrs_snapshot_fill(struct sysfs_attrs_snapshot* snapshot) {
+
+    unsigned sequence = 0;
+    const struct sysfs_attrs_string_value* string_value = NULL;
+
+    rcu_read_lock();
+
+    // retry until no store was published while the values were being read
+
+    do {
+        sequence = read_seqbegin(&sysfs_attrs_seqlock);
+        snapshot->attr_bool = atomic_read(&sysfs_attrs_attr_bool.value);
+        snapshot->attr_int = atomic_read(&sysfs_attrs_attr_int.value);
+        snapshot->attr_bool_generation = READ_ONCE(sysfs_attrs_attr_bool.generation);
+        snapshot->attr_int_generation = READ_ONCE(sysfs_attrs_attr_int.generation);
+        snapshot->attr_string_generation = READ_ONCE(sysfs_attrs_attr_string.generation);
+        string_value = rcu_dereference(sysfs_attrs_attr_string.value);
+    } while (read_seqretry(&sysfs_attrs_seqlock, sequence));
+
+    // string values are immutable once published so the copy can happen
+    // outside of the retry loop
+
+    snapshot->magic = SYSFS_ATTRS_SNAPSHOT_MAGIC;
+    snapshot->version = SYSFS_ATTRS_SNAPSHOT_VERSION;
+    snapshot->size = sizeof(*snapshot);
+    snapshot->sequence = sequence;
+    memset(snapshot->reserved, 0, sizeof(snapshot->reserved));
+    snapshot->attr_string_length = string_value->length;
+    memcpy(snapshot->attr_string, string_value->data, string_value->length);
+    memset(snapshot->attr_string + string_value->length, 0, sizeof(snapshot->attr_string) - string_value->length);
+
+    rcu_read_unlock();
+
+}
+
+ssize_t sysfs_attrs_snapshot_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count) {
+
+    ssize_t bytes = 0;
+    loff_t position = offset;
+    struct lkmpg_latency_timer timer;
+    struct sysfs_attrs_snapshot* snapshot = NULL;
+
+    lkmpg_latency_start(&timer);
+
+    // fill the sysfs buffer directly when the whole snapshot is requested
+
+    if (offset == 0 && count >= sizeof(*snapshot)) {
+        sysfs_attrs_snapshot_fill((struct sysfs_attrs_snapshot*) buffer);
+        bytes = sizeof(*snapshot);
+        goto SYSFS_ATTRS_SNAPSHOT_READ_EXIT;
+    }
+
+    snapshot = kmalloc(sizeof(*snapshot), GFP_KERNEL);
+
+    if (!snapshot) {
+        bytes = -ENOMEM;
+        goto SYSFS_ATTRS_SNAPSHOT_READ_EXIT;
+    }
+
+    sysfs_attrs_snapshot_fill(snapshot);
+    bytes = memory_read_from_buffer(buffer, count, &position, snapshot, sizeof(*snapshot));
+    kfree(snapshot);
+
+SYSFS_ATTRS_SNAPSHOT_READ_EXIT:
+
+    trace_sysfs_attrs_read(battr->attr.name, count, offset, bytes);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_READ], &timer);
+    return bytes;
+
+}
+
+void sysfs_attrs_page_update(void) {
+
+    // called with the seqlock held for writing (or before the page is visible)
+    // so that updates to the page are serialized
+
+    struct sysfs_attrs_page* page = sysfs_attrs_page;
+    const struct sysfs_attrs_string_value* string_value = rcu_dereference_protected(sysfs_attrs_attr_string.value, 1);
+    size_t previous_length = page->attr_string_length;
+
+    WRITE_ONCE(page->sequence, page->sequence + 1);
+    smp_wmb();
+
+    WRITE_ONCE(page->attr_bool, atomic_read(&sysfs_attrs_attr_bool.value));
+    WRITE_ONCE(page->attr_int, atomic_read(&sysfs_attrs_attr_int.value));
+    WRITE_ONCE(page->attr_string_length, string_value->length);
+    memcpy(page->attr_string, string_value->data, string_value->length + 1);
+
+    if (previous_length > string_value->length) {
+        memset(page->attr_string + string_value->length + 1, 0, previous_length - string_value->length);
+    }
+
+    WRITE_ONCE(page->attr_bool_generation, sysfs_attrs_attr_bool.generation);
+    WRITE_ONCE(page->attr_int_generation, sysfs_attrs_attr_int.generation);
+    WRITE_ONCE(page->attr_string_generation, sysfs_attrs_attr_string.generation);
+
+    smp_wmb();
+    WRITE_ONCE(page->sequence, page->sequence + 1);
+
+}
+
+int sysfs_attrs_page_mmap(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_MMAP_CONST struct bin_attribute* battr, struct vm_area_struct* vma) {
+
+    int retval = 0;
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE) {
+        retval = -EINVAL;
+        goto SYSFS_ATTRS_PAGE_MMAP_EXIT;
+    }
+
+    // the page is only ever written by the kernel
+
+    if (vma->vm_flags & VM_WRITE) {
+        retval = -EPERM;
+        goto SYSFS_ATTRS_PAGE_MMAP_EXIT;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+    retval = vm_insert_page(vma, vma->vm_start, virt_to_page(sysfs_attrs_page));
+
+SYSFS_ATTRS_PAGE_MMAP_EXIT:
+
+    trace_sysfs_attrs_mmap(battr->attr.name, vma->vm_end - vma->vm_start, (loff_t) vma->vm_pgoff << PAGE_SHIFT, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_MMAP], &timer);
+    return retval;
+
+}
+
+int sysfs_attrs_attr_vector_alloc(struct sysfs_attrs_attr_vector* self, size_t length) {
+
+    self->values = kvcalloc(length, self->element_size, GFP_KERNEL);
+
+    if (!self->values) {
+        return -ENOMEM;
+    }
+
+    self->length = length;
+    self->battr.size = length * self->element_size;
+
+    return 0;
+
+}
+
+int sysfs_attrs_vector_parse(enum sysfs_attrs_vector_type type, char* input, void* values, size_t length, size_t* parsed) {
+
+    // parse delimited tokens into values in a single pass over input
+
+    switch (type) {
+    case SYSFS_ATTRS_VECTOR_U32:
+        return lkmpg_parse_u32_vector(input, SYSFS_ATTRS_ATTR_VECTOR_DELIMITERS, values, length, parsed);
+    case SYSFS_ATTRS_VECTOR_S64:
+        return lkmpg_parse_s64_vector(input, SYSFS_ATTRS_ATTR_VECTOR_DELIMITERS, values, length, parsed);
+    default:
+        return -EINVAL;
+    }
+
+}
+
+size_t sysfs_attrs_vector_format(enum sysfs_attrs_vector_type type, char* buffer, size_t size, const void* values, size_t length) {
+
+    int bytes = 0;
+    size_t offset = 0;
+
+    // format space-separated values in a single pass, stopping at the last
+    // value that fits in the buffer together with the trailing newline
+
+    for (size_t i = 0; i < length; ++i) {
+
+        switch (type) {
+        case SYSFS_ATTRS_VECTOR_U32:
+            bytes = snprintf(buffer + offset, size - offset, i ? " %u" : "%u", ((const u32*) values)[i]);
+            break;
+        case SYSFS_ATTRS_VECTOR_S64:
+            bytes = snprintf(buffer + offset, size - offset, i ? " %lld" : "%lld", ((const s64*) values)[i]);
+            break;
+        default:
+            bytes = 0;
+            break;
+        }
+
+        if (offset + bytes + 1 >= size) {
+            break;
+        }
+
+        offset += bytes;
+
+    }
+
+    buffer[offset++] = '\n';
+    buffer[offset] = '\0';
+
+    return offset;
+
+}
+
+ssize_t sysfs_attrs_attr_vector_show(struct kobject* kobj, struct kobj_attribute* kattr, char* buffer) {
+
+    struct lkmpg_latency_timer timer;
+    unsigned sequence = 0;
+    size_t bytes = 0;
+    struct sysfs_attrs_attr_vector* self = container_of(kattr, struct sysfs_attrs_attr_vector, kattr);
+
+    lkmpg_latency_start(&timer);
+
+    // format directly from the live values and start over if a store raced
+
+    do {
+        sequence = read_seqbegin(&self->seqlock);
+        bytes = sysfs_attrs_vector_format(self->type, buffer, PAGE_SIZE, self->values, self->length);
+    } while (read_seqretry(&self->seqlock, sequence));
+
+    return sysfs_attrs_show_done(kattr, &timer, bytes);
+
+}
+
+ssize_t sysfs_attrs_attr_vector_store(struct kobject* kobj, struct kobj_attribute* kattr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t retval = 0;
+    size_t parsed = 0;
+    char* input = NULL;
+    void* values = NULL;
+    struct sysfs_attrs_attr_vector* self = container_of(kattr, struct sysfs_attrs_attr_vector, kattr);
+
+    lkmpg_latency_start(&timer);
+
+    input = kstrndup(buffer, bytes, GFP_KERNEL);
+    values = kvmalloc_array(self->length, self->element_size, GFP_KERNEL);
+
+    if (!input || !values) {
+        pr_err("[%s:%s] failed to allocate parser buffers (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes);
+        retval = -ENOMEM;
+        goto SYSFS_ATTRS_ATTR_VECTOR_STORE_EXIT;
+    }
+
+    // parse outside of the seqlock so that readers only retry for the copy
+
+    if ((retval = sysfs_attrs_vector_parse(self->type, input, values, self->length, &parsed))) {
+        pr_err("[%s:%s] failed to parse input as vector (bytes = %zu, error = %zd)\n", SYSFS_ATTRS_MODULE_NAME, __func__, bytes, retval);
+        goto SYSFS_ATTRS_ATTR_VECTOR_STORE_EXIT;
+    }
+
+    write_seqlock(&self->seqlock);
+    lkmpg_latency_locked(&timer);
+    memcpy(self->values, values, parsed * self->element_size);
+    write_sequnlock(&self->seqlock);
+
+    sysfs_attrs_vector_notify(self, 0, parsed);
+
+    retval = bytes;
+
+SYSFS_ATTRS_ATTR_VECTOR_STORE_EXIT:
+
+    kvfree(values);
+    kfree(input);
+    return sysfs_attrs_store_done(kattr, &timer, bytes, retval);
+
+}
+
+ssize_t sysfs_attrs_attr_vector_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count) {
+
+    unsigned sequence = 0;
+    struct lkmpg_latency_timer timer;
+    struct sysfs_attrs_attr_vector* self = battr->private;
+
+    lkmpg_latency_start(&timer);
+
+    // sysfs limits offset + count to the size of the binary attribute
+
+    do {
+        sequence = read_seqbegin(&self->seqlock);
+        memcpy(buffer, (const char*) self->values + offset, count);
+    } while (read_seqretry(&self->seqlock, sequence));
+
+    trace_sysfs_attrs_read(battr->attr.name, count, offset, count);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_READ], &timer);
+
+    return count;
+
+}
+
+ssize_t sysfs_attrs_attr_vector_write(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count) {
+
+    struct lkmpg_latency_timer timer;
+    struct sysfs_attrs_attr_vector* self = battr->private;
+
+    lkmpg_latency_start(&timer);
+    write_seqlock(&self->seqlock);
+    lkmpg_latency_locked(&timer);
+    memcpy((char*) self->values + offset, buffer, count);
+    write_sequnlock(&self->seqlock);
+
+    // writes need not be aligned to elements, so every element they touch
+    // is reported
+
+    sysfs_attrs_vector_notify(self, offset / self->element_size, DIV_ROUND_UP(offset + count, self->element_size) - offset / self->element_size);
+
+    trace_sysfs_attrs_write(battr->attr.name, count, offset, count);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_WRITE], &timer);
+
+    return count;
+
+}
+
+size_t sysfs_attrs_state_size(size_t vector_length) {
+    return sizeof(struct lkmpg_state_header) + sizeof(struct sysfs_attrs_state_payload) + vector_length * (sizeof(u32) + sizeof(s64));
+}
+
+void sysfs_attrs_state_dump(struct lkmpg_state_header* header) {
+
+    unsigned sequence = 0;
+    struct sysfs_attrs_state_payload* payload = (struct sysfs_attrs_state_payload*) (header + 1);
+    const size_t length = sysfs_attrs_attr_u32_vector.length;
+    u8* u32_values = payload->vectors;
+    u8* s64_values = payload->vectors + length * sizeof(u32);
+    const struct sysfs_attrs_string_value* string_value = NULL;
+
+    // clear the reserved bytes and the string padding so that equal states
+    // produce equal dumps
+
+    memset(payload, 0, sizeof(*payload));
+    rcu_read_lock();
+
+    do {
+        sequence = read_seqbegin(&sysfs_attrs_seqlock);
+        payload->attr_bool = atomic_read(&sysfs_attrs_attr_bool.value);
+        payload->attr_int = atomic_read(&sysfs_attrs_attr_int.value);
+        string_value = rcu_dereference(sysfs_attrs_attr_string.value);
+    } while (read_seqretry(&sysfs_attrs_seqlock, sequence));
+
+    payload->attr_string_length = string_value->length;
+    memcpy(payload->attr_string, string_value->data, string_value->length);
+
+    rcu_read_unlock();
+
+    payload->tunable_count = SYSFS_ATTRS_TUNABLE_COUNT;
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        payload->tunables[i] = sysfs_attrs_tunable_get(&sysfs_attrs_tunable_table[i]);
+    }
+
+    payload->vector_length = length;
+
+    do {
+        sequence = read_seqbegin(&sysfs_attrs_attr_u32_vector.seqlock);
+        memcpy(u32_values, sysfs_attrs_attr_u32_vector.values, length * sizeof(u32));
+    } while (read_seqretry(&sysfs_attrs_attr_u32_vector.seqlock, sequence));
+
+    do {
+        sequence = read_seqbegin(&sysfs_attrs_attr_s64_vector.seqlock);
+        memcpy(s64_values, sysfs_attrs_attr_s64_vector.values, length * sizeof(s64));
+    } while (read_seqretry(&sysfs_attrs_attr_s64_vector.seqlock, sequence));
+
+    lkmpg_state_seal(header, SYSFS_ATTRS_STATE_MAGIC, SYSFS_ATTRS_STATE_VERSION, sysfs_attrs_state_size(length) - sizeof(*header));
+
+}
+
+int sysfs_attrs_state_restore(const struct sysfs_attrs_state_payload* payload, size_t length) {
+
+    ssize_t copied = 0;
+    unsigned long changed = 0;
+    size_t vector_length = 0;
+    const u8* u32_values = NULL;
+    const u8* s64_values = NULL;
+    struct sysfs_attrs_string_value* string_value = NULL;
+
+    // the checksum only proves that the dump is intact, so the fields are
+    // still validated before anything is applied
+
+    if (length < sizeof(*payload) || length != sysfs_attrs_state_size(payload->vector_length) - sizeof(struct lkmpg_state_header)) {
+        return -EBADMSG;
+    }
+
+    if (payload->vector_length > sysfs_attrs_attr_u32_vector.length) {
+        return -ENOSPC;
+    }
+
+    if (payload->attr_string_length >= SYSFS_ATTRS_ATTR_STRING_SIZE || payload->attr_string[payload->attr_string_length]) {
+        return -EINVAL;
+    }
+
+    if (payload->tunable_count != SYSFS_ATTRS_TUNABLE_COUNT) {
+        return -EINVAL;
+    }
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        if (payload->tunables[i] < sysfs_attrs_tunable_table[i].min || payload->tunables[i] > sysfs_attrs_tunable_table[i].max) {
+            return -ERANGE;
+        }
+    }
+
+    string_value = sysfs_attrs_string_value_alloc(payload->attr_string, payload->attr_string_length + 1, &copied);
+
+    if (!string_value) {
+        return -ENOMEM;
+    }
+
+    vector_length = payload->vector_length;
+    u32_values = payload->vectors;
+    s64_values = payload->vectors + vector_length * sizeof(u32);
+
+    // tunables go first, so that the notifications below follow the restored
+    // notify tunable; they take no lock, so they are notified right away
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        if (sysfs_attrs_tunable_get(&sysfs_attrs_tunable_table[i]) != payload->tunables[i]) {
+            sysfs_attrs_tunable_set(&sysfs_attrs_tunable_table[i], payload->tunables[i]);
+            sysfs_attrs_tunable_notify(i);
+        }
+    }
+
+    write_seqlock(&sysfs_attrs_seqlock);
+
+    if (sysfs_attrs_attr_bool_apply(&sysfs_attrs_attr_bool, payload->attr_bool)) {
+        __set_bit(SYSFS_ATTRS_STAGED_BOOL, &changed);
+    }
+
+    if (sysfs_attrs_attr_int_apply(&sysfs_attrs_attr_int, payload->attr_int)) {
+        __set_bit(SYSFS_ATTRS_STAGED_INT, &changed);
+    }
+
+    if (sysfs_attrs_attr_string_apply(&sysfs_attrs_attr_string, &string_value)) {
+        __set_bit(SYSFS_ATTRS_STAGED_STRING, &changed);
+    }
+
+    if (changed) {
+        sysfs_attrs_page_update();
+    }
+
+    write_sequnlock(&sysfs_attrs_seqlock);
+
+    write_seqlock(&sysfs_attrs_attr_u32_vector.seqlock);
+    memcpy(sysfs_attrs_attr_u32_vector.values, u32_values, vector_length * sizeof(u32));
+    write_sequnlock(&sysfs_attrs_attr_u32_vector.seqlock);
+
+    write_seqlock(&sysfs_attrs_attr_s64_vector.seqlock);
+    memcpy(sysfs_attrs_attr_s64_vector.values, s64_values, vector_length * sizeof(s64));
+    write_sequnlock(&sysfs_attrs_attr_s64_vector.seqlock);
+
+    if (test_bit(SYSFS_ATTRS_STAGED_BOOL, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_bool.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_INT, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_int.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_STRING, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_string.kattr);
+        kfree_rcu(string_value, rcu);
+    } else {
+        kfree(string_value);
+    }
+
+    if (vector_length) {
+        sysfs_attrs_vector_notify(&sysfs_attrs_attr_u32_vector, 0, vector_length);
+        sysfs_attrs_vector_notify(&sysfs_attrs_attr_s64_vector, 0, vector_length);
+    }
+
+    return 0;
+
+}
+
+ssize_t sysfs_attrs_state_read(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count) {
+
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    mutex_lock(&sysfs_attrs_state.mutex);
+    lkmpg_latency_locked(&timer);
+
+    // sysfs limits offset + count to the size of the binary attribute, which
+    // is also the size of every dump
+
+    if (offset == 0) {
+        sysfs_attrs_state_dump(sysfs_attrs_state.dump);
+    }
+
+    memcpy(buffer, (const char*) sysfs_attrs_state.dump + offset, count);
+    mutex_unlock(&sysfs_attrs_state.mutex);
+
+    trace_sysfs_attrs_read(battr->attr.name, count, offset, count);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_READ], &timer);
+
+    return count;
+
+}
+
+ssize_t sysfs_attrs_state_write(struct file* file, struct kobject* kobj, SYSFS_ATTRS_BIN_ATTR_CONST struct bin_attribute* battr, char* buffer, loff_t offset, size_t count) {
+
+    ssize_t retval = count;
+    ssize_t length = 0;
+    size_t end = offset + count;
+    struct lkmpg_latency_timer timer;
+    const struct lkmpg_state_header* header = sysfs_attrs_state.restore;
+
+    lkmpg_latency_start(&timer);
+
+    mutex_lock(&sysfs_attrs_state.mutex);
+    lkmpg_latency_locked(&timer);
+
+    memcpy((char*) sysfs_attrs_state.restore + offset, buffer, count);
+
+    // the header gives the size of the dump, which may be smaller than the
+    // attribute when it was taken with a smaller vector_size
+
+    if (end < sizeof(*header) || end != sizeof(*header) + header->length) {
+        goto SYSFS_ATTRS_STATE_WRITE_EXIT;
+    }
+
+    if ((length = lkmpg_state_check(header, end, SYSFS_ATTRS_STATE_MAGIC, SYSFS_ATTRS_STATE_VERSION)) < 0) {
+        pr_err("[%s:%s] rejected state dump (size = %zu): %zd\n", SYSFS_ATTRS_MODULE_NAME, __func__, end, length);
+        retval = length;
+        goto SYSFS_ATTRS_STATE_WRITE_EXIT;
+    }
+
+    if ((length = sysfs_attrs_state_restore((const struct sysfs_attrs_state_payload*) (header + 1), length)) < 0) {
+        pr_err("[%s:%s] failed to restore state dump (size = %zu): %zd\n", SYSFS_ATTRS_MODULE_NAME, __func__, end, length);
+        retval = length;
+    }
+
+SYSFS_ATTRS_STATE_WRITE_EXIT:
+
+    mutex_unlock(&sysfs_attrs_state.mutex);
+
+    trace_sysfs_attrs_write(battr->attr.name, count, offset, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_WRITE], &timer);
+
+    return retval;
+
+}
+
+int sysfs_attrs_genl_fill(struct sk_buff* skb, const struct lkmpg_genl_change* change) {
+
+    int retval = 0;
+    bool attr_bool = false;
+    int attr_int = 0;
+    unsigned sequence = 0;
+    const struct sysfs_attrs_string_value* string_value = NULL;
+    const struct sysfs_attrs_attr_vector* self = NULL;
+
+    // an event about a vector carries its first changed elements
+
+    if (change) {
+        self = change->array;
+        return sysfs_attrs_genl_fill_vector(skb, self, change->offset, min_t(size_t, change->length, LKMPG_GENL_CHUNK_SIZE / self->element_size));
+    }
+
+    rcu_read_lock();
+
+    do {
+        sequence = read_seqbegin(&sysfs_attrs_seqlock);
+        attr_bool = atomic_read(&sysfs_attrs_attr_bool.value);
+        attr_int = atomic_read(&sysfs_attrs_attr_int.value);
+        string_value = rcu_dereference(sysfs_attrs_attr_string.value);
+    } while (read_seqretry(&sysfs_attrs_seqlock, sequence));
+
+    if (nla_put_u8(skb, LKMPG_GENL_ATTR_BOOL, attr_bool) || nla_put_s32(skb, LKMPG_GENL_ATTR_INT, attr_int) || nla_put_string(skb, LKMPG_GENL_ATTR_STRING, string_value->data) || nla_put_u32(skb, LKMPG_GENL_ATTR_SIZE, sysfs_attrs_attr_u32_vector.length)) {
+        retval = -EMSGSIZE;
+    }
+
+    rcu_read_unlock();
+
+    return retval ? retval : sysfs_attrs_genl_fill_tunables(skb);
+
+}
+
+int sysfs_attrs_genl_fill_tunables(struct sk_buff* skb) {
+
+    struct nlattr* nest = nla_nest_start(skb, LKMPG_GENL_ATTR_TUNABLES);
+
+    if (!nest) {
+        return -EMSGSIZE;
+    }
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        if (nla_put_s64(skb, i + 1, sysfs_attrs_tunable_get(&sysfs_attrs_tunable_table[i]), LKMPG_GENL_ATTR_UNSPEC)) {
+            nla_nest_cancel(skb, nest);
+            return -EMSGSIZE;
+        }
+    }
+
+    nla_nest_end(skb, nest);
+
+    return 0;
+
+}
+
+int sysfs_attrs_genl_fill_vector(struct sk_buff* skb, const struct sysfs_attrs_attr_vector* self, size_t offset, size_t length) {
+
+    unsigned sequence = 0;
+    struct nlattr* data = nla_reserve(skb, self->type == SYSFS_ATTRS_VECTOR_U32 ? LKMPG_GENL_ATTR_U32_VECTOR : LKMPG_GENL_ATTR_S64_VECTOR, length * self->element_size);
+
+    if (!data) {
+        return -EMSGSIZE;
+    }
+
+    do {
+        sequence = read_seqbegin(&self->seqlock);
+        memcpy(nla_data(data), (const char*) self->values + offset * self->element_size, length * self->element_size);
+    } while (read_seqretry(&self->seqlock, sequence));
+
+    return 0;
+
+}
+
+int sysfs_attrs_genl_dump(struct sk_buff* skb, struct netlink_callback* cb) {
+    return lkmpg_genl_dump_chunks(skb, cb, &sysfs_attrs_genl.family, sysfs_attrs_genl_dump_fill);
+}
+
+int sysfs_attrs_genl_dump_fill(struct sk_buff* skb, size_t offset) {
+
+    int retval = 0;
+    size_t length = 0;
+
+    // both vectors have the same length, and a chunk of the wider one is at
+    // most LKMPG_GENL_CHUNK_SIZE bytes
+
+    if (offset >= sysfs_attrs_attr_u32_vector.length) {
+        return 0;
+    }
+
+    length = min_t(size_t, LKMPG_GENL_CHUNK_SIZE / sizeof(s64), sysfs_attrs_attr_u32_vector.length - offset);
+
+    if ((retval = sysfs_attrs_genl_fill_vector(skb, &sysfs_attrs_attr_u32_vector, offset, length)) || (retval = sysfs_attrs_genl_fill_vector(skb, &sysfs_attrs_attr_s64_vector, offset, length))) {
+        return retval;
+    }
+
+    return length;
+
+}
+
+int sysfs_attrs_genl_check_vector(struct genl_info* info, const struct sysfs_attrs_attr_vector* self, int attr, size_t offset) {
+
+    const struct nlattr* data = info->attrs[attr];
+
+    if (!data) {
+        return 0;
+    }
+
+    if (nla_len(data) % self->element_size || offset > self->length || nla_len(data) / self->element_size > self->length - offset) {
+        NL_SET_ERR_MSG_ATTR(info->extack, data, "elements do not fit in the vector");
+        return -ENOSPC;
+    }
+
+    return 0;
+
+}
+
+int sysfs_attrs_genl_check_tunables(struct genl_info* info, s64* values, unsigned long* present) {
+
+    int remaining = 0;
+    const struct nlattr* attr = NULL;
+    const struct sysfs_attrs_tunable* tunable = NULL;
+
+    if (!info->attrs[LKMPG_GENL_ATTR_TUNABLES]) {
+        return 0;
+    }
+
+    nla_for_each_nested(attr, info->attrs[LKMPG_GENL_ATTR_TUNABLES], remaining) {
+
+        if (nla_type(attr) == LKMPG_GENL_ATTR_UNSPEC) {
+            continue;
+        }
+
+        if (nla_type(attr) > SYSFS_ATTRS_TUNABLE_COUNT || nla_len(attr) != sizeof(s64)) {
+            NL_SET_ERR_MSG_ATTR(info->extack, attr, "not an s64 tunable of this family");
+            return -EINVAL;
+        }
+
+        tunable = &sysfs_attrs_tunable_table[nla_type(attr) - 1];
+        values[nla_type(attr) - 1] = nla_get_s64(attr);
+
+        if (values[nla_type(attr) - 1] < tunable->min || values[nla_type(attr) - 1] > tunable->max) {
+            NL_SET_ERR_MSG_ATTR(info->extack, attr, "tunable out of range");
+            return -ERANGE;
+        }
+
+        __set_bit(nla_type(attr) - 1, present);
+
+    }
+
+    return 0;
+
+}
+
+int sysfs_attrs_genl_set(struct genl_info* info) {
+
+    int retval = 0;
+    size_t offset = 0;
+    ssize_t copied = 0;
+    unsigned long changed = 0;
+    struct nlattr** attrs = info->attrs;
+    struct sysfs_attrs_string_value* string_value = NULL;
+    struct sysfs_attrs_attr_vector* vectors[] = {&sysfs_attrs_attr_u32_vector, &sysfs_attrs_attr_s64_vector};
+    s64 tunables[SYSFS_ATTRS_TUNABLE_COUNT] = {};
+    DECLARE_BITMAP(tunables_present, SYSFS_ATTRS_TUNABLE_COUNT) = {};
+
+    if (attrs[LKMPG_GENL_ATTR_OFFSET]) {
+        offset = nla_get_u32(attrs[LKMPG_GENL_ATTR_OFFSET]);
+    }
+
+    if ((retval = sysfs_attrs_genl_check_vector(info, &sysfs_attrs_attr_u32_vector, LKMPG_GENL_ATTR_U32_VECTOR, offset)) || (retval = sysfs_attrs_genl_check_vector(info, &sysfs_attrs_attr_s64_vector, LKMPG_GENL_ATTR_S64_VECTOR, offset))) {
+        return retval;
+    }
+
+    if ((retval = sysfs_attrs_genl_check_tunables(info, tunables, tunables_present))) {
+        return retval;
+    }
+
+    // the policy guarantees the string is null-terminated within the
+    // attribute, which includes the terminator
+
+    if (attrs[LKMPG_GENL_ATTR_STRING]) {
+
+        if (nla_len(attrs[LKMPG_GENL_ATTR_STRING]) > SYSFS_ATTRS_ATTR_STRING_SIZE) {
+            NL_SET_ERR_MSG_ATTR(info->extack, attrs[LKMPG_GENL_ATTR_STRING], "string too long");
+            return -EINVAL;
+        }
+
+        if (!(string_value = sysfs_attrs_string_value_alloc(nla_data(attrs[LKMPG_GENL_ATTR_STRING]), nla_len(attrs[LKMPG_GENL_ATTR_STRING]), &copied))) {
+            return -ENOMEM;
+        }
+
+    }
+
+    // tunables go first, as in a state restore, so that the notifications
+    // below follow the new notify tunable
+
+    for (size_t i = 0; i < SYSFS_ATTRS_TUNABLE_COUNT; ++i) {
+        if (test_bit(i, tunables_present) && sysfs_attrs_tunable_get(&sysfs_attrs_tunable_table[i]) != tunables[i]) {
+            sysfs_attrs_tunable_set(&sysfs_attrs_tunable_table[i], tunables[i]);
+            sysfs_attrs_tunable_notify(i);
+        }
+    }
+
+    if (attrs[LKMPG_GENL_ATTR_BOOL] || attrs[LKMPG_GENL_ATTR_INT] || string_value) {
+
+        write_seqlock(&sysfs_attrs_seqlock);
+
+        if (attrs[LKMPG_GENL_ATTR_BOOL] && sysfs_attrs_attr_bool_apply(&sysfs_attrs_attr_bool, nla_get_u8(attrs[LKMPG_GENL_ATTR_BOOL]))) {
+            __set_bit(SYSFS_ATTRS_STAGED_BOOL, &changed);
+        }
+
+        if (attrs[LKMPG_GENL_ATTR_INT] && sysfs_attrs_attr_int_apply(&sysfs_attrs_attr_int, nla_get_s32(attrs[LKMPG_GENL_ATTR_INT]))) {
+            __set_bit(SYSFS_ATTRS_STAGED_INT, &changed);
+        }
+
+        if (string_value && sysfs_attrs_attr_string_apply(&sysfs_attrs_attr_string, &string_value)) {
+            __set_bit(SYSFS_ATTRS_STAGED_STRING, &changed);
+        }
+
+        if (changed) {
+            sysfs_attrs_page_update();
+        }
+
+        write_sequnlock(&sysfs_attrs_seqlock);
+
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_BOOL, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_bool.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_INT, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_int.kattr);
+    }
+
+    if (test_bit(SYSFS_ATTRS_STAGED_STRING, &changed)) {
+        sysfs_attrs_notify(&sysfs_attrs_attr_string.kattr);
+        kfree_rcu(string_value, rcu);
+    } else {
+        kfree(string_value);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(vectors); ++i) {
+
+        struct sysfs_attrs_attr_vector* self = vectors[i];
+        const struct nlattr* data = attrs[self->type == SYSFS_ATTRS_VECTOR_U32 ? LKMPG_GENL_ATTR_U32_VECTOR : LKMPG_GENL_ATTR_S64_VECTOR];
+
+        if (!data || !nla_len(data)) {
+            continue;
+        }
+
+        write_seqlock(&self->seqlock);
+        memcpy((char*) self->values + offset * self->element_size, nla_data(data), nla_len(data));
+        write_sequnlock(&self->seqlock);
+
+        sysfs_attrs_vector_notify(self, offset, nla_len(data) / self->element_size);
+
+    }
+
+    return 0;
+
+}
+
+s64 sysfs_attrs_tunable_get(const struct sysfs_attrs_tunable* tunable) {
+
+    const void* slot = (const u8*) &sysfs_attrs_tunables + tunable->offset;
+
+    switch (tunable->type) {
+    case SYSFS_ATTRS_TUNABLE_TYPE_bool:
+        return READ_ONCE(*(const bool*) slot);
+    case SYSFS_ATTRS_TUNABLE_TYPE_u8:
+        return READ_ONCE(*(const u8*) slot);
+    case SYSFS_ATTRS_TUNABLE_TYPE_u16:
+        return READ_ONCE(*(const u16*) slot);
+    case SYSFS_ATTRS_TUNABLE_TYPE_u32:
+        return READ_ONCE(*(const u32*) slot);
+    case SYSFS_ATTRS_TUNABLE_TYPE_s32:
+        return READ_ONCE(*(const s32*) slot);
+    }
+
+    return 0;
+
+}
+
+void sysfs_attrs_tunable_set(const struct sysfs_attrs_tunable* tunable, s64 value) {
+
+    // value has been checked against the range of the tunable, which fits
+    // its type
+
+    void* slot = (u8*) &sysfs_attrs_tunables + tunable->offset;
+
+    switch (tunable->type) {
+    case SYSFS_ATTRS_TUNABLE_TYPE_bool:
+        WRITE_ONCE(*(bool*) slot, value);
+        break;
+    case SYSFS_ATTRS_TUNABLE_TYPE_u8:
+        WRITE_ONCE(*(u8*) slot, value);
+        break;
+    case SYSFS_ATTRS_TUNABLE_TYPE_u16:
+        WRITE_ONCE(*(u16*) slot, value);
+        break;
+    case SYSFS_ATTRS_TUNABLE_TYPE_u32:
+        WRITE_ONCE(*(u32*) slot, value);
+        break;
+    case SYSFS_ATTRS_TUNABLE_TYPE_s32:
+        WRITE_ONCE(*(s32*) slot, value);
+        break;
+    }
+
+}
+
+ssize_t sysfs_attrs_tunables_show(struct kobject* kobj, struct attribute* attr, char* buffer) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t retval = 0;
+
+    lkmpg_latency_start(&timer);
+    retval = sysfs_emit(buffer, "%lld\n", sysfs_attrs_tunable_get(&sysfs_attrs_tunable_table[attr - sysfs_attrs_tunable_attrs]));
+    trace_sysfs_attrs_show(attr->name, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_SHOW], &timer);
+
+    return retval;
+
+}
+
+ssize_t sysfs_attrs_tunables_store(struct kobject* kobj, struct attribute* attr, const char* buffer, size_t bytes) {
+
+    struct lkmpg_latency_timer timer;
+    ssize_t retval = bytes;
+    s64 value = 0;
+    bool flag = false;
+    const struct sysfs_attrs_tunable* tunable = &sysfs_attrs_tunable_table[attr - sysfs_attrs_tunable_attrs];
+
+    lkmpg_latency_start(&timer);
+
+    // booleans take the same spellings as attr-bool
+
+    if (tunable->type == SYSFS_ATTRS_TUNABLE_TYPE_bool) {
+        retval = kstrtobool(buffer, &flag);
+        value = flag;
+    } else {
+        retval = kstrtoll(buffer, 0, &value);
+    }
+
+    if (retval) {
+        pr_err("[%s:%s] failed to parse input for tunable \"%s\" (bytes = %zu)\n", SYSFS_ATTRS_MODULE_NAME, __func__, attr->name, bytes);
+        goto SYSFS_ATTRS_TUNABLES_STORE_EXIT;
+    }
+
+    if (value < tunable->min || value > tunable->max) {
+        retval = -ERANGE;
+        goto SYSFS_ATTRS_TUNABLES_STORE_EXIT;
+    }
+
+    retval = bytes;
+
+    if (sysfs_attrs_tunable_get(tunable) != value) {
+        sysfs_attrs_tunable_set(tunable, value);
+        sysfs_attrs_tunable_notify(tunable - sysfs_attrs_tunable_table);
+    }
+
+SYSFS_ATTRS_TUNABLES_STORE_EXIT:
+
+    trace_sysfs_attrs_store(attr->name, bytes, retval);
+    lkmpg_latency_stop(&sysfs_attrs_latency[SYSFS_ATTRS_LATENCY_STORE], &timer);
+
+    return retval;
+
+}
+
+void sysfs_attrs_tunable_notify(size_t index) {
+
+    // not gated by the notify tunable, so that turning it off is seen too
+
+    sysfs_notify(sysfs_attrs_tunables_kobj, NULL, sysfs_attrs_tunable_attrs[index].name);
+    lkmpg_genl_notify(&sysfs_attrs_genl, NULL);
+
+}
 
+void sysfs_attrs_tunables_release(struct kobject* kobj) {
+    kfree(kobj);
 }
 
 module_init(sysfs_attrs_init);
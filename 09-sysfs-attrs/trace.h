@@ -0,0 +1,111 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sysfs_attrs
+
+// tracepoints for the attributes under /sys/kernel/sysfs-attrs, enabled at
+// runtime with
+//
+// echo 1 > /sys/kernel/tracing/events/sysfs_attrs/enable
+// perf trace -e 'sysfs_attrs:*'
+//
+// open, seek and release are handled by sysfs itself, so the events cover
+// show and store of the text attributes and read, write and mmap of the
+// binary attributes; names are copied into a fixed array rather than with
+// __string() because __assign_str() changed its arguments in 6.10
+
+#if !defined(_SYSFS_ATTRS_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SYSFS_ATTRS_TRACE_H
+
+#include <linux/string.h>
+#include <linux/tracepoint.h>
+
+#define SYSFS_ATTRS_TRACE_NAME_SIZE 32
+
+TRACE_EVENT(sysfs_attrs_show,
+
+    TP_PROTO(const char* name, ssize_t retval),
+
+    TP_ARGS(name, retval),
+
+    TP_STRUCT__entry(
+        __array(char, name, SYSFS_ATTRS_TRACE_NAME_SIZE)
+        __field(ssize_t, retval)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SYSFS_ATTRS_TRACE_NAME_SIZE);
+        __entry->retval = retval;
+    ),
+
+    TP_printk("name=%s retval=%zd", __entry->name, __entry->retval)
+
+);
+
+TRACE_EVENT(sysfs_attrs_store,
+
+    TP_PROTO(const char* name, size_t length, ssize_t retval),
+
+    TP_ARGS(name, length, retval),
+
+    TP_STRUCT__entry(
+        __array(char, name, SYSFS_ATTRS_TRACE_NAME_SIZE)
+        __field(size_t, length)
+        __field(ssize_t, retval)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SYSFS_ATTRS_TRACE_NAME_SIZE);
+        __entry->length = length;
+        __entry->retval = retval;
+    ),
+
+    TP_printk("name=%s length=%zu retval=%zd", __entry->name, __entry->length, __entry->retval)
+
+);
+
+DECLARE_EVENT_CLASS(sysfs_attrs_bin,
+
+    TP_PROTO(const char* name, size_t length, loff_t offset, ssize_t retval),
+
+    TP_ARGS(name, length, offset, retval),
+
+    TP_STRUCT__entry(
+        __array(char, name, SYSFS_ATTRS_TRACE_NAME_SIZE)
+        __field(size_t, length)
+        __field(loff_t, offset)
+        __field(ssize_t, retval)
+    ),
+
+    TP_fast_assign(
+        strscpy(__entry->name, name, SYSFS_ATTRS_TRACE_NAME_SIZE);
+        __entry->length = length;
+        __entry->offset = offset;
+        __entry->retval = retval;
+    ),
+
+    TP_printk("name=%s length=%zu offset=%lld retval=%zd", __entry->name, __entry->length, __entry->offset, __entry->retval)
+
+);
+
+DEFINE_EVENT(sysfs_attrs_bin, sysfs_attrs_read,
+    TP_PROTO(const char* name, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(name, length, offset, retval)
+);
+
+DEFINE_EVENT(sysfs_attrs_bin, sysfs_attrs_write,
+    TP_PROTO(const char* name, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(name, length, offset, retval)
+);
+
+DEFINE_EVENT(sysfs_attrs_bin, sysfs_attrs_mmap,
+    TP_PROTO(const char* name, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(name, length, offset, retval)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+#include <trace/define_trace.h>
@@ -0,0 +1,24 @@
+#ifndef SYSFS_ATTRS_TUNABLES_H
+#define SYSFS_ATTRS_TUNABLES_H
+
+// tunables under /sys/kernel/sysfs-attrs/tunables/, one line each:
+//
+//     X(name, type, min, max, init)
+//
+// type is one of bool, u8, u16, u32 or s32, and a store outside of
+// [min, max] fails with -ERANGE; sysfs-attrs.c generates the storage, the
+// attributes and their descriptors from this list, so adding a tunable is
+// adding a line here, and the module reads one with SYSFS_ATTRS_TUNABLE(name)
+//
+// tunables are part of the state dump and of the netlink family, and a
+// change to this list changes the layout of the dump, so it also bumps
+// SYSFS_ATTRS_STATE_VERSION
+//
+// notify: whether a change to an attribute or a vector wakes its pollers and
+// sends a netlink event; with 0, stores skip both and readers have to poll by
+// reading (changes to the tunables themselves are always notified)
+
+#define SYSFS_ATTRS_TUNABLES(X) \
+    X(notify, bool, 0, 1, true)
+
+#endif
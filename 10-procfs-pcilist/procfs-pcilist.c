@@ -1,11 +1,26 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/init.h>
+#include <linux/moduleparam.h>
 #include <linux/fs.h>
 #include <linux/proc_fs.h>
-#include <linux/seq_file.h>
 #include <linux/pci.h>
 #include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/device.h>
+#include <linux/kref.h>
+#include <linux/overflow.h>
+#include <linux/slab.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
+#include <linux/limits.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#include "lkmpg-latency.h"
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
@@ -14,8 +29,14 @@ MODULE_VERSION("0.1");
 
 #define PROCFS_PCILIST_MODULE_NAME "procfs-pcilist"
 #define PROCFS_PCILIST_FILE_NAME "procfs-pcilist"
-#define PROCFS_PCILIST_FILE_MODE 0444
+#define PROCFS_PCILIST_FILE_MODE 0666
 #define PROCFS_PCILIST_FILE_PARENT NULL
+#define PROCFS_PCILIST_CONFIG_FILE_NAME "procfs-pcilist-config"
+#define PROCFS_PCILIST_CONFIG_FILE_MODE 0400
+
+static unsigned int procfs_pcilist_param_config_workers = 0;
+module_param_named(config_workers, procfs_pcilist_param_config_workers, uint, 0644);
+MODULE_PARM_DESC(config_workers, "number of work items config space reads are spread over, 0 reads inline");
 
 static int __init procfs_pcilist_init(void);
 static void __exit procfs_pcilist_exit(void);
@@ -24,127 +45,752 @@ static void __exit procfs_pcilist_exit(void);
 
 static int procfs_pcilist_proc_open(struct inode*, struct file*);
 static ssize_t procfs_pcilist_proc_read(struct file*, char __user*, size_t, loff_t*);
+static ssize_t procfs_pcilist_proc_write(struct file*, const char __user*, size_t, loff_t*);
 static loff_t procfs_pcilist_proc_lseek(struct file*, loff_t, int);
 static int procfs_pcilist_proc_release(struct inode*, struct file*);
 
 static const struct proc_ops procfs_pcilist_proc_ops = {
     .proc_open = procfs_pcilist_proc_open,
     .proc_read = procfs_pcilist_proc_read,
+    .proc_write = procfs_pcilist_proc_write,
     .proc_lseek = procfs_pcilist_proc_lseek,
     .proc_release = procfs_pcilist_proc_release
 };
 
-// sequence file operations
+// binary companion file; every open reads the config space of every device
+// once and the result is returned as a header followed by one fixed-size
+// record per device, in bus order
+//
+// reading config space beyond the first 64 bytes needs the same privilege as
+// the config files in sysfs, so the file is readable by root only
+
+static int procfs_pcilist_config_proc_open(struct inode*, struct file*);
+static ssize_t procfs_pcilist_config_proc_read(struct file*, char __user*, size_t, loff_t*);
+static loff_t procfs_pcilist_config_proc_lseek(struct file*, loff_t, int);
+static int procfs_pcilist_config_proc_release(struct inode*, struct file*);
+
+static const struct proc_ops procfs_pcilist_config_proc_ops = {
+    .proc_open = procfs_pcilist_config_proc_open,
+    .proc_read = procfs_pcilist_config_proc_read,
+    .proc_lseek = procfs_pcilist_config_proc_lseek,
+    .proc_release = procfs_pcilist_config_proc_release
+};
+
+// a reader narrows its own open file to matching devices by writing a filter
+// made of whitespace-separated terms, after which reads start over from the
+// beginning; writing an empty filter shows every device again
+//
+// - vendor=<id> and device=<id> match ids through pci_get_device()
+// - class=<id> matches the 24-bit class code through pci_get_class()
+// - bus=<first>[-<last>] matches an inclusive range of bus numbers
+// - driver=<name> matches the name of the bound driver
+//
+// exec 3<>/proc/procfs-pcilist; echo "vendor=0x8086 bus=0-3" >&3; cat <&3
+
+#define PROCFS_PCILIST_FILTER_SIZE 256
+#define PROCFS_PCILIST_FILTER_DELIMITERS " \t\n"
+
+struct procfs_pcilist_filter {
+    unsigned int vendor;
+    unsigned int device;
+    unsigned int class;
+    unsigned int bus_first;
+    unsigned int bus_last;
+    char driver[32];
+};
+
+static const struct procfs_pcilist_filter procfs_pcilist_filter_any = {
+    .vendor = PCI_ANY_ID,
+    .device = PCI_ANY_ID,
+    .class = PCI_ANY_ID,
+    .bus_first = 0,
+    .bus_last = U8_MAX,
+    .driver = "",
+};
+
+static int procfs_pcilist_filter_parse(struct procfs_pcilist_filter*, char*);
+static bool procfs_pcilist_filter_is_any(const struct procfs_pcilist_filter*);
+static struct pci_dev* procfs_pcilist_filter_next(const struct procfs_pcilist_filter*, struct pci_dev*);
+
+// references to every matching pci device taken at once, so that the devices
+// can be visited several times in the same order without walking the bus again
+
+struct procfs_pcilist_snapshot {
+    size_t count;
+    struct pci_dev* devices[];
+};
+
+static struct procfs_pcilist_snapshot* procfs_pcilist_snapshot_create(const struct procfs_pcilist_filter*);
+static void procfs_pcilist_snapshot_destroy(struct procfs_pcilist_snapshot*);
+
+// layout of the binary companion file; all fields are in host byte order
+// except config, which holds config space as little-endian bytes, exactly as
+// the config files in sysfs do; config_size is the number of bytes actually
+// read and the rest of config is zero
+
+#define PROCFS_PCILIST_CONFIG_MAGIC 0x70636963
+#define PROCFS_PCILIST_CONFIG_VERSION 1
+#define PROCFS_PCILIST_CONFIG_SIZE 256
+
+// devices handed to a single work item at least, below which spreading the
+// reads costs more than it saves
+
+#define PROCFS_PCILIST_CONFIG_WORK_MIN 32
+
+struct procfs_pcilist_config_header {
+    u32 magic;
+    u16 version;
+    u16 record_size;
+    u32 count;
+    u32 reserved;
+};
+
+struct procfs_pcilist_config_resource {
+    u64 start;
+    u64 end;
+    u64 flags;
+};
+
+struct procfs_pcilist_config_record {
+    u32 domain;
+    u8 bus;
+    u8 devfn;
+    u16 vendor;
+    u16 device;
+    u16 subsystem_vendor;
+    u16 subsystem_device;
+    u8 revision;
+    u8 header_type;
+    u32 class;
+    u32 config_size;
+    struct procfs_pcilist_config_resource resources[PCI_STD_NUM_BARS];
+    u8 config[PROCFS_PCILIST_CONFIG_SIZE];
+};
+
+// private data of an open companion file; the header and the records are
+// contiguous so the whole file is one buffer of length bytes
+
+struct procfs_pcilist_config_dump {
+    size_t length;
+    struct procfs_pcilist_config_header header;
+    struct procfs_pcilist_config_record records[];
+};
+
+struct procfs_pcilist_config_work {
+    struct work_struct work;
+    struct procfs_pcilist_snapshot* snapshot;
+    struct procfs_pcilist_config_record* records;
+    size_t first;
+    size_t last;
+};
+
+static void procfs_pcilist_config_fill(struct procfs_pcilist_config_record*, struct pci_dev*);
+static void procfs_pcilist_config_fill_range(struct procfs_pcilist_snapshot*, struct procfs_pcilist_config_record*, size_t, size_t);
+static void procfs_pcilist_config_work_fn(struct work_struct*);
+static void procfs_pcilist_config_fill_all(struct procfs_pcilist_snapshot*, struct procfs_pcilist_config_record*);
+
+// pre-rendered inventory shared by every reader; the cached inventory is
+// dropped by the bus notifier when a pci device is added or removed or a
+// driver is bound or unbound, and rendered again by the next open; each open
+// file holds its own reference so reads are a plain copy without locking
+
+struct procfs_pcilist_inventory {
+    struct kref kref;
+    size_t length;
+    char data[];
+};
+
+static int procfs_pcilist_format(char*, size_t, struct pci_dev*);
+static struct procfs_pcilist_inventory* procfs_pcilist_inventory_render(const struct procfs_pcilist_filter*);
+static void procfs_pcilist_inventory_release(struct kref*);
+static struct procfs_pcilist_inventory* procfs_pcilist_inventory_get(void);
+static void procfs_pcilist_inventory_put(struct procfs_pcilist_inventory*);
+static void procfs_pcilist_inventory_invalidate(void);
+
+static struct procfs_pcilist_inventory* procfs_pcilist_inventory = NULL;
+static DEFINE_MUTEX(procfs_pcilist_inventory_mutex);
+
+static int procfs_pcilist_bus_notify(struct notifier_block*, unsigned long, void*);
+
+static struct notifier_block procfs_pcilist_bus_notifier = {
+    .notifier_call = procfs_pcilist_bus_notify,
+};
+
+// per-operation latency histograms, built with LATENCY=1; read, write and
+// seek record the wait for the mutex of the open file separately, and the
+// config file has its own histograms since its open reads every device
+
+enum {
+    PROCFS_PCILIST_LATENCY_OPEN,
+    PROCFS_PCILIST_LATENCY_READ,
+    PROCFS_PCILIST_LATENCY_WRITE,
+    PROCFS_PCILIST_LATENCY_SEEK,
+    PROCFS_PCILIST_LATENCY_RELEASE,
+    PROCFS_PCILIST_LATENCY_CONFIG_OPEN,
+    PROCFS_PCILIST_LATENCY_CONFIG_READ,
+    PROCFS_PCILIST_LATENCY_CONFIG_SEEK,
+    PROCFS_PCILIST_LATENCY_CONFIG_RELEASE,
+    PROCFS_PCILIST_LATENCY_COUNT
+};
+
+static struct lkmpg_latency procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_COUNT] = {
+    [PROCFS_PCILIST_LATENCY_OPEN] = LKMPG_LATENCY_OP("open"),
+    [PROCFS_PCILIST_LATENCY_READ] = LKMPG_LATENCY_OP("read"),
+    [PROCFS_PCILIST_LATENCY_WRITE] = LKMPG_LATENCY_OP("write"),
+    [PROCFS_PCILIST_LATENCY_SEEK] = LKMPG_LATENCY_OP("seek"),
+    [PROCFS_PCILIST_LATENCY_RELEASE] = LKMPG_LATENCY_OP("release"),
+    [PROCFS_PCILIST_LATENCY_CONFIG_OPEN] = LKMPG_LATENCY_OP("config-open"),
+    [PROCFS_PCILIST_LATENCY_CONFIG_READ] = LKMPG_LATENCY_OP("config-read"),
+    [PROCFS_PCILIST_LATENCY_CONFIG_SEEK] = LKMPG_LATENCY_OP("config-seek"),
+    [PROCFS_PCILIST_LATENCY_CONFIG_RELEASE] = LKMPG_LATENCY_OP("config-release"),
+};
 
-static void* procfs_pcilist_seq_start(struct seq_file*, loff_t*);
-static void* procfs_pcilist_seq_next(struct seq_file*, void*, loff_t*);
-static void procfs_pcilist_seq_stop(struct seq_file*, void*);
-static int procfs_pcilist_seq_show(struct seq_file*, void*);
+static struct lkmpg_latency_set procfs_pcilist_latency_set;
 
-static const struct seq_operations procfs_pcilist_seq_ops = {
-    .start = procfs_pcilist_seq_start,
-    .next  = procfs_pcilist_seq_next,
-    .stop  = procfs_pcilist_seq_stop,
-    .show  = procfs_pcilist_seq_show
+// private data of an open file: either a reference to the cached inventory or
+// an inventory rendered for the filter of this file only
+
+struct procfs_pcilist_view {
+    struct mutex mutex;
+    struct procfs_pcilist_inventory* inventory;
 };
 
 int __init procfs_pcilist_init(void) {
 
+    int retval = 0;
+
+    // register for topology changes before the first inventory is rendered
+
+    if ((retval = bus_register_notifier(&pci_bus_type, &procfs_pcilist_bus_notifier))) {
+        pr_err("[%s:%s] failed to register pci bus notifier: %d\n", PROCFS_PCILIST_MODULE_NAME, __func__, retval);
+        return retval;
+    }
+
     struct proc_dir_entry* entry = proc_create(PROCFS_PCILIST_FILE_NAME, PROCFS_PCILIST_FILE_MODE, PROCFS_PCILIST_FILE_PARENT, &procfs_pcilist_proc_ops);
 
     if (!entry) {
         pr_err("[%s:%s] failed to create proc entry\n", PROCFS_PCILIST_MODULE_NAME, __func__);
+        bus_unregister_notifier(&pci_bus_type, &procfs_pcilist_bus_notifier);
+        return -ENOMEM;
+    }
+
+    entry = proc_create(PROCFS_PCILIST_CONFIG_FILE_NAME, PROCFS_PCILIST_CONFIG_FILE_MODE, PROCFS_PCILIST_FILE_PARENT, &procfs_pcilist_config_proc_ops);
+
+    if (!entry) {
+        pr_err("[%s:%s] failed to create config proc entry\n", PROCFS_PCILIST_MODULE_NAME, __func__);
+        remove_proc_entry(PROCFS_PCILIST_FILE_NAME, NULL);
+        bus_unregister_notifier(&pci_bus_type, &procfs_pcilist_bus_notifier);
         return -ENOMEM;
     }
 
+    if (lkmpg_latency_register(&procfs_pcilist_latency_set, PROCFS_PCILIST_MODULE_NAME, procfs_pcilist_latency, PROCFS_PCILIST_LATENCY_COUNT)) {
+        pr_err("[%s:%s] failed to create latency histograms\n", PROCFS_PCILIST_MODULE_NAME, __func__);
+    }
+
     return 0;
 
 }
 
 void __exit procfs_pcilist_exit(void) {
 
+    remove_proc_entry(PROCFS_PCILIST_CONFIG_FILE_NAME, NULL);
     remove_proc_entry(PROCFS_PCILIST_FILE_NAME, NULL);
+    lkmpg_latency_unregister(&procfs_pcilist_latency_set);
+    bus_unregister_notifier(&pci_bus_type, &procfs_pcilist_bus_notifier);
+    procfs_pcilist_inventory_invalidate();
 
 }
 
 int procfs_pcilist_proc_open(struct inode* inode, struct file* file) {
 
-    return seq_open(file, &procfs_pcilist_seq_ops);
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+
+    struct procfs_pcilist_view* view = kmalloc(sizeof(*view), GFP_KERNEL);
+
+    if (!view) {
+        trace_procfs_pcilist_open(file, -ENOMEM);
+        return -ENOMEM;
+    }
+
+    if (!(view->inventory = procfs_pcilist_inventory_get())) {
+        pr_err("[%s:%s] failed to render pci device inventory\n", PROCFS_PCILIST_MODULE_NAME, __func__);
+        kfree(view);
+        trace_procfs_pcilist_open(file, -ENOMEM);
+        return -ENOMEM;
+    }
+
+    mutex_init(&view->mutex);
+    file->private_data = view;
+    trace_procfs_pcilist_open(file, 0);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_OPEN], &timer);
+
+    return 0;
 
 }
 
 ssize_t procfs_pcilist_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
 
-    return seq_read(file, buffer, length, offset);
+    ssize_t retval = 0;
+    loff_t position = *offset;
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_view* view = file->private_data;
+
+    lkmpg_latency_start(&timer);
+
+    // only serializes against a filter being set on the same open file
+
+    if (mutex_lock_interruptible(&view->mutex)) {
+        trace_procfs_pcilist_read(file, length, position, -ERESTARTSYS);
+        return -ERESTARTSYS;
+    }
+
+    lkmpg_latency_locked(&timer);
+    retval = simple_read_from_buffer(buffer, length, offset, view->inventory->data, view->inventory->length);
+    mutex_unlock(&view->mutex);
+
+    trace_procfs_pcilist_read(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_READ], &timer);
+
+    return retval;
+
+}
+
+ssize_t procfs_pcilist_proc_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
+
+    ssize_t retval = 0;
+    loff_t position = *offset;
+    char* kbuffer = NULL;
+    struct procfs_pcilist_filter filter = procfs_pcilist_filter_any;
+    struct procfs_pcilist_inventory* inventory = NULL;
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_view* view = file->private_data;
+
+    lkmpg_latency_start(&timer);
+
+    if (length >= PROCFS_PCILIST_FILTER_SIZE) {
+        trace_procfs_pcilist_write(file, length, position, -EINVAL);
+        return -EINVAL;
+    }
+
+    kbuffer = memdup_user_nul(buffer, length);
+
+    if (IS_ERR(kbuffer)) {
+        trace_procfs_pcilist_write(file, length, position, PTR_ERR(kbuffer));
+        return PTR_ERR(kbuffer);
+    }
+
+    if ((retval = procfs_pcilist_filter_parse(&filter, kbuffer))) {
+        pr_err("[%s:%s] failed to parse filter (length = %zu, error = %zd)\n", PROCFS_PCILIST_MODULE_NAME, __func__, length, retval);
+        goto PROCFS_PCILIST_PROC_WRITE_EXIT;
+    }
+
+    // an empty filter goes back to the shared inventory
+
+    inventory = procfs_pcilist_filter_is_any(&filter) ? procfs_pcilist_inventory_get() : procfs_pcilist_inventory_render(&filter);
+
+    if (!inventory) {
+        retval = -ENOMEM;
+        goto PROCFS_PCILIST_PROC_WRITE_EXIT;
+    }
+
+    // the next read starts at the beginning of the filtered inventory
+
+    mutex_lock(&view->mutex);
+    lkmpg_latency_locked(&timer);
+    swap(view->inventory, inventory);
+    *offset = 0;
+    mutex_unlock(&view->mutex);
+
+    procfs_pcilist_inventory_put(inventory);
+    retval = length;
+
+PROCFS_PCILIST_PROC_WRITE_EXIT:
+
+    kfree(kbuffer);
+    trace_procfs_pcilist_write(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_WRITE], &timer);
+    return retval;
 
 }
 
 loff_t procfs_pcilist_proc_lseek(struct file* file, loff_t offset, int whence) {
 
-    return seq_lseek(file, offset, whence);
+    loff_t retval = 0;
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_view* view = file->private_data;
+
+    lkmpg_latency_start(&timer);
+    mutex_lock(&view->mutex);
+    lkmpg_latency_locked(&timer);
+    retval = fixed_size_llseek(file, offset, whence, view->inventory->length);
+    mutex_unlock(&view->mutex);
+
+    trace_procfs_pcilist_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_SEEK], &timer);
+
+    return retval;
 
 }
 
 int procfs_pcilist_proc_release(struct inode* inode, struct file* file) {
 
-    return seq_release(inode, file);
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_view* view = file->private_data;
+
+    lkmpg_latency_start(&timer);
+    procfs_pcilist_inventory_put(view->inventory);
+    kfree(view);
+
+    trace_procfs_pcilist_release(file, 0);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_RELEASE], &timer);
+
+    return 0;
+
+}
+
+int procfs_pcilist_config_proc_open(struct inode* inode, struct file* file) {
+
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_config_dump* dump = NULL;
+    struct procfs_pcilist_snapshot* snapshot = NULL;
+
+    lkmpg_latency_start(&timer);
+    snapshot = procfs_pcilist_snapshot_create(&procfs_pcilist_filter_any);
+
+    BUILD_BUG_ON(offsetof(struct procfs_pcilist_config_dump, records) != offsetof(struct procfs_pcilist_config_dump, header) + sizeof(struct procfs_pcilist_config_header));
+
+    if (!snapshot) {
+        trace_procfs_pcilist_open(file, -ENOMEM);
+        return -ENOMEM;
+    }
+
+    dump = kvzalloc(struct_size(dump, records, snapshot->count), GFP_KERNEL);
+
+    if (!dump) {
+        procfs_pcilist_snapshot_destroy(snapshot);
+        trace_procfs_pcilist_open(file, -ENOMEM);
+        return -ENOMEM;
+    }
+
+    dump->length = sizeof(dump->header) + snapshot->count * sizeof(dump->records[0]);
+    dump->header.magic = PROCFS_PCILIST_CONFIG_MAGIC;
+    dump->header.version = PROCFS_PCILIST_CONFIG_VERSION;
+    dump->header.record_size = sizeof(dump->records[0]);
+    dump->header.count = snapshot->count;
+
+    procfs_pcilist_config_fill_all(snapshot, dump->records);
+    procfs_pcilist_snapshot_destroy(snapshot);
+
+    file->private_data = dump;
+    trace_procfs_pcilist_open(file, 0);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_CONFIG_OPEN], &timer);
+
+    return 0;
+
+}
+
+ssize_t procfs_pcilist_config_proc_read(struct file* file, char __user* buffer, size_t length, loff_t* offset) {
+
+    loff_t position = *offset;
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_config_dump* dump = file->private_data;
+
+    lkmpg_latency_start(&timer);
+
+    ssize_t retval = simple_read_from_buffer(buffer, length, offset, &dump->header, dump->length);
+
+    trace_procfs_pcilist_read(file, length, position, retval);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_CONFIG_READ], &timer);
+
+    return retval;
 
 }
 
-void* procfs_pcilist_seq_start(struct seq_file* file, loff_t* position) {
+loff_t procfs_pcilist_config_proc_lseek(struct file* file, loff_t offset, int whence) {
+
+    struct lkmpg_latency_timer timer;
+    struct procfs_pcilist_config_dump* dump = file->private_data;
+
+    lkmpg_latency_start(&timer);
+
+    loff_t retval = fixed_size_llseek(file, offset, whence, dump->length);
+
+    trace_procfs_pcilist_seek(file, offset, whence, retval);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_CONFIG_SEEK], &timer);
+
+    return retval;
+
+}
+
+int procfs_pcilist_config_proc_release(struct inode* inode, struct file* file) {
+
+    struct lkmpg_latency_timer timer;
+
+    lkmpg_latency_start(&timer);
+    kvfree(file->private_data);
+
+    trace_procfs_pcilist_release(file, 0);
+    lkmpg_latency_stop(&procfs_pcilist_latency[PROCFS_PCILIST_LATENCY_CONFIG_RELEASE], &timer);
+
+    return 0;
 
-    loff_t index = *position;
+}
+
+int procfs_pcilist_filter_parse(struct procfs_pcilist_filter* filter, char* input) {
+
+    int error = 0;
+    char* token = NULL;
+    char* value = NULL;
+    char* last = NULL;
+
+    while ((token = strsep(&input, PROCFS_PCILIST_FILTER_DELIMITERS))) {
+
+        if (token[0] == '\0') {
+            continue;
+        }
+
+        if (!(value = strchr(token, '='))) {
+            return -EINVAL;
+        }
+
+        *value++ = '\0';
+
+        if (!strcmp(token, "vendor")) {
+            error = kstrtouint(value, 0, &filter->vendor);
+        } else if (!strcmp(token, "device")) {
+            error = kstrtouint(value, 0, &filter->device);
+        } else if (!strcmp(token, "class")) {
+            error = kstrtouint(value, 0, &filter->class);
+        } else if (!strcmp(token, "bus")) {
+            if ((last = strchr(value, '-'))) {
+                *last++ = '\0';
+            }
+            if (!(error = kstrtouint(value, 0, &filter->bus_first))) {
+                filter->bus_last = filter->bus_first;
+                error = last ? kstrtouint(last, 0, &filter->bus_last) : 0;
+            }
+        } else if (!strcmp(token, "driver")) {
+            error = strscpy(filter->driver, value, sizeof(filter->driver)) < 0 ? -EINVAL : 0;
+        } else {
+            error = -EINVAL;
+        }
+
+        if (error) {
+            return error;
+        }
+
+    }
+
+    return filter->bus_first <= filter->bus_last ? 0 : -EINVAL;
+
+}
+
+bool procfs_pcilist_filter_is_any(const struct procfs_pcilist_filter* filter) {
+
+    return filter->vendor == PCI_ANY_ID && filter->device == PCI_ANY_ID && filter->class == PCI_ANY_ID &&
+           filter->bus_first == 0 && filter->bus_last >= U8_MAX && filter->driver[0] == '\0';
+
+}
+
+struct pci_dev* procfs_pcilist_filter_next(const struct procfs_pcilist_filter* filter, struct pci_dev* from) {
+
+    struct pci_dev* pdev = from;
+    struct pci_driver* pdrv = NULL;
+
+    // like pci_get_device() this drops the reference to from and returns the
+    // next matching device with its reference count incremented; ids are
+    // handed to the pci core so that only bus, driver and (when combined with
+    // vendor or device ids) class are checked here
+
+    for (;;) {
+
+        if (filter->class != PCI_ANY_ID && filter->vendor == PCI_ANY_ID && filter->device == PCI_ANY_ID) {
+            pdev = pci_get_class(filter->class, pdev);
+        } else {
+            pdev = pci_get_device(filter->vendor, filter->device, pdev);
+        }
+
+        if (!pdev) {
+            return NULL;
+        }
+
+        if (filter->class != PCI_ANY_ID && pdev->class != filter->class) {
+            continue;
+        }
+
+        if (pdev->bus->number < filter->bus_first || pdev->bus->number > filter->bus_last) {
+            continue;
+        }
+
+        if (filter->driver[0] != '\0' && (!(pdrv = pci_dev_driver(pdev)) || strcmp(pdrv->name, filter->driver))) {
+            continue;
+        }
+
+        return pdev;
+
+    }
+
+}
+
+struct procfs_pcilist_snapshot* procfs_pcilist_snapshot_create(const struct procfs_pcilist_filter* filter) {
+
+    size_t count = 0;
     struct pci_dev* pdev = NULL;
+    struct procfs_pcilist_snapshot* snapshot = NULL;
+
+    // count devices first; devices added between the two passes are left out
+    // and devices removed between them leave the tail of the array unused
+
+    while ((pdev = procfs_pcilist_filter_next(filter, pdev)) != NULL) {
+        ++count;
+    }
+
+    snapshot = kvmalloc(struct_size(snapshot, devices, count), GFP_KERNEL);
+
+    if (!snapshot) {
+        return NULL;
+    }
+
+    // procfs_pcilist_filter_next() returns each device with its reference
+    // count incremented; another reference is kept in the snapshot and
+    // dropped in procfs_pcilist_snapshot_destroy()
+
+    snapshot->count = 0;
+
+    while (snapshot->count < count && (pdev = procfs_pcilist_filter_next(filter, pdev)) != NULL) {
+        snapshot->devices[snapshot->count++] = pci_dev_get(pdev);
+    }
+
+    // drop the reference held by the iterator if the loop stopped early
+
+    pci_dev_put(pdev);
+
+    return snapshot;
+
+}
+
+void procfs_pcilist_snapshot_destroy(struct procfs_pcilist_snapshot* snapshot) {
+
+    if (!snapshot) {
+        return;
+    }
+
+    for (size_t i = 0; i < snapshot->count; ++i) {
+        pci_dev_put(snapshot->devices[i]);
+    }
+
+    kvfree(snapshot);
+
+}
+
+void procfs_pcilist_config_fill(struct procfs_pcilist_config_record* record, struct pci_dev* pdev) {
+
+    u32 offset = 0;
+    u32 size = min_t(u32, pdev->cfg_size, PROCFS_PCILIST_CONFIG_SIZE);
+
+    record->domain = pci_domain_nr(pdev->bus);
+    record->bus = pdev->bus->number;
+    record->devfn = pdev->devfn;
+    record->vendor = pdev->vendor;
+    record->device = pdev->device;
+    record->subsystem_vendor = pdev->subsystem_vendor;
+    record->subsystem_device = pdev->subsystem_device;
+    record->revision = pdev->revision;
+    record->header_type = pdev->hdr_type;
+    record->class = pdev->class;
+
+    for (int i = 0; i < PCI_STD_NUM_BARS; ++i) {
+        record->resources[i].start = pci_resource_start(pdev, i);
+        record->resources[i].end = pci_resource_end(pdev, i);
+        record->resources[i].flags = pci_resource_flags(pdev, i);
+    }
+
+    // stop at the first failed read, so config_size tells how much is valid
 
-    // if start() returns a non-null pointer to a pci device then the reference
-    // count for that device has been incremented and must be decremented via a
-    // call to pci_get_device() in next() or pci_dev_put() in stop()
+    for (offset = 0; offset < size; offset += sizeof(u32)) {
 
-    while ((pdev = pci_get_device(PCI_ANY_ID, PCI_ANY_ID, pdev)) != NULL) {
-        if (!index--) {
+        u32 value = 0;
+        __le32 bytes;
+
+        if (pci_read_config_dword(pdev, offset, &value)) {
             break;
         }
+
+        bytes = cpu_to_le32(value);
+        memcpy(record->config + offset, &bytes, sizeof(bytes));
+
     }
 
-    return pdev;
+    record->config_size = offset;
 
 }
 
-void* procfs_pcilist_seq_next(struct seq_file* file, void* iter, loff_t* position) {
+void procfs_pcilist_config_fill_range(struct procfs_pcilist_snapshot* snapshot, struct procfs_pcilist_config_record* records, size_t first, size_t last) {
 
+    for (size_t i = first; i < last; ++i) {
+        procfs_pcilist_config_fill(&records[i], snapshot->devices[i]);
+    }
 
-    struct pci_dev* pdev = iter;
+}
 
-    // pci_get_device() decrements the reference count of the current pci device
-    // and returns either null or a non-null pointer to the next pci device; the
-    // reference count of the latter must be decremented by a corresponding call
-    // to next() or stop()
+void procfs_pcilist_config_work_fn(struct work_struct* work) {
 
-    ++*position;
-    return pci_get_device(PCI_ANY_ID, PCI_ANY_ID, pdev);
+    struct procfs_pcilist_config_work* self = container_of(work, struct procfs_pcilist_config_work, work);
+
+    procfs_pcilist_config_fill_range(self->snapshot, self->records, self->first, self->last);
 
 }
 
-void procfs_pcilist_seq_stop(struct seq_file* file, void* iter) {
+void procfs_pcilist_config_fill_all(struct procfs_pcilist_snapshot* snapshot, struct procfs_pcilist_config_record* records) {
+
+    size_t chunk = 0;
+    size_t workers = min_t(size_t, READ_ONCE(procfs_pcilist_param_config_workers), snapshot->count / PROCFS_PCILIST_CONFIG_WORK_MIN);
+    struct procfs_pcilist_config_work* works = NULL;
 
-    struct pci_dev* pdev = iter;
+    // config space accesses on legacy port io and on some host bridges take
+    // microseconds each; on large systems the devices are split into
+    // contiguous chunks read in parallel on the unbound workqueue, and the
+    // calling task reads the first chunk itself
 
-    // ensure that the reference count of the current pci device is decremented
-    // properly (for instance, if the iteration did not terminate naturally)
+    if (workers > 1) {
+        works = kcalloc(workers, sizeof(*works), GFP_KERNEL);
+    }
 
-    if (pdev) {
-        pci_dev_put(pdev);
+    if (!works) {
+        procfs_pcilist_config_fill_range(snapshot, records, 0, snapshot->count);
+        return;
     }
 
+    chunk = DIV_ROUND_UP(snapshot->count, workers);
+
+    for (size_t i = 1; i < workers; ++i) {
+        works[i].snapshot = snapshot;
+        works[i].records = records;
+        works[i].first = min(i * chunk, snapshot->count);
+        works[i].last = min(works[i].first + chunk, snapshot->count);
+        INIT_WORK(&works[i].work, procfs_pcilist_config_work_fn);
+        queue_work(system_unbound_wq, &works[i].work);
+    }
+
+    procfs_pcilist_config_fill_range(snapshot, records, 0, min(chunk, snapshot->count));
+
+    for (size_t i = 1; i < workers; ++i) {
+        flush_work(&works[i].work);
+    }
+
+    kfree(works);
+
 }
 
-int procfs_pcilist_seq_show(struct seq_file* file, void* iter) {
+int procfs_pcilist_format(char* buffer, size_t size, struct pci_dev* pdev) {
 
-    struct pci_dev* pdev = iter;
     struct pci_driver* pdrv = pci_dev_driver(pdev);
 
-    seq_printf(
-        file,
+    return snprintf(
+        buffer,
+        size,
         "%02X:%02X.%X %04X:%04X [%s]\n",
         pdev->bus->number,
         PCI_SLOT(pdev->devfn),
@@ -154,7 +800,111 @@ int procfs_pcilist_seq_show(struct seq_file* file, void* iter) {
         pdrv ? pdrv->name : ""
     );
 
-    return 0;
+}
+
+struct procfs_pcilist_inventory* procfs_pcilist_inventory_render(const struct procfs_pcilist_filter* filter) {
+
+    size_t size = 0;
+    struct procfs_pcilist_inventory* inventory = NULL;
+    struct procfs_pcilist_snapshot* snapshot = procfs_pcilist_snapshot_create(filter);
+
+    if (!snapshot) {
+        return NULL;
+    }
+
+    // measure then format the same devices; a driver bound in between can
+    // only truncate the last lines, and also invalidates this inventory
+
+    for (size_t i = 0; i < snapshot->count; ++i) {
+        size += procfs_pcilist_format(NULL, 0, snapshot->devices[i]);
+    }
+
+    inventory = kvmalloc(struct_size(inventory, data, size + 1), GFP_KERNEL);
+
+    if (inventory) {
+
+        kref_init(&inventory->kref);
+        inventory->length = 0;
+
+        for (size_t i = 0; i < snapshot->count; ++i) {
+            int bytes = procfs_pcilist_format(inventory->data + inventory->length, size + 1 - inventory->length, snapshot->devices[i]);
+            inventory->length += min_t(size_t, bytes, size - inventory->length);
+        }
+
+    }
+
+    procfs_pcilist_snapshot_destroy(snapshot);
+
+    return inventory;
+
+}
+
+void procfs_pcilist_inventory_release(struct kref* kref) {
+
+    kvfree(container_of(kref, struct procfs_pcilist_inventory, kref));
+
+}
+
+struct procfs_pcilist_inventory* procfs_pcilist_inventory_get(void) {
+
+    struct procfs_pcilist_inventory* inventory = NULL;
+
+    mutex_lock(&procfs_pcilist_inventory_mutex);
+
+    if (!procfs_pcilist_inventory) {
+        procfs_pcilist_inventory = procfs_pcilist_inventory_render(&procfs_pcilist_filter_any);
+    }
+
+    if ((inventory = procfs_pcilist_inventory)) {
+        kref_get(&inventory->kref);
+    }
+
+    mutex_unlock(&procfs_pcilist_inventory_mutex);
+
+    return inventory;
+
+}
+
+void procfs_pcilist_inventory_put(struct procfs_pcilist_inventory* inventory) {
+
+    if (inventory) {
+        kref_put(&inventory->kref, procfs_pcilist_inventory_release);
+    }
+
+}
+
+void procfs_pcilist_inventory_invalidate(void) {
+
+    struct procfs_pcilist_inventory* inventory = NULL;
+
+    // readers that already opened the file keep the inventory they got
+
+    mutex_lock(&procfs_pcilist_inventory_mutex);
+    inventory = procfs_pcilist_inventory;
+    procfs_pcilist_inventory = NULL;
+    mutex_unlock(&procfs_pcilist_inventory_mutex);
+
+    procfs_pcilist_inventory_put(inventory);
+
+}
+
+int procfs_pcilist_bus_notify(struct notifier_block* nb, unsigned long action, void* data) {
+
+    // removal is handled once the device has left the bus so that a render
+    // racing with the notification cannot cache the device being removed
+
+    switch (action) {
+    case BUS_NOTIFY_ADD_DEVICE:
+    case BUS_NOTIFY_REMOVED_DEVICE:
+    case BUS_NOTIFY_BOUND_DRIVER:
+    case BUS_NOTIFY_UNBOUND_DRIVER:
+        procfs_pcilist_inventory_invalidate();
+        break;
+    default:
+        break;
+    }
+
+    return NOTIFY_DONE;
 
 }
 
@@ -0,0 +1,46 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM procfs_pcilist
+
+// tracepoints for /proc/procfs-pcilist and /proc/procfs-pcilist-config, enabled at runtime with
+//
+// echo 1 > /sys/kernel/tracing/events/procfs_pcilist/enable
+// perf trace -e 'procfs_pcilist:*'
+
+#if !defined(_PROCFS_PCILIST_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PROCFS_PCILIST_TRACE_H
+
+#include "lkmpg-trace.h"
+
+DEFINE_EVENT(lkmpg_file, procfs_pcilist_open,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_file, procfs_pcilist_release,
+    TP_PROTO(const struct file* file, int retval),
+    TP_ARGS(file, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_pcilist_read,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_io, procfs_pcilist_write,
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+    TP_ARGS(file, length, offset, retval)
+);
+
+DEFINE_EVENT(lkmpg_seek, procfs_pcilist_seek,
+    TP_PROTO(const struct file* file, loff_t offset, int whence, loff_t retval),
+    TP_ARGS(file, offset, whence, retval)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+#include <trace/define_trace.h>
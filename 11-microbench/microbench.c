@@ -0,0 +1,579 @@
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/stat.h>
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/errno.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timex.h>
+#include <linux/uaccess.h>
+
+// times the primitives the other modules are built on when the module is
+// loaded, and reports the results through /proc/microbench; parameters
+// follow 03-hello-world and are read-only once loaded, so reload the module
+// to run again
+//
+// insmod microbench.ko primitive=copy_to_user iterations=1000000 sizes=64,4096 cpus=0,2
+// cat /proc/microbench
+//
+// cycles come from get_cycles() and read as 0 on architectures without a
+// cycle counter
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
+MODULE_DESCRIPTION("11-microbench");
+MODULE_VERSION("0.1");
+
+#define MICROBENCH_MODULE_NAME "microbench"
+#define MICROBENCH_FILE_NAME "microbench"
+#define MICROBENCH_FILE_PERMS 0444
+#define MICROBENCH_FILE_PARENT NULL
+
+#define MICROBENCH_PRIMITIVE_LEN 32
+#define MICROBENCH_ITERATIONS_MAX 100000000UL
+#define MICROBENCH_BATCH_SIZE 10000UL
+#define MICROBENCH_SIZES_MAX 8
+#define MICROBENCH_SIZE_MAX (1 << 20)
+#define MICROBENCH_CPUS_MAX 64
+#define MICROBENCH_WARMUP_MAX 1000
+
+// input for the parsing primitive and format for the formatting primitives,
+// the same one 08-procfs-seqfile uses for each entry
+
+#define MICROBENCH_PARSE_INPUT "-12345"
+#define MICROBENCH_FORMAT "%03u\n"
+
+static int __init microbench_init(void);
+static void __exit microbench_exit(void);
+
+// a string parameter naming one primitive, or all of them
+
+static char microbench_param_primitive[MICROBENCH_PRIMITIVE_LEN] = "all";
+module_param_string(primitive, microbench_param_primitive, MICROBENCH_PRIMITIVE_LEN, 0444);
+MODULE_PARM_DESC(primitive, "primitive to time (copy_to_user, copy_from_user, mutex, spinlock, atomic, rcu, seq_printf, snprintf, kstrtoint or all)");
+
+// a named unsigned long parameter
+
+static unsigned long microbench_param_iterations = 100000;
+module_param_named(iterations, microbench_param_iterations, ulong, 0444);
+MODULE_PARM_DESC(iterations, "operations timed per result (at most 100000000)");
+
+// a named array parameter with payload sizes, only used by the copies
+
+static int microbench_param_sizes[MICROBENCH_SIZES_MAX] = {8, 64, 512, 4096};
+static int microbench_param_sizes_count = 4;
+module_param_array_named(sizes, microbench_param_sizes, int, &microbench_param_sizes_count, 0444);
+MODULE_PARM_DESC(sizes, "payload sizes in bytes for copy_to_user and copy_from_user");
+
+// a named array parameter with the cpus to run on; the task that loads the
+// module is pinned to each in turn, and stays where it is when none is given
+
+static int microbench_param_cpus[MICROBENCH_CPUS_MAX] = {};
+static int microbench_param_cpus_count = 0;
+module_param_array_named(cpus, microbench_param_cpus, int, &microbench_param_cpus_count, 0444);
+MODULE_PARM_DESC(cpus, "cpus to run on, defaults to the cpu the module is loaded on");
+
+// state shared by the primitives; the user buffer is mapped into the task
+// that loads the module, which is the only task that runs the primitives
+
+struct microbench_context {
+    void __user* user;
+    void* kernel;
+    struct mutex mutex;
+    spinlock_t spinlock;
+    atomic_t atomic;
+    int __rcu* rcu_pointer;
+    int rcu_value;
+    struct seq_file seq;
+    unsigned long sink;
+};
+
+// every primitive loops over its iterations itself, so that the indirect
+// call is paid once per batch of MICROBENCH_BATCH_SIZE operations instead of
+// once per operation; the batches are timed one by one, and the module
+// reschedules between them, outside the timed region
+
+struct microbench_primitive {
+    const char* name;
+    bool sized;
+    int (*run)(struct microbench_context*, size_t, unsigned long);
+};
+
+struct microbench_result {
+    const char* primitive;
+    int size;
+    int cpu;
+    unsigned long iterations;
+    u64 ns;
+    u64 cycles;
+};
+
+static int microbench_copy_to_user(struct microbench_context*, size_t, unsigned long);
+static int microbench_copy_from_user(struct microbench_context*, size_t, unsigned long);
+static int microbench_mutex(struct microbench_context*, size_t, unsigned long);
+static int microbench_spinlock(struct microbench_context*, size_t, unsigned long);
+static int microbench_atomic(struct microbench_context*, size_t, unsigned long);
+static int microbench_rcu(struct microbench_context*, size_t, unsigned long);
+static int microbench_seq_printf(struct microbench_context*, size_t, unsigned long);
+static int microbench_snprintf(struct microbench_context*, size_t, unsigned long);
+static int microbench_kstrtoint(struct microbench_context*, size_t, unsigned long);
+
+static const struct microbench_primitive microbench_primitives[] = {
+    {"copy_to_user", true, microbench_copy_to_user},
+    {"copy_from_user", true, microbench_copy_from_user},
+    {"mutex", false, microbench_mutex},
+    {"spinlock", false, microbench_spinlock},
+    {"atomic", false, microbench_atomic},
+    {"rcu", false, microbench_rcu},
+    {"seq_printf", false, microbench_seq_printf},
+    {"snprintf", false, microbench_snprintf},
+    {"kstrtoint", false, microbench_kstrtoint},
+};
+
+static bool microbench_selected(const struct microbench_primitive*);
+static int microbench_validate(size_t* count, size_t* capacity);
+static int microbench_run(struct microbench_context*, int cpu, size_t* index);
+
+static void* microbench_seq_start(struct seq_file*, loff_t*);
+static void microbench_seq_stop(struct seq_file*, void*);
+static void* microbench_seq_next(struct seq_file*, void*, loff_t*);
+static int microbench_seq_show(struct seq_file*, void*);
+
+static const struct seq_operations microbench_seq_ops = {
+    .start = microbench_seq_start,
+    .stop = microbench_seq_stop,
+    .next = microbench_seq_next,
+    .show = microbench_seq_show
+};
+
+// results are written once during initialization and only read afterwards
+
+static struct microbench_result* microbench_results = NULL;
+static size_t microbench_results_count = 0;
+
+static struct proc_dir_entry* microbench_file = NULL;
+
+int __init microbench_init(void) {
+
+    int retval = 0;
+    size_t count = 0;
+    size_t index = 0;
+    size_t capacity = 0;
+    cpumask_var_t cpus_allowed;
+    struct microbench_context* context = NULL;
+
+    if ((retval = microbench_validate(&count, &capacity))) {
+        return retval;
+    }
+
+    // the copies need a user address space, which kernel threads lack
+
+    if (!current->mm) {
+        pr_err("[%s:%s] no user address space to copy to and from\n", MICROBENCH_MODULE_NAME, __func__);
+        return -EINVAL;
+    }
+
+    if (!alloc_cpumask_var(&cpus_allowed, GFP_KERNEL)) {
+        return -ENOMEM;
+    }
+
+    cpumask_copy(cpus_allowed, current->cpus_ptr);
+
+    microbench_results = kcalloc(count, sizeof(*microbench_results), GFP_KERNEL);
+    context = kzalloc(sizeof(*context), GFP_KERNEL);
+
+    if (!microbench_results || !context) {
+        retval = -ENOMEM;
+        goto MICROBENCH_INIT_EXIT;
+    }
+
+    mutex_init(&context->mutex);
+    spin_lock_init(&context->spinlock);
+    atomic_set(&context->atomic, 0);
+    RCU_INIT_POINTER(context->rcu_pointer, &context->rcu_value);
+
+    // the seq_file is never attached to a file, seq_printf() only needs its
+    // buffer and size
+
+    context->kernel = kvzalloc(max_t(size_t, capacity, PAGE_SIZE), GFP_KERNEL);
+    context->seq.buf = context->kernel;
+    context->seq.size = max_t(size_t, capacity, PAGE_SIZE);
+
+    if (!context->kernel) {
+        retval = -ENOMEM;
+        goto MICROBENCH_INIT_EXIT;
+    }
+
+    context->user = (void __user*) vm_mmap(NULL, 0, capacity, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, 0);
+
+    if (IS_ERR_VALUE((unsigned long) context->user)) {
+        pr_err("[%s:%s] failed to map user buffer (size = %zu)\n", MICROBENCH_MODULE_NAME, __func__, capacity);
+        retval = (long) context->user;
+        context->user = NULL;
+        goto MICROBENCH_INIT_EXIT;
+    }
+
+    if (!microbench_param_cpus_count) {
+        retval = microbench_run(context, raw_smp_processor_id(), &index);
+    }
+
+    for (int i = 0; i < microbench_param_cpus_count && !retval; ++i) {
+
+        int cpu = microbench_param_cpus[i];
+
+        if ((retval = set_cpus_allowed_ptr(current, cpumask_of(cpu)))) {
+            pr_err("[%s:%s] failed to move to cpu %d: %d\n", MICROBENCH_MODULE_NAME, __func__, cpu, retval);
+            break;
+        }
+
+        retval = microbench_run(context, cpu, &index);
+
+    }
+
+    set_cpus_allowed_ptr(current, cpus_allowed);
+
+    if (retval) {
+        goto MICROBENCH_INIT_EXIT;
+    }
+
+    microbench_results_count = index;
+    microbench_file = proc_create_seq(MICROBENCH_FILE_NAME, MICROBENCH_FILE_PERMS, MICROBENCH_FILE_PARENT, &microbench_seq_ops);
+
+    if (!microbench_file) {
+        pr_err("[%s:%s] failed to create /proc/%s with permissions %o\n", MICROBENCH_MODULE_NAME, __func__, MICROBENCH_FILE_NAME, MICROBENCH_FILE_PERMS);
+        retval = -ENOMEM;
+    }
+
+MICROBENCH_INIT_EXIT:
+
+    if (context && context->user) {
+        vm_munmap((unsigned long) context->user, capacity);
+    }
+
+    if (context) {
+        kvfree(context->kernel);
+        kfree(context);
+    }
+
+    if (retval) {
+        kfree(microbench_results);
+        microbench_results = NULL;
+    }
+
+    free_cpumask_var(cpus_allowed);
+    return retval;
+
+}
+
+void __exit microbench_exit(void) {
+
+    proc_remove(microbench_file);
+    kfree(microbench_results);
+
+    return;
+
+}
+
+bool microbench_selected(const struct microbench_primitive* primitive) {
+    return !strcmp(microbench_param_primitive, "all") || !strcmp(microbench_param_primitive, primitive->name);
+}
+
+int microbench_validate(size_t* count, size_t* capacity) {
+
+    size_t runs = 0;
+    bool known = false;
+
+    // parameters are checked before anything runs, so that a typo fails the
+    // load right away instead of after the other results
+
+    if (!microbench_param_iterations || microbench_param_iterations > MICROBENCH_ITERATIONS_MAX) {
+        pr_err("[%s:%s] invalid iterations %lu (maximum = %lu)\n", MICROBENCH_MODULE_NAME, __func__, microbench_param_iterations, MICROBENCH_ITERATIONS_MAX);
+        return -EINVAL;
+    }
+
+    *capacity = PAGE_SIZE;
+
+    for (int i = 0; i < microbench_param_sizes_count; ++i) {
+
+        if (microbench_param_sizes[i] <= 0 || microbench_param_sizes[i] > MICROBENCH_SIZE_MAX) {
+            pr_err("[%s:%s] invalid size %d (maximum = %d)\n", MICROBENCH_MODULE_NAME, __func__, microbench_param_sizes[i], MICROBENCH_SIZE_MAX);
+            return -EINVAL;
+        }
+
+        *capacity = max_t(size_t, *capacity, PAGE_ALIGN(microbench_param_sizes[i]));
+
+    }
+
+    for (int i = 0; i < microbench_param_cpus_count; ++i) {
+
+        if (microbench_param_cpus[i] < 0 || (unsigned int) microbench_param_cpus[i] >= nr_cpu_ids || !cpu_online(microbench_param_cpus[i])) {
+            pr_err("[%s:%s] cpu %d is not online\n", MICROBENCH_MODULE_NAME, __func__, microbench_param_cpus[i]);
+            return -EINVAL;
+        }
+
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(microbench_primitives); ++i) {
+        if (microbench_selected(&microbench_primitives[i])) {
+            known = true;
+            runs += microbench_primitives[i].sized ? microbench_param_sizes_count : 1;
+        }
+    }
+
+    if (!known) {
+        pr_err("[%s:%s] unknown primitive \"%s\"\n", MICROBENCH_MODULE_NAME, __func__, microbench_param_primitive);
+        return -EINVAL;
+    }
+
+    // an empty sizes= leaves the copies nothing to run
+
+    if (!runs) {
+        pr_err("[%s:%s] no sizes given for \"%s\"\n", MICROBENCH_MODULE_NAME, __func__, microbench_param_primitive);
+        return -EINVAL;
+    }
+
+    *count = runs * max(microbench_param_cpus_count, 1);
+
+    return 0;
+
+}
+
+int microbench_run(struct microbench_context* context, int cpu, size_t* index) {
+
+    int retval = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(microbench_primitives); ++i) {
+
+        const struct microbench_primitive* primitive = &microbench_primitives[i];
+        int sizes = primitive->sized ? microbench_param_sizes_count : 1;
+
+        if (!microbench_selected(primitive)) {
+            continue;
+        }
+
+        for (int j = 0; j < sizes; ++j) {
+
+            struct microbench_result* result = &microbench_results[(*index)++];
+            size_t size = primitive->sized ? microbench_param_sizes[j] : 0;
+            unsigned long batch = 0;
+            cycles_t cycles = 0;
+            cycles_t start_cycles = 0;
+            u64 ns = 0;
+            u64 start_ns = 0;
+
+            // an untimed pass faults in the user buffer and warms the caches
+
+            if ((retval = primitive->run(context, size, min_t(unsigned long, microbench_param_iterations, MICROBENCH_WARMUP_MAX)))) {
+                return retval;
+            }
+
+            for (unsigned long done = 0; done < microbench_param_iterations && !retval; done += batch) {
+
+                batch = min(microbench_param_iterations - done, MICROBENCH_BATCH_SIZE);
+
+                start_ns = ktime_get_ns();
+                start_cycles = get_cycles();
+                retval = primitive->run(context, size, batch);
+                cycles += get_cycles() - start_cycles;
+                ns += ktime_get_ns() - start_ns;
+
+                cond_resched();
+
+            }
+
+            if (retval) {
+                pr_err("[%s:%s] %s failed on cpu %d: %d\n", MICROBENCH_MODULE_NAME, __func__, primitive->name, cpu, retval);
+                return retval;
+            }
+
+            result->primitive = primitive->name;
+            result->size = size;
+            result->cpu = cpu;
+            result->iterations = microbench_param_iterations;
+            result->ns = ns;
+            result->cycles = cycles;
+
+        }
+
+    }
+
+    return 0;
+
+}
+
+int microbench_copy_to_user(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        if (copy_to_user(context->user, context->kernel, size)) {
+            return -EFAULT;
+        }
+    }
+
+    return 0;
+
+}
+
+int microbench_copy_from_user(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        if (copy_from_user(context->kernel, context->user, size)) {
+            return -EFAULT;
+        }
+    }
+
+    return 0;
+
+}
+
+int microbench_mutex(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        mutex_lock(&context->mutex);
+        ++context->sink;
+        mutex_unlock(&context->mutex);
+    }
+
+    return 0;
+
+}
+
+int microbench_spinlock(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        spin_lock(&context->spinlock);
+        ++context->sink;
+        spin_unlock(&context->spinlock);
+    }
+
+    return 0;
+
+}
+
+int microbench_atomic(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        atomic_inc(&context->atomic);
+    }
+
+    return 0;
+
+}
+
+int microbench_rcu(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    unsigned long sum = 0;
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        rcu_read_lock();
+        sum += *rcu_dereference(context->rcu_pointer);
+        rcu_read_unlock();
+    }
+
+    WRITE_ONCE(context->sink, sum);
+
+    return 0;
+
+}
+
+int microbench_seq_printf(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        context->seq.count = 0;
+        seq_printf(&context->seq, MICROBENCH_FORMAT, (u8) i);
+    }
+
+    return 0;
+
+}
+
+int microbench_snprintf(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+        snprintf(context->kernel, PAGE_SIZE, MICROBENCH_FORMAT, (u8) i);
+    }
+
+    return 0;
+
+}
+
+int microbench_kstrtoint(struct microbench_context* context, size_t size, unsigned long iterations) {
+
+    int value = 0;
+    unsigned long sum = 0;
+
+    for (unsigned long i = 0; i < iterations; ++i) {
+
+        if (kstrtoint(MICROBENCH_PARSE_INPUT, 0, &value)) {
+            return -EINVAL;
+        }
+
+        sum += value;
+
+    }
+
+    WRITE_ONCE(context->sink, sum);
+
+    return 0;
+
+}
+
+static void* microbench_seq_start(struct seq_file* seq, loff_t* pos) {
+
+    // position 0 is the header line, results follow from position 1
+
+    if (*pos == 0) {
+        return SEQ_START_TOKEN;
+    }
+
+    return (size_t) *pos <= microbench_results_count ? &microbench_results[*pos - 1] : NULL;
+
+}
+
+static void microbench_seq_stop(struct seq_file* seq, void* iter) {
+    return;
+}
+
+static void* microbench_seq_next(struct seq_file* seq, void* iter, loff_t* pos) {
+    ++*pos;
+    return (size_t) *pos <= microbench_results_count ? &microbench_results[*pos - 1] : NULL;
+}
+
+static int microbench_seq_show(struct seq_file* seq, void* iter) {
+
+    const struct microbench_result* result = iter;
+    u64 ns_per_op = 0;
+    u64 cycles_per_op = 0;
+
+    if (iter == SEQ_START_TOKEN) {
+        seq_printf(seq, "%-16s %8s %4s %12s %14s %12s %14s\n", "primitive", "size", "cpu", "iterations", "ns", "ns/op", "cycles/op");
+        return 0;
+    }
+
+    // per-op figures are printed with two decimals, since most primitives
+    // take only a few nanoseconds
+
+    ns_per_op = div64_u64(result->ns * 100, result->iterations);
+    cycles_per_op = div64_u64(result->cycles * 100, result->iterations);
+
+    seq_printf(seq, "%-16s %8d %4d %12lu %14llu %9llu.%02llu %11llu.%02llu\n", result->primitive, result->size, result->cpu, result->iterations, result->ns, ns_per_op / 100, ns_per_op % 100, cycles_per_op / 100, cycles_per_op % 100);
+
+    return 0;
+
+}
+
+module_init(microbench_init);
+module_exit(microbench_exit);
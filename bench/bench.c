@@ -0,0 +1,833 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#include <unistd.h>
+
+// load generator for the device files of the modules in this repository
+//
+// every scenario runs for a fixed duration once per thread count, and prints
+// one json object per line with throughput and latency percentiles, so that
+// a list of thread counts gives a scaling curve:
+//
+// bench -T procfs-buffer,procfs-seqfile -t 1,2,4,8 -m 90 -s 64 -d 5
+//
+// with -S reads go through sendfile() into a memfd instead of pread(), which
+// exercises the splice path of the file instead of its read path
+//
+// the sysfs-notify scenarios time a store to attr-int until a watcher sees
+// it, with poll(POLLPRI) or by re-reading the file every -i microseconds,
+// and report the cpu time the watcher used next to the latency; with -p the
+// stores are spaced out so that the watcher idles in between, as it would
+// in practice:
+//
+// bench -T sysfs-notify,sysfs-notify-timer -p 10000 -i 1000
+//
+// targets that are not present (module not loaded) are skipped with a
+// message on stderr
+
+#define BENCH_DEFAULT_DURATION 3
+#define BENCH_DEFAULT_READ_PERCENT 100
+#define BENCH_DEFAULT_SIZE 128
+#define BENCH_MAX_THREADS 1024
+#define BENCH_MAX_SIZE (1 << 20)
+#define BENCH_DEFAULT_INTERVAL_US 1000
+
+// log-linear histogram: values below 16 ns have a bucket each, and every
+// power of two above is split into 16 buckets (about 6% relative error)
+
+#define BENCH_HISTOGRAM_SUB_BITS 4
+#define BENCH_HISTOGRAM_SUB (1 << BENCH_HISTOGRAM_SUB_BITS)
+#define BENCH_HISTOGRAM_BUCKETS (64 * BENCH_HISTOGRAM_SUB)
+
+struct bench_histogram {
+    uint64_t count;
+    uint64_t buckets[BENCH_HISTOGRAM_BUCKETS];
+};
+
+// BENCH_TARGET_WRITABLE targets take writes in the mix, BENCH_TARGET_REOPEN
+// targets are opened and closed around every read (the chardev device only
+// fills its message on open and allows a single opener), BENCH_TARGET_NOTIFY
+// targets run a watcher against a writer, and BENCH_TARGET_TIMER makes the
+// watcher poll on a timer instead of waiting for POLLPRI
+
+enum {
+    BENCH_TARGET_WRITABLE = 1 << 0,
+    BENCH_TARGET_REOPEN = 1 << 1,
+    BENCH_TARGET_NOTIFY = 1 << 2,
+    BENCH_TARGET_TIMER = 1 << 3,
+};
+
+struct bench_target {
+    const char* name;
+    const char* path;
+    unsigned flags;
+    size_t (*payload)(char*, size_t);
+};
+
+static size_t bench_payload_text(char*, size_t);
+static size_t bench_payload_numbers(char*, size_t);
+static size_t bench_payload_int(char*, size_t);
+static size_t bench_payload_filter(char*, size_t);
+
+#define BENCH_SYSFS_ATTRS_DIR "/sys/kernel/sysfs-attrs/"
+
+static const struct bench_target bench_targets[] = {
+    { "chardev", "/dev/chardev", BENCH_TARGET_REOPEN, NULL },
+    { "procfs-static", "/proc/procfs-static", 0, NULL },
+    { "procfs-buffer", "/proc/procfs-buffer", BENCH_TARGET_WRITABLE, bench_payload_text },
+    { "procfs-inode", "/proc/procfs-inode", BENCH_TARGET_WRITABLE, bench_payload_text },
+    { "procfs-seqfile", "/proc/procfs-seqfile", BENCH_TARGET_WRITABLE, bench_payload_numbers },
+    { "procfs-pcilist", "/proc/procfs-pcilist", BENCH_TARGET_WRITABLE, bench_payload_filter },
+    { "procfs-pcilist-config", "/proc/procfs-pcilist-config", 0, NULL },
+    { "sysfs-attr-int", BENCH_SYSFS_ATTRS_DIR "attr-int", BENCH_TARGET_WRITABLE, bench_payload_int },
+    { "sysfs-attr-string", BENCH_SYSFS_ATTRS_DIR "attr-string", BENCH_TARGET_WRITABLE, bench_payload_text },
+    { "sysfs-snapshot", BENCH_SYSFS_ATTRS_DIR "snapshot", 0, NULL },
+    { "sysfs-notify", BENCH_SYSFS_ATTRS_DIR "attr-int", BENCH_TARGET_NOTIFY, bench_payload_int },
+    { "sysfs-notify-timer", BENCH_SYSFS_ATTRS_DIR "attr-int", BENCH_TARGET_NOTIFY | BENCH_TARGET_TIMER, bench_payload_int },
+};
+
+#define BENCH_TARGET_COUNT (sizeof(bench_targets) / sizeof(bench_targets[0]))
+
+struct bench_options {
+    unsigned threads[BENCH_MAX_THREADS];
+    size_t thread_counts;
+    unsigned duration;
+    unsigned read_percent;
+    size_t size;
+    unsigned interval_us;
+    unsigned period_us;
+    bool sendfile;
+    bool selected[BENCH_TARGET_COUNT];
+};
+
+struct bench_run;
+
+struct bench_worker {
+    pthread_t thread;
+    struct bench_run* run;
+    unsigned index;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t cpu_ns;
+    struct bench_histogram histogram;
+};
+
+struct bench_run {
+    const struct bench_target* target;
+    const struct bench_options* options;
+    pthread_barrier_t barrier;
+    atomic_bool stop;
+    char payload[BENCH_MAX_SIZE];
+    size_t payload_size;
+
+    // sysfs-notify: nanosecond timestamp taken right before each store, and
+    // the number of wakeups the waiter has seen
+
+    _Atomic uint64_t notify_stamp;
+    atomic_uint notify_seen;
+};
+
+static uint64_t bench_now(void);
+static uint64_t bench_thread_cpu(void);
+static void bench_histogram_add(struct bench_histogram*, uint64_t);
+static void bench_histogram_merge(struct bench_histogram*, const struct bench_histogram*);
+static uint64_t bench_histogram_percentile(const struct bench_histogram*, double);
+static ssize_t bench_worker_read(struct bench_worker*, int, char*, int);
+static void* bench_worker_main(void*);
+static void* bench_notify_waiter(void*);
+static void* bench_notify_timer(void*);
+static void* bench_notify_writer(void*);
+static int bench_run_target(const struct bench_target*, const struct bench_options*, unsigned);
+static int bench_parse_options(struct bench_options*, int, char**);
+static void bench_usage(FILE*, const char*);
+
+int main(int argc, char** argv) {
+
+    int retval = 0;
+    struct bench_options options = {};
+
+    if ((retval = bench_parse_options(&options, argc, argv))) {
+        return retval < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    for (size_t i = 0; i < BENCH_TARGET_COUNT; ++i) {
+
+        if (!options.selected[i]) {
+            continue;
+        }
+
+        if (access(bench_targets[i].path, F_OK)) {
+            fprintf(stderr, "[bench] skipping %s: %s: %s\n", bench_targets[i].name, bench_targets[i].path, strerror(errno));
+            continue;
+        }
+
+        for (size_t j = 0; j < options.thread_counts; ++j) {
+            if (bench_run_target(&bench_targets[i], &options, options.threads[j])) {
+                retval = EXIT_FAILURE;
+            }
+        }
+
+    }
+
+    return retval;
+
+}
+
+uint64_t bench_now(void) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+}
+
+uint64_t bench_thread_cpu(void) {
+
+    struct rusage usage;
+
+    // user and system time of the calling thread, at the microsecond
+    // resolution getrusage() reports it with
+
+    if (getrusage(RUSAGE_THREAD, &usage)) {
+        return 0;
+    }
+
+    return ((uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+
+}
+
+void bench_histogram_add(struct bench_histogram* histogram, uint64_t value) {
+
+    unsigned index = value;
+
+    if (value >= BENCH_HISTOGRAM_SUB) {
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned sub = (value >> (msb - BENCH_HISTOGRAM_SUB_BITS)) & (BENCH_HISTOGRAM_SUB - 1);
+        index = (msb - BENCH_HISTOGRAM_SUB_BITS + 1) * BENCH_HISTOGRAM_SUB + sub;
+    }
+
+    ++histogram->buckets[index];
+    ++histogram->count;
+
+}
+
+void bench_histogram_merge(struct bench_histogram* into, const struct bench_histogram* from) {
+
+    for (size_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; ++i) {
+        into->buckets[i] += from->buckets[i];
+    }
+
+    into->count += from->count;
+
+}
+
+uint64_t bench_histogram_percentile(const struct bench_histogram* histogram, double percentile) {
+
+    uint64_t seen = 0;
+    uint64_t rank = 0;
+
+    if (!histogram->count) {
+        return 0;
+    }
+
+    // the rank of the percentile, rounded up, and reported as the upper
+    // bound of the bucket that holds it
+
+    rank = (uint64_t) (percentile / 100.0 * histogram->count);
+    rank = rank ? rank : 1;
+
+    for (unsigned i = 0; i < BENCH_HISTOGRAM_BUCKETS; ++i) {
+
+        if ((seen += histogram->buckets[i]) < rank) {
+            continue;
+        }
+
+        if (i < BENCH_HISTOGRAM_SUB) {
+            return i;
+        }
+
+        unsigned shift = i / BENCH_HISTOGRAM_SUB - 1;
+        uint64_t lower = (uint64_t) (BENCH_HISTOGRAM_SUB + i % BENCH_HISTOGRAM_SUB) << shift;
+
+        return lower + (1ULL << shift) - 1;
+
+    }
+
+    return UINT64_MAX;
+
+}
+
+ssize_t bench_worker_read(struct bench_worker* worker, int fd, char* buffer, int sink) {
+
+    off_t offset = 0;
+    ssize_t bytes = 0;
+
+    if (sink < 0) {
+        return pread(fd, buffer, worker->run->options->size, 0);
+    }
+
+    // sendfile() appends to the sink, which is rewound now and then so that
+    // it stays small
+
+    bytes = sendfile(sink, fd, &offset, worker->run->options->size);
+
+    if (!(worker->reads % 1024)) {
+        lseek(sink, 0, SEEK_SET);
+    }
+
+    return bytes;
+
+}
+
+void* bench_worker_main(void* argument) {
+
+    struct bench_worker* worker = argument;
+    struct bench_run* run = worker->run;
+    const struct bench_target* target = run->target;
+    unsigned seed = worker->index * 2654435761u + 1;
+    char* buffer = malloc(run->options->size);
+    int sink = run->options->sendfile ? memfd_create("bench", 0) : -1;
+    int fd = -1;
+
+    if (!buffer || (run->options->sendfile && sink < 0)) {
+        free(buffer);
+        ++worker->errors;
+        pthread_barrier_wait(&run->barrier);
+        return NULL;
+    }
+
+    if (!(target->flags & BENCH_TARGET_REOPEN)) {
+        fd = open(target->path, (target->flags & BENCH_TARGET_WRITABLE) ? O_RDWR : O_RDONLY);
+    }
+
+    pthread_barrier_wait(&run->barrier);
+
+    while (!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+
+        bool write_op = (target->flags & BENCH_TARGET_WRITABLE) && (unsigned) (rand_r(&seed) % 100) >= run->options->read_percent;
+        uint64_t start = bench_now();
+        ssize_t bytes = -1;
+
+        if (target->flags & BENCH_TARGET_REOPEN) {
+
+            if ((fd = open(target->path, O_RDONLY)) >= 0) {
+                bytes = sink < 0 ? read(fd, buffer, run->options->size) : bench_worker_read(worker, fd, buffer, sink);
+                close(fd);
+                fd = -1;
+            }
+
+        } else if (fd >= 0) {
+
+            // every request starts at offset zero so that the result does not
+            // depend on how far previous requests got
+
+            bytes = write_op ? pwrite(fd, run->payload, run->payload_size, 0) : bench_worker_read(worker, fd, buffer, sink);
+
+        }
+
+        bench_histogram_add(&worker->histogram, bench_now() - start);
+
+        if (bytes < 0) {
+            ++worker->errors;
+            continue;
+        }
+
+        worker->bytes += bytes;
+        ++*(write_op ? &worker->writes : &worker->reads);
+
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (sink >= 0) {
+        close(sink);
+    }
+
+    free(buffer);
+
+    return NULL;
+
+}
+
+void* bench_notify_waiter(void* argument) {
+
+    struct bench_worker* worker = argument;
+    struct bench_run* run = worker->run;
+    char buffer[64];
+    uint64_t cpu = 0;
+    int fd = open(run->target->path, O_RDONLY);
+
+    // sysfs only reports POLLPRI for a change after the attribute has been
+    // read from the open file, so it is read again after every wakeup
+
+    if (fd >= 0) {
+        pread(fd, buffer, sizeof(buffer), 0);
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    cpu = bench_thread_cpu();
+
+    while (fd >= 0 && !atomic_load(&run->stop)) {
+
+        struct pollfd pfd = { .fd = fd, .events = POLLPRI | POLLERR };
+        int ready = poll(&pfd, 1, 100);
+
+        if (ready < 0) {
+            ++worker->errors;
+            break;
+        }
+
+        if (!ready) {
+            continue;
+        }
+
+        uint64_t now = bench_now();
+        uint64_t stamp = atomic_load(&run->notify_stamp);
+
+        pread(fd, buffer, sizeof(buffer), 0);
+        bench_histogram_add(&worker->histogram, now - stamp);
+        ++worker->reads;
+        atomic_fetch_add(&run->notify_seen, 1);
+
+    }
+
+    worker->cpu_ns = bench_thread_cpu() - cpu;
+
+    if (fd < 0) {
+        ++worker->errors;
+    } else {
+        close(fd);
+    }
+
+    return NULL;
+
+}
+
+void* bench_notify_timer(void* argument) {
+
+    struct bench_worker* worker = argument;
+    struct bench_run* run = worker->run;
+    struct timespec interval = {
+        .tv_sec = run->options->interval_us / 1000000,
+        .tv_nsec = run->options->interval_us % 1000000 * 1000L,
+    };
+    char previous[64] = {};
+    char buffer[64] = {};
+    ssize_t length = -1;
+    uint64_t cpu = 0;
+    int fd = open(run->target->path, O_RDONLY);
+
+    // the alternative to POLLPRI: read the attribute every interval and
+    // compare it with the previous value, which wakes up whether the value
+    // changed or not and notices a change half an interval late on average
+
+    if (fd >= 0) {
+        length = pread(fd, previous, sizeof(previous) - 1, 0);
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    cpu = bench_thread_cpu();
+
+    while (fd >= 0 && length >= 0 && !atomic_load(&run->stop)) {
+
+        uint64_t now = 0;
+
+        nanosleep(&interval, NULL);
+
+        if ((length = pread(fd, buffer, sizeof(buffer) - 1, 0)) < 0) {
+            ++worker->errors;
+            break;
+        }
+
+        now = bench_now();
+        buffer[length] = '\0';
+
+        if (!strcmp(buffer, previous)) {
+            continue;
+        }
+
+        // the writer stamps before it stores and does not store again until
+        // the change is seen, so the stamp read after the change is the one
+        // of the store that made it
+
+        bench_histogram_add(&worker->histogram, now - atomic_load(&run->notify_stamp));
+        memcpy(previous, buffer, length + 1);
+        ++worker->reads;
+        atomic_fetch_add(&run->notify_seen, 1);
+
+    }
+
+    worker->cpu_ns = bench_thread_cpu() - cpu;
+
+    if (fd < 0) {
+        ++worker->errors;
+    } else {
+        close(fd);
+    }
+
+    return NULL;
+
+}
+
+void* bench_notify_writer(void* argument) {
+
+    struct bench_worker* worker = argument;
+    struct bench_run* run = worker->run;
+    unsigned value = 0;
+    unsigned seed = 1;
+    int fd = open(run->target->path, O_WRONLY);
+
+    pthread_barrier_wait(&run->barrier);
+
+    while (fd >= 0 && !atomic_load(&run->stop)) {
+
+        char payload[32];
+        int length = snprintf(payload, sizeof(payload), "%u\n", ++value);
+        unsigned seen = atomic_load(&run->notify_seen);
+
+        // store a new value and wait until the waiter has seen it, so that
+        // every sample measures a single store to wakeup path
+
+        atomic_store(&run->notify_stamp, bench_now());
+
+        if (pwrite(fd, payload, length, 0) < 0) {
+            ++worker->errors;
+            break;
+        }
+
+        ++worker->writes;
+
+        while (atomic_load(&run->notify_seen) == seen && !atomic_load(&run->stop)) {
+            sched_yield();
+        }
+
+        // with -p the next store comes after a random pause of half to one
+        // and a half periods, so that it does not fall into step with the
+        // timer of the watcher
+
+        if (run->options->period_us) {
+            unsigned pause_us = run->options->period_us / 2 + rand_r(&seed) % run->options->period_us;
+            struct timespec pause = { .tv_sec = pause_us / 1000000, .tv_nsec = pause_us % 1000000 * 1000L };
+            nanosleep(&pause, NULL);
+        }
+
+    }
+
+    if (fd < 0) {
+        ++worker->errors;
+    } else {
+        close(fd);
+    }
+
+    return NULL;
+
+}
+
+int bench_run_target(const struct bench_target* target, const struct bench_options* options, unsigned threads) {
+
+    int retval = 0;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    struct bench_worker* workers = NULL;
+    struct bench_histogram* histogram = NULL;
+    struct bench_run* run = calloc(1, sizeof(*run));
+    bool notify = target->flags & BENCH_TARGET_NOTIFY;
+    bool timer = target->flags & BENCH_TARGET_TIMER;
+    uint64_t watcher_cpu_ns = 0;
+    uint64_t reads = 0, writes = 0, errors = 0, bytes = 0;
+
+    // the notify scenarios always run one watcher and one writer
+
+    threads = notify ? 2 : threads;
+    workers = calloc(threads, sizeof(*workers));
+    histogram = calloc(1, sizeof(*histogram));
+
+    if (!run || !workers || !histogram) {
+        fprintf(stderr, "[bench] out of memory\n");
+        retval = -1;
+        goto BENCH_RUN_TARGET_EXIT;
+    }
+
+    run->target = target;
+    run->options = options;
+    run->payload_size = target->payload ? target->payload(run->payload, options->size) : 0;
+    pthread_barrier_init(&run->barrier, NULL, threads + 1);
+
+    for (unsigned i = 0; i < threads; ++i) {
+
+        void* (*entry)(void*) = bench_worker_main;
+
+        if (notify) {
+            entry = i ? bench_notify_writer : timer ? bench_notify_timer : bench_notify_waiter;
+        }
+
+        workers[i].run = run;
+        workers[i].index = i;
+
+        if ((retval = pthread_create(&workers[i].thread, NULL, entry, &workers[i]))) {
+            fprintf(stderr, "[bench] failed to create thread: %s\n", strerror(retval));
+            exit(EXIT_FAILURE);
+        }
+
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    start = bench_now();
+    sleep(options->duration);
+    atomic_store(&run->stop, true);
+
+    for (unsigned i = 0; i < threads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        bench_histogram_merge(histogram, &workers[i].histogram);
+        reads += workers[i].reads;
+        writes += workers[i].writes;
+        errors += workers[i].errors;
+        bytes += workers[i].bytes;
+    }
+
+    watcher_cpu_ns = workers[0].cpu_ns;
+    elapsed = bench_now() - start;
+    pthread_barrier_destroy(&run->barrier);
+
+    printf(
+        "{\"target\":\"%s\",\"read_mode\":\"%s\",\"threads\":%u,\"read_percent\":%u,\"size\":%zu,\"duration_ns\":%llu,"
+        "\"reads\":%llu,\"writes\":%llu,\"errors\":%llu,\"ops_per_sec\":%.1f,\"bytes_per_sec\":%.1f,"
+        "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu",
+        target->name,
+        options->sendfile && !notify ? "sendfile" : "pread",
+        notify ? 1 : threads,
+        (target->flags & BENCH_TARGET_WRITABLE) ? options->read_percent : 100,
+        notify ? run->payload_size : options->size,
+        (unsigned long long) elapsed,
+        (unsigned long long) reads,
+        (unsigned long long) writes,
+        (unsigned long long) errors,
+        (reads + writes) * 1e9 / elapsed,
+        bytes * 1e9 / elapsed,
+        (unsigned long long) bench_histogram_percentile(histogram, 50.0),
+        (unsigned long long) bench_histogram_percentile(histogram, 99.0),
+        (unsigned long long) bench_histogram_percentile(histogram, 99.9)
+    );
+
+    // the notify scenarios also report what watching cost: the cpu time of
+    // the watcher thread over the run and per change it saw
+
+    if (notify) {
+        printf(
+            ",\"interval_us\":%u,\"period_us\":%u,\"watcher_cpu_ns\":%llu,\"watcher_cpu_percent\":%.2f,\"watcher_cpu_ns_per_change\":%.1f",
+            timer ? options->interval_us : 0,
+            options->period_us,
+            (unsigned long long) watcher_cpu_ns,
+            watcher_cpu_ns * 100.0 / elapsed,
+            reads ? (double) watcher_cpu_ns / reads : 0.0
+        );
+    }
+
+    printf("}\n");
+    fflush(stdout);
+
+BENCH_RUN_TARGET_EXIT:
+
+    free(histogram);
+    free(workers);
+    free(run);
+    return retval;
+
+}
+
+size_t bench_payload_text(char* buffer, size_t size) {
+
+    for (size_t i = 0; i < size; ++i) {
+        buffer[i] = 'a' + i % 26;
+    }
+
+    return size;
+
+}
+
+size_t bench_payload_numbers(char* buffer, size_t size) {
+
+    size_t length = 0;
+
+    // whitespace-separated values in 0..255, as parsed by procfs-seqfile
+
+    for (unsigned i = 0; length + 4 <= size; ++i) {
+        length += snprintf(buffer + length, size - length, "%03u\n", i % 256);
+    }
+
+    return length;
+
+}
+
+size_t bench_payload_int(char* buffer, size_t size) {
+    return snprintf(buffer, BENCH_MAX_SIZE, "%zu\n", size);
+}
+
+size_t bench_payload_filter(char* buffer, size_t size) {
+    return snprintf(buffer, BENCH_MAX_SIZE, "bus=0-255\n");
+}
+
+int bench_parse_options(struct bench_options* options, int argc, char** argv) {
+
+    int option = 0;
+    char* token = NULL;
+    char* iterator = NULL;
+    bool targets = false;
+
+    options->duration = BENCH_DEFAULT_DURATION;
+    options->read_percent = BENCH_DEFAULT_READ_PERCENT;
+    options->size = BENCH_DEFAULT_SIZE;
+    options->interval_us = BENCH_DEFAULT_INTERVAL_US;
+
+    while ((option = getopt(argc, argv, "T:t:d:m:s:i:p:Slh")) != -1) {
+
+        switch (option) {
+
+        case 'T':
+
+            targets = true;
+
+            for (iterator = optarg; (token = strsep(&iterator, ","));) {
+
+                size_t i = 0;
+
+                for (i = 0; i < BENCH_TARGET_COUNT && strcmp(token, bench_targets[i].name); ++i) {
+                }
+
+                if (i == BENCH_TARGET_COUNT) {
+                    fprintf(stderr, "[bench] unknown target: %s\n", token);
+                    return -1;
+                }
+
+                options->selected[i] = true;
+
+            }
+
+            break;
+
+        case 't':
+
+            for (iterator = optarg; (token = strsep(&iterator, ","));) {
+
+                unsigned long threads = strtoul(token, NULL, 0);
+
+                if (!threads || threads > BENCH_MAX_THREADS || options->thread_counts == BENCH_MAX_THREADS) {
+                    fprintf(stderr, "[bench] invalid thread count: %s\n", token);
+                    return -1;
+                }
+
+                options->threads[options->thread_counts++] = threads;
+
+            }
+
+            break;
+
+        case 'd':
+            options->duration = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'm':
+            options->read_percent = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            options->size = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'i':
+            options->interval_us = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'p':
+            options->period_us = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'S':
+            options->sendfile = true;
+            break;
+
+        case 'l':
+
+            for (size_t i = 0; i < BENCH_TARGET_COUNT; ++i) {
+                printf("%-24s %s\n", bench_targets[i].name, bench_targets[i].path);
+            }
+
+            return 1;
+
+        case 'h':
+            bench_usage(stdout, argv[0]);
+            return 1;
+
+        default:
+            bench_usage(stderr, argv[0]);
+            return -1;
+
+        }
+
+    }
+
+    if (!options->duration || options->read_percent > 100 || !options->size || options->size > BENCH_MAX_SIZE) {
+        fprintf(stderr, "[bench] invalid duration, read percentage or request size\n");
+        return -1;
+    }
+
+    if (!options->interval_us) {
+        fprintf(stderr, "[bench] invalid watcher interval\n");
+        return -1;
+    }
+
+    if (!options->thread_counts) {
+        options->threads[options->thread_counts++] = 1;
+    }
+
+    for (size_t i = 0; !targets && i < BENCH_TARGET_COUNT; ++i) {
+        options->selected[i] = true;
+    }
+
+    return 0;
+
+}
+
+void bench_usage(FILE* stream, const char* program) {
+
+    fprintf(
+        stream,
+        "usage: %s [-T target,...] [-t threads,...] [-d seconds] [-m read-percent] [-s bytes] [-i us] [-p us] [-S] [-l]\n"
+        "\n"
+        "  -T  targets to run (default: all, see -l)\n"
+        "  -t  thread counts, one run per count (default: 1)\n"
+        "  -d  duration of each run in seconds (default: %d)\n"
+        "  -m  percentage of reads on writable targets (default: %d)\n"
+        "  -s  request size in bytes (default: %d)\n"
+        "  -i  interval of the sysfs-notify-timer watcher in microseconds (default: %d)\n"
+        "  -p  mean pause between stores of the sysfs-notify scenarios in microseconds (default: 0)\n"
+        "  -S  read with sendfile() into a memfd instead of pread()\n"
+        "  -l  list targets\n",
+        program,
+        BENCH_DEFAULT_DURATION,
+        BENCH_DEFAULT_READ_PERCENT,
+        BENCH_DEFAULT_SIZE,
+        BENCH_DEFAULT_INTERVAL_US
+    );
+
+}
@@ -0,0 +1,167 @@
+#ifndef LKMPG_BUFFER_H
+#define LKMPG_BUFFER_H
+
+// offset arithmetic and storage shared by the procfs files that keep their
+// contents in a bounded buffer
+//
+// the span helpers only work out how many bytes an operation moves, so that
+// they can be called (and tested) without a file, a user buffer or a lock;
+// lkmpg_buffer_copy_to_iter() does the copy for the proc_read_iter paths
+//
+// struct lkmpg_buffer is storage that is allocated on the first write and
+// can be shrunk back to its contents (or freed when empty) once it has been
+// idle for a while; the caller serializes every helper that takes one
+
+#include <linux/errno.h>
+#include <linux/jiffies.h>
+#include <linux/minmax.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/types.h>
+#include <linux/uio.h>
+
+// buffers untouched for this long may be compacted by lkmpg_buffer_compact()
+
+#define LKMPG_BUFFER_IDLE_MS 1000
+
+struct lkmpg_buffer {
+    char* data;
+    size_t size;
+    size_t capacity;
+    unsigned long used;
+};
+
+// number of bytes to read at offset from a buffer holding size bytes, zero at
+// or past the end, or -EINVAL for a negative offset
+
+static inline ssize_t lkmpg_buffer_read_span(loff_t offset, size_t size, size_t length) {
+
+    if (offset < 0) {
+        return -EINVAL;
+    }
+
+    if ((size_t) offset >= size) {
+        return 0;
+    }
+
+    return min(length, size - (size_t) offset);
+
+}
+
+// number of bytes to write at offset into a buffer of capacity bytes, or
+// -ENOSPC when nothing fits; a short count means the write was truncated
+
+static inline ssize_t lkmpg_buffer_write_span(loff_t offset, size_t capacity, size_t length) {
+
+    if (offset < 0) {
+        return -EINVAL;
+    }
+
+    if ((size_t) offset >= capacity || !length) {
+        return -ENOSPC;
+    }
+
+    return min(length, capacity - (size_t) offset);
+
+}
+
+// copies what lkmpg_buffer_read_span() allows from a buffer holding size
+// bytes to the iterator and advances offset past it; the copy stops early if
+// the iterator faults, and only a copy that moves nothing fails
+
+static inline ssize_t lkmpg_buffer_copy_to_iter(const char* buffer, size_t size, loff_t* offset, struct iov_iter* to) {
+
+    size_t copied = 0;
+    ssize_t bytes = lkmpg_buffer_read_span(*offset, size, iov_iter_count(to));
+
+    if (bytes <= 0) {
+        return bytes;
+    }
+
+    if (!(copied = copy_to_iter(buffer + *offset, bytes, to))) {
+        return -EFAULT;
+    }
+
+    *offset += copied;
+
+    return copied;
+
+}
+
+// makes room for capacity bytes and a terminating nul; bytes that were not
+// allocated before are zeroed so that a write past the end of the contents
+// never exposes stale memory
+
+static inline int lkmpg_buffer_reserve(struct lkmpg_buffer* buffer, size_t capacity) {
+
+    char* data = NULL;
+
+    buffer->used = jiffies;
+
+    if (buffer->capacity >= capacity + 1) {
+        return 0;
+    }
+
+    if (!(data = krealloc(buffer->data, capacity + 1, GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+
+    memset(data + buffer->capacity, 0, capacity + 1 - buffer->capacity);
+    buffer->data = data;
+    buffer->capacity = capacity + 1;
+
+    return 0;
+
+}
+
+// bytes lkmpg_buffer_compact() would release: all of an empty buffer, and
+// the slack past the contents and their terminating nul otherwise
+
+static inline size_t lkmpg_buffer_reclaimable(const struct lkmpg_buffer* buffer) {
+
+    if (!buffer->data || time_before(jiffies, buffer->used + msecs_to_jiffies(LKMPG_BUFFER_IDLE_MS))) {
+        return 0;
+    }
+
+    return buffer->size ? buffer->capacity - (buffer->size + 1) : buffer->capacity;
+
+}
+
+// releases what lkmpg_buffer_reclaimable() reports and returns its size; the
+// contents are copied to a new allocation because krealloc() keeps the old
+// one when shrinking, and a failed copy leaves the buffer as it was
+
+static inline size_t lkmpg_buffer_compact(struct lkmpg_buffer* buffer) {
+
+    char* data = NULL;
+    size_t released = lkmpg_buffer_reclaimable(buffer);
+
+    if (!released) {
+        return 0;
+    }
+
+    if (!buffer->size) {
+        kfree(buffer->data);
+        buffer->data = NULL;
+        buffer->capacity = 0;
+        return released;
+    }
+
+    if (!(data = kmemdup(buffer->data, buffer->size + 1, GFP_NOWAIT | __GFP_NOWARN))) {
+        return 0;
+    }
+
+    kfree(buffer->data);
+    buffer->data = data;
+    buffer->capacity = buffer->size + 1;
+
+    return released;
+
+}
+
+static inline void lkmpg_buffer_free(struct lkmpg_buffer* buffer) {
+    kfree(buffer->data);
+    *buffer = (struct lkmpg_buffer) {};
+}
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef LKMPG_GENL_H
+#define LKMPG_GENL_H
+
+// generic netlink access to module state, so that one socket can read and
+// write every value of every module instead of opening each file
+//
+// each module registers a family named after it (procfs-buffer,
+// procfs-inode, procfs-seqfile, sysfs-attrs); all families share the
+// commands and attributes below, and a module rejects the attributes it does
+// not have with -EOPNOTSUPP:
+//
+// - GET replies with every scalar of the module and the SIZE of its array;
+//   with NLM_F_DUMP the array is returned instead as a series of chunks of
+//   at most LKMPG_GENL_CHUNK_SIZE bytes, each with the OFFSET it starts at
+// - SET applies every attribute of the message after validating all of
+//   them, so a message either changes everything it names or nothing; array
+//   data is written at OFFSET (0 when absent) and needs CAP_NET_ADMIN
+// - EVENT is multicast to the "events" group after every change, whether it
+//   came from netlink or from the files, with the new scalar values or the
+//   OFFSET and LENGTH of the changed part of an array (and its data, up to
+//   LKMPG_GENL_CHUNK_SIZE bytes)
+//
+// offsets and lengths count bytes for buffers and elements for arrays, and
+// all array data is in native byte order; the s64 values inside TUNABLES are
+// aligned with padding attributes of type 0, which SET ignores
+//
+// genl ctrl get name procfs-buffer
+//
+// the commands are implemented once below; a module describes its family
+// with a struct lkmpg_genl and supplies only the callbacks in its
+// struct lkmpg_genl_ops
+
+#include <linux/errno.h>
+#include <linux/bits.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/netlink.h>
+#include <linux/version.h>
+#include <net/genetlink.h>
+#include <net/net_namespace.h>
+#include <net/netlink.h>
+
+#define LKMPG_GENL_VERSION 1
+#define LKMPG_GENL_MCGRP_EVENTS "events"
+
+// largest array chunk in a dump message or an event
+
+#define LKMPG_GENL_CHUNK_SIZE 1024
+
+enum lkmpg_genl_cmd {
+    LKMPG_GENL_CMD_UNSPEC,
+    LKMPG_GENL_CMD_GET,
+    LKMPG_GENL_CMD_SET,
+    LKMPG_GENL_CMD_EVENT,
+    __LKMPG_GENL_CMD_MAX,
+};
+
+enum lkmpg_genl_attr {
+    LKMPG_GENL_ATTR_UNSPEC,
+    LKMPG_GENL_ATTR_OFFSET,     // u32, first byte or element of DATA or a vector
+    LKMPG_GENL_ATTR_LENGTH,     // u32, bytes or elements changed (EVENT)
+    LKMPG_GENL_ATTR_SIZE,       // u32, bytes or elements in the whole array
+    LKMPG_GENL_ATTR_DATA,       // binary, buffer or array contents
+    LKMPG_GENL_ATTR_BOOL,       // u8
+    LKMPG_GENL_ATTR_INT,        // s32
+    LKMPG_GENL_ATTR_STRING,     // null-terminated string
+    LKMPG_GENL_ATTR_U32_VECTOR, // binary, u32 elements
+    LKMPG_GENL_ATTR_S64_VECTOR, // binary, s64 elements
+    LKMPG_GENL_ATTR_TUNABLES,   // nested, tunable i as s64 in attribute i + 1
+    __LKMPG_GENL_ATTR_MAX,
+};
+
+#define LKMPG_GENL_ATTR_MAX (__LKMPG_GENL_ATTR_MAX - 1)
+
+static const struct nla_policy lkmpg_genl_policy[LKMPG_GENL_ATTR_MAX + 1] = {
+    [LKMPG_GENL_ATTR_OFFSET] = {.type = NLA_U32},
+    [LKMPG_GENL_ATTR_LENGTH] = {.type = NLA_U32},
+    [LKMPG_GENL_ATTR_SIZE] = {.type = NLA_U32},
+    [LKMPG_GENL_ATTR_DATA] = {.type = NLA_BINARY},
+    [LKMPG_GENL_ATTR_BOOL] = {.type = NLA_U8},
+    [LKMPG_GENL_ATTR_INT] = {.type = NLA_S32},
+    [LKMPG_GENL_ATTR_STRING] = {.type = NLA_NUL_STRING},
+    [LKMPG_GENL_ATTR_U32_VECTOR] = {.type = NLA_BINARY},
+    [LKMPG_GENL_ATTR_S64_VECTOR] = {.type = NLA_BINARY},
+    [LKMPG_GENL_ATTR_TUNABLES] = {.type = NLA_NESTED},
+};
+
+static const struct genl_multicast_group lkmpg_genl_mcgrps[] = {
+    {.name = LKMPG_GENL_MCGRP_EVENTS},
+};
+
+// fails with -EOPNOTSUPP when the message has an attribute outside of
+// supported, a mask of BIT(LKMPG_GENL_ATTR_*)
+
+static inline int lkmpg_genl_supported(const struct genl_info* info, unsigned long supported) {
+
+    for (int attr = LKMPG_GENL_ATTR_UNSPEC + 1; attr <= LKMPG_GENL_ATTR_MAX; ++attr) {
+        if (info->attrs[attr] && !(supported & BIT(attr))) {
+            NL_SET_ERR_MSG_ATTR(info->extack, info->attrs[attr], "attribute not supported by this family");
+            return -EOPNOTSUPP;
+        }
+    }
+
+    return 0;
+
+}
+
+// starts a reply to info, or an event when info is null
+
+static inline struct sk_buff* lkmpg_genl_new(const struct genl_family* family, struct genl_info* info, void** header) {
+
+    struct sk_buff* skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+
+    if (!skb) {
+        return NULL;
+    }
+
+    if (info) {
+        *header = genlmsg_put_reply(skb, info, family, 0, LKMPG_GENL_CMD_GET);
+    } else {
+        *header = genlmsg_put(skb, 0, 0, family, 0, LKMPG_GENL_CMD_EVENT);
+    }
+
+    if (!*header) {
+        nlmsg_free(skb);
+        return NULL;
+    }
+
+    return skb;
+
+}
+
+// events are only built while someone listens; families are not netns
+// aware, so listeners are always in the initial namespace
+
+static inline bool lkmpg_genl_listening(const struct genl_family* family) {
+    return genl_has_listeners(family, &init_net, 0);
+}
+
+static inline void lkmpg_genl_multicast(const struct genl_family* family, struct sk_buff* skb, void* header) {
+    genlmsg_end(skb, header);
+    genlmsg_multicast(family, skb, 0, 0, GFP_KERNEL);
+}
+
+// adds as many chunks of an array as fit in skb, one message each, resuming
+// from the element in cb->args[0]; fill() adds the attributes of the chunk
+// starting at offset and returns the number of elements it covered, 0 past
+// the end or -EMSGSIZE when skb is full
+
+typedef int (*lkmpg_genl_fill_fn)(struct sk_buff* skb, size_t offset);
+
+static inline int lkmpg_genl_dump_chunks(struct sk_buff* skb, struct netlink_callback* cb, const struct genl_family* family, lkmpg_genl_fill_fn fill) {
+
+    void* header = NULL;
+    int retval = 0;
+
+    for (;;) {
+
+        header = genlmsg_put(skb, NETLINK_CB(cb->skb).portid, cb->nlh->nlmsg_seq, family, NLM_F_MULTI, LKMPG_GENL_CMD_GET);
+
+        if (!header) {
+            retval = -EMSGSIZE;
+            break;
+        }
+
+        if (nla_put_u32(skb, LKMPG_GENL_ATTR_OFFSET, cb->args[0])) {
+            genlmsg_cancel(skb, header);
+            retval = -EMSGSIZE;
+            break;
+        }
+
+        if ((retval = fill(skb, cb->args[0])) <= 0) {
+            genlmsg_cancel(skb, header);
+            break;
+        }
+
+        genlmsg_end(skb, header);
+        cb->args[0] += retval;
+
+    }
+
+    // a full skb is sent and the dump resumes, anything else ends it once
+    // the messages already added have been sent
+
+    if (retval < 0 && (retval != -EMSGSIZE || !skb->len)) {
+        return retval;
+    }
+
+    return skb->len;
+
+}
+
+// the part of an array an event reports: length bytes or elements from
+// offset, of array for modules that have more than one
+
+struct lkmpg_genl_change {
+    const void* array;
+    size_t offset;
+    size_t length;
+};
+
+// callbacks of a family; each one takes the locks of the module itself
+//
+// - fill() adds every scalar and the SIZE of the array for a GET reply or an
+//   event about the scalars, when change is null, and otherwise the DATA or
+//   vector of the changed part, truncated to LKMPG_GENL_CHUNK_SIZE bytes
+// - set() applies a SET whose attributes are all in set_attrs, then reports
+//   what changed with lkmpg_genl_notify() like a write through the files
+// - dumpit(), when the array can be dumped, is a one-line call to
+//   lkmpg_genl_dump_chunks() with the family and the fill of one chunk
+
+struct lkmpg_genl_ops {
+    unsigned long set_attrs;
+    int (*fill)(struct sk_buff* skb, const struct lkmpg_genl_change* change);
+    int (*set)(struct genl_info* info);
+    int (*dumpit)(struct sk_buff* skb, struct netlink_callback* cb);
+};
+
+// a module only sets family.name and ops, the rest is filled in by
+// lkmpg_genl_register()
+
+struct lkmpg_genl {
+    struct genl_family family;
+    const struct lkmpg_genl_ops* ops;
+    struct genl_ops commands[2];
+};
+
+static inline struct lkmpg_genl* lkmpg_genl_of(const struct genl_info* info) {
+    return container_of(info->family, struct lkmpg_genl, family);
+}
+
+static inline int lkmpg_genl_get(struct sk_buff* skb, struct genl_info* info) {
+
+    int retval = 0;
+    void* header = NULL;
+    struct sk_buff* reply = NULL;
+    const struct lkmpg_genl* genl = lkmpg_genl_of(info);
+
+    if ((retval = lkmpg_genl_supported(info, 0))) {
+        return retval;
+    }
+
+    if (!(reply = lkmpg_genl_new(&genl->family, info, &header))) {
+        return -ENOMEM;
+    }
+
+    if ((retval = genl->ops->fill(reply, NULL))) {
+        nlmsg_free(reply);
+        return retval;
+    }
+
+    genlmsg_end(reply, header);
+    return genlmsg_reply(reply, info);
+
+}
+
+static inline int lkmpg_genl_set(struct sk_buff* skb, struct genl_info* info) {
+
+    int retval = 0;
+    const struct lkmpg_genl* genl = lkmpg_genl_of(info);
+
+    if ((retval = lkmpg_genl_supported(info, genl->ops->set_attrs))) {
+        return retval;
+    }
+
+    return genl->ops->set(info);
+
+}
+
+// the DATA of a SET and the OFFSET it is written at (0 when absent), after
+// checking that all of it fits in an array of size bytes; data that does not
+// fit fails instead of being truncated like a write through the files
+
+static inline const struct nlattr* lkmpg_genl_data(struct genl_info* info, size_t size, u32* offset) {
+
+    const struct nlattr* data = info->attrs[LKMPG_GENL_ATTR_DATA];
+
+    if (!data) {
+        NL_SET_ERR_MSG(info->extack, "missing data");
+        return ERR_PTR(-EINVAL);
+    }
+
+    *offset = info->attrs[LKMPG_GENL_ATTR_OFFSET] ? nla_get_u32(info->attrs[LKMPG_GENL_ATTR_OFFSET]) : 0;
+
+    if (!nla_len(data) || *offset >= size || (size_t) nla_len(data) > size - *offset) {
+        NL_SET_ERR_MSG_ATTR(info->extack, data, "data does not fit in the array");
+        return ERR_PTR(-ENOSPC);
+    }
+
+    return data;
+
+}
+
+// sends an event about the scalars when change is null, otherwise about the
+// part of an array in change; events are best effort, a failure only means
+// listeners miss this one
+
+static inline void lkmpg_genl_notify(const struct lkmpg_genl* genl, const struct lkmpg_genl_change* change) {
+
+    void* header = NULL;
+    struct sk_buff* skb = NULL;
+
+    if (!lkmpg_genl_listening(&genl->family)) {
+        return;
+    }
+
+    if (!(skb = lkmpg_genl_new(&genl->family, NULL, &header))) {
+        return;
+    }
+
+    if (change && (nla_put_u32(skb, LKMPG_GENL_ATTR_OFFSET, change->offset) || nla_put_u32(skb, LKMPG_GENL_ATTR_LENGTH, change->length))) {
+        nlmsg_free(skb);
+        return;
+    }
+
+    if (genl->ops->fill(skb, change)) {
+        nlmsg_free(skb);
+        return;
+    }
+
+    lkmpg_genl_multicast(&genl->family, skb, header);
+
+}
+
+// registration completes the family; a module registers it once its data and
+// files exist, and unregisters it on exit only after removing every file or
+// attribute that can change the data:
+//
+// - removing a proc file or sysfs attribute waits for the operations still
+//   running on it, and those may send events on the family
+// - lkmpg_genl_unregister() then waits for the netlink commands still
+//   running, which notify like the files (and may use their kobjects)
+// - only then can the data, and the kobjects events go through, be freed
+//
+// unregistering first would let an event go out on a family that is gone,
+// whose multicast group may already belong to another family
+
+static inline int lkmpg_genl_register(struct lkmpg_genl* genl) {
+
+    genl->commands[0] = (struct genl_ops) {
+        .cmd = LKMPG_GENL_CMD_GET,
+        .doit = lkmpg_genl_get,
+        .dumpit = genl->ops->dumpit,
+    };
+
+    genl->commands[1] = (struct genl_ops) {
+        .cmd = LKMPG_GENL_CMD_SET,
+        .doit = lkmpg_genl_set,
+        .flags = GENL_ADMIN_PERM,
+    };
+
+    genl->family.version = LKMPG_GENL_VERSION;
+    genl->family.maxattr = LKMPG_GENL_ATTR_MAX;
+    genl->family.policy = lkmpg_genl_policy;
+    genl->family.module = THIS_MODULE;
+    genl->family.ops = genl->commands;
+    genl->family.n_ops = ARRAY_SIZE(genl->commands);
+    genl->family.mcgrps = lkmpg_genl_mcgrps;
+    genl->family.n_mcgrps = ARRAY_SIZE(lkmpg_genl_mcgrps);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+    genl->family.resv_start_op = LKMPG_GENL_CMD_GET;
+#endif
+
+    return genl_register_family(&genl->family);
+
+}
+
+static inline void lkmpg_genl_unregister(struct lkmpg_genl* genl) {
+    genl_unregister_family(&genl->family);
+}
+
+#endif
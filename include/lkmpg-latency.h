@@ -0,0 +1,335 @@
+#ifndef LKMPG_LATENCY_H
+#define LKMPG_LATENCY_H
+
+// per-operation latency histograms shared by the modules in this repository
+//
+// each operation keeps two per-cpu log2 histograms in nanoseconds: the time
+// spent waiting for the lock that serializes the operation, and the time
+// spent in the operation once the lock is held (or the whole operation when
+// it takes no lock); the histograms are exposed in debugfs as
+//
+// /sys/kernel/debug/lkmpg/<module>/<operation>
+// /sys/kernel/debug/lkmpg/<module>/reset
+//
+// and writing anything to reset clears every histogram of the module
+//
+// the histograms are only built with LATENCY=1, which defines LKMPG_LATENCY;
+// otherwise every function below is an empty inline and the timers are empty
+// structs, so instrumented code compiles to what it was before
+//
+// usage in an operation:
+//
+// struct lkmpg_latency_timer timer;
+//
+// lkmpg_latency_start(&timer);
+// mutex_lock(&mutex);
+// lkmpg_latency_locked(&timer);
+// ...
+// mutex_unlock(&mutex);
+// lkmpg_latency_stop(&latency[OPERATION], &timer);
+
+#include <linux/types.h>
+
+#define LKMPG_LATENCY_DIR_NAME "lkmpg"
+#define LKMPG_LATENCY_RESET_NAME "reset"
+#define LKMPG_LATENCY_RESET_MODE 0200
+#define LKMPG_LATENCY_FILE_MODE 0444
+#define LKMPG_LATENCY_REGISTER_TRIES 3
+
+// bucket zero counts zero nanoseconds and bucket b counts [2^(b-1), 2^b)
+// nanoseconds; the last bucket also counts everything above it (~1 s)
+
+#define LKMPG_LATENCY_BUCKETS 32
+
+struct lkmpg_latency_histogram {
+    u64 buckets[LKMPG_LATENCY_BUCKETS];
+};
+
+struct lkmpg_latency_cpu {
+    struct lkmpg_latency_histogram wait;
+    struct lkmpg_latency_histogram service;
+};
+
+#define LKMPG_LATENCY_OP(op_name) { .name = (op_name) }
+
+#ifdef LKMPG_LATENCY
+
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/dcache.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/minmax.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+struct lkmpg_latency {
+    const char* name;
+    struct lkmpg_latency_cpu __percpu* cpu;
+};
+
+struct lkmpg_latency_timer {
+    u64 start;
+    u64 locked;
+};
+
+// debugfs directory of one module and the operations shown in it
+
+struct lkmpg_latency_set {
+    struct dentry* dir;
+    struct lkmpg_latency* ops;
+    size_t count;
+};
+
+static inline unsigned int lkmpg_latency_bucket(u64 ns) {
+    return min_t(unsigned int, fls64(ns), LKMPG_LATENCY_BUCKETS - 1);
+}
+
+static inline void lkmpg_latency_start(struct lkmpg_latency_timer* timer) {
+    timer->start = ktime_get_ns();
+    timer->locked = 0;
+}
+
+static inline void lkmpg_latency_locked(struct lkmpg_latency_timer* timer) {
+    timer->locked = ktime_get_ns();
+}
+
+static inline void lkmpg_latency_stop(struct lkmpg_latency* op, struct lkmpg_latency_timer* timer) {
+
+    u64 now = ktime_get_ns();
+
+    if (!op->cpu) {
+        return;
+    }
+
+    // an operation that never took its lock has no wait sample
+
+    if (timer->locked) {
+        this_cpu_inc(op->cpu->wait.buckets[lkmpg_latency_bucket(timer->locked - timer->start)]);
+        this_cpu_inc(op->cpu->service.buckets[lkmpg_latency_bucket(now - timer->locked)]);
+    } else {
+        this_cpu_inc(op->cpu->service.buckets[lkmpg_latency_bucket(now - timer->start)]);
+    }
+
+}
+
+static inline void lkmpg_latency_show_histogram(struct seq_file* seq, struct lkmpg_latency* op, bool wait) {
+
+    int cpu = 0;
+    const char* kind = wait ? "wait" : "service";
+    u64 buckets[LKMPG_LATENCY_BUCKETS] = {};
+
+    for_each_possible_cpu(cpu) {
+
+        const struct lkmpg_latency_cpu* counts = per_cpu_ptr(op->cpu, cpu);
+        const struct lkmpg_latency_histogram* histogram = wait ? &counts->wait : &counts->service;
+
+        for (int i = 0; i < LKMPG_LATENCY_BUCKETS; ++i) {
+            buckets[i] += READ_ONCE(histogram->buckets[i]);
+        }
+
+    }
+
+    // one line per non-empty bucket: kind, lower bound, upper bound, count
+
+    for (int i = 0; i < LKMPG_LATENCY_BUCKETS; ++i) {
+        if (buckets[i]) {
+            seq_printf(seq, "%s %llu %llu %llu\n", kind, i ? 1ULL << (i - 1) : 0ULL, 1ULL << i, buckets[i]);
+        }
+    }
+
+}
+
+static inline int lkmpg_latency_show(struct seq_file* seq, void* unused) {
+
+    struct lkmpg_latency* op = seq->private;
+
+    lkmpg_latency_show_histogram(seq, op, true);
+    lkmpg_latency_show_histogram(seq, op, false);
+
+    return 0;
+
+}
+
+static inline int lkmpg_latency_open(struct inode* inode, struct file* file) {
+    return single_open(file, lkmpg_latency_show, inode->i_private);
+}
+
+static inline ssize_t lkmpg_latency_reset_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
+
+    int cpu = 0;
+    struct lkmpg_latency_set* set = file->private_data;
+
+    // increments racing with the reset may survive it, which is harmless
+
+    for (size_t i = 0; i < set->count; ++i) {
+        for_each_possible_cpu(cpu) {
+            memset(per_cpu_ptr(set->ops[i].cpu, cpu), 0, sizeof(struct lkmpg_latency_cpu));
+        }
+    }
+
+    return length;
+
+}
+
+static const struct file_operations lkmpg_latency_fops = {
+    .owner = THIS_MODULE,
+    .open = lkmpg_latency_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static const struct file_operations lkmpg_latency_reset_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = lkmpg_latency_reset_write,
+    .llseek = noop_llseek,
+};
+
+// serialises the lookup, creation and removal of the shared lkmpg directory
+// by lkmpg_latency_register() and lkmpg_latency_unregister(); every module
+// that includes this header has its own copy, so registration also retries
+// when another module creates or removes lkmpg at the same time
+
+static DEFINE_MUTEX(lkmpg_latency_dir_lock);
+
+// creates lkmpg/<name> in debugfs with one file per operation; lkmpg is
+// shared by every module, so it is looked up first and only created by the
+// first module to register
+
+static inline int lkmpg_latency_register(struct lkmpg_latency_set* set, const char* name, struct lkmpg_latency* ops, size_t count) {
+
+    struct dentry* parent = NULL;
+
+    set->ops = ops;
+    set->count = count;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!(ops[i].cpu = alloc_percpu(struct lkmpg_latency_cpu))) {
+            goto LKMPG_LATENCY_REGISTER_EXIT_FREE;
+        }
+    }
+
+    mutex_lock(&lkmpg_latency_dir_lock);
+
+    // creating lkmpg fails when another module created it after the lookup,
+    // and creating <name> fails when another module removed lkmpg after it,
+    // so both start over from the lookup
+
+    for (int i = 0; i < LKMPG_LATENCY_REGISTER_TRIES; ++i) {
+
+        if (!(parent = debugfs_lookup(LKMPG_LATENCY_DIR_NAME, NULL))) {
+
+            parent = debugfs_create_dir(LKMPG_LATENCY_DIR_NAME, NULL);
+
+            if (IS_ERR(parent)) {
+                set->dir = parent;
+                continue;
+            }
+
+            dget(parent);
+
+        }
+
+        set->dir = debugfs_create_dir(name, parent);
+        dput(parent);
+
+        if (!IS_ERR(set->dir)) {
+            break;
+        }
+
+    }
+
+    mutex_unlock(&lkmpg_latency_dir_lock);
+
+    if (IS_ERR(set->dir)) {
+        goto LKMPG_LATENCY_REGISTER_EXIT_FREE;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        debugfs_create_file(ops[i].name, LKMPG_LATENCY_FILE_MODE, set->dir, &ops[i], &lkmpg_latency_fops);
+    }
+
+    debugfs_create_file(LKMPG_LATENCY_RESET_NAME, LKMPG_LATENCY_RESET_MODE, set->dir, set, &lkmpg_latency_reset_fops);
+
+    return 0;
+
+LKMPG_LATENCY_REGISTER_EXIT_FREE:
+
+    for (size_t i = 0; i < count; ++i) {
+        free_percpu(ops[i].cpu);
+        ops[i].cpu = NULL;
+    }
+
+    set->dir = NULL;
+    return -ENOMEM;
+
+}
+
+static inline void lkmpg_latency_unregister(struct lkmpg_latency_set* set) {
+
+    struct dentry* parent = NULL;
+
+    if (!set->dir) {
+        return;
+    }
+
+    mutex_lock(&lkmpg_latency_dir_lock);
+
+    parent = dget_parent(set->dir);
+    debugfs_remove_recursive(set->dir);
+    set->dir = NULL;
+
+    // the last module to leave removes the shared directory
+
+    if (simple_empty(parent)) {
+        debugfs_remove(parent);
+    }
+
+    dput(parent);
+
+    mutex_unlock(&lkmpg_latency_dir_lock);
+
+    for (size_t i = 0; i < set->count; ++i) {
+        free_percpu(set->ops[i].cpu);
+        set->ops[i].cpu = NULL;
+    }
+
+}
+
+#else
+
+struct lkmpg_latency {
+    const char* name;
+};
+
+struct lkmpg_latency_timer {
+};
+
+struct lkmpg_latency_set {
+};
+
+static inline void lkmpg_latency_start(struct lkmpg_latency_timer* timer) {
+}
+
+static inline void lkmpg_latency_locked(struct lkmpg_latency_timer* timer) {
+}
+
+static inline void lkmpg_latency_stop(struct lkmpg_latency* op, struct lkmpg_latency_timer* timer) {
+}
+
+static inline int lkmpg_latency_register(struct lkmpg_latency_set* set, const char* name, struct lkmpg_latency* ops, size_t count) {
+    return 0;
+}
+
+static inline void lkmpg_latency_unregister(struct lkmpg_latency_set* set) {
+}
+
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LKMPG_PARSE_H
+#define LKMPG_PARSE_H
+
+// parsers for the delimited lists of numbers written to the procfs and sysfs
+// files in this repository
+//
+// every parser works on a nul-terminated kernel copy of the input, which it
+// splits in place with strsep(), and only writes to the values array it is
+// given, so it can be called (and tested) without a file or any locking
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+// parses up to length integers into values, each clamped to 0..255; every
+// token consumes a slot, so an empty token between two delimiters leaves its
+// slot unchanged, and tokens past length are ignored
+//
+// on a parse error the offending token is returned through failed
+
+static inline int lkmpg_parse_u8_clamped(char* input, const char* delimiters, u8* values, size_t length, const char** failed) {
+
+    int error = 0;
+    int parsed = 0;
+    char* token = NULL;
+
+    for (size_t i = 0; i < length; ++i) {
+
+        if (!(token = strsep(&input, delimiters))) {
+            break;
+        }
+
+        if (token[0] == '\0') {
+            continue;
+        }
+
+        if ((error = kstrtoint(token, 0, &parsed))) {
+            *failed = token;
+            return error;
+        }
+
+        values[i] = clamp(parsed, 0, U8_MAX);
+
+    }
+
+    return 0;
+
+}
+
+// lkmpg_parse_<type>_vector() parses every non-empty token into values and
+// stores the number of values in parsed, or fails with -E2BIG when the input
+// holds more than length values
+
+#define LKMPG_PARSE_VECTOR(type, kstrto)                                                                                              \
+    static inline int lkmpg_parse_##type##_vector(char* input, const char* delimiters, type* values, size_t length, size_t* parsed) { \
+                                                                                                                                      \
+        int error = 0;                                                                                                                \
+        char* token = NULL;                                                                                                           \
+        size_t count = 0;                                                                                                             \
+                                                                                                                                      \
+        while ((token = strsep(&input, delimiters))) {                                                                                \
+                                                                                                                                      \
+            if (token[0] == '\0') {                                                                                                   \
+                continue;                                                                                                             \
+            }                                                                                                                         \
+                                                                                                                                      \
+            if (count == length) {                                                                                                    \
+                return -E2BIG;                                                                                                        \
+            }                                                                                                                         \
+                                                                                                                                      \
+            if ((error = kstrto(token, 0, &values[count]))) {                                                                         \
+                return error;                                                                                                         \
+            }                                                                                                                         \
+                                                                                                                                      \
+            ++count;                                                                                                                  \
+                                                                                                                                      \
+        }                                                                                                                             \
+                                                                                                                                      \
+        *parsed = count;                                                                                                              \
+                                                                                                                                      \
+        return 0;                                                                                                                     \
+                                                                                                                                      \
+    }
+
+LKMPG_PARSE_VECTOR(u32, kstrtou32)
+LKMPG_PARSE_VECTOR(s64, kstrtos64)
+
+#undef LKMPG_PARSE_VECTOR
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef LKMPG_SHRINKER_H
+#define LKMPG_SHRINKER_H
+
+// registration of a module shrinker across kernel versions
+//
+// count() reports how much the module could release and scan() releases it;
+// both are called under memory pressure from reclaim, so they must not sleep
+// on locks that may be held across allocations (use mutex_trylock() and
+// return SHRINK_STOP from scan() when the lock is busy)
+//
+// the modules in this repository count in bytes rather than objects: count()
+// returns the bytes scan() would free right now, which is nothing while the
+// lock is held or the memory was used in the last idle period, and scan()
+// returns the bytes it freed, or SHRINK_STOP when it freed nothing; each
+// module adds what scan() freed to its read-only reclaimed_bytes parameter
+//
+// registration may fail without failing the module, which then keeps its
+// memory until it is unloaded
+//
+// the shrinker is named after the module in /sys/kernel/debug/shrinker on
+// kernels with CONFIG_SHRINKER_DEBUG
+
+#include <linux/errno.h>
+#include <linux/shrinker.h>
+#include <linux/version.h>
+
+typedef unsigned long (*lkmpg_shrinker_fn)(struct shrinker*, struct shrink_control*);
+
+// shrinkers are allocated by the kernel since 6.7 and embedded before
+
+struct lkmpg_shrinker {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+    struct shrinker* shrinker;
+#else
+    struct shrinker shrinker;
+#endif
+};
+
+static inline int lkmpg_shrinker_register(struct lkmpg_shrinker* self, const char* name, lkmpg_shrinker_fn count, lkmpg_shrinker_fn scan) {
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+
+    if (!(self->shrinker = shrinker_alloc(0, "%s", name))) {
+        return -ENOMEM;
+    }
+
+    self->shrinker->count_objects = count;
+    self->shrinker->scan_objects = scan;
+    self->shrinker->seeks = DEFAULT_SEEKS;
+    shrinker_register(self->shrinker);
+
+    return 0;
+
+#else
+
+    self->shrinker.count_objects = count;
+    self->shrinker.scan_objects = scan;
+    self->shrinker.seeks = DEFAULT_SEEKS;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+    return register_shrinker(&self->shrinker, "%s", name);
+#else
+    return register_shrinker(&self->shrinker);
+#endif
+
+#endif
+
+}
+
+static inline void lkmpg_shrinker_unregister(struct lkmpg_shrinker* self) {
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+    shrinker_free(self->shrinker);
+    self->shrinker = NULL;
+#else
+    unregister_shrinker(&self->shrinker);
+#endif
+
+}
+
+#endif
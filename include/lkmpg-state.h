@@ -0,0 +1,208 @@
+#ifndef LKMPG_STATE_H
+#define LKMPG_STATE_H
+
+// versioned, checksummed dumps of module state for warm reloads
+//
+// a dump is a header followed by a payload whose layout is defined by each
+// module (all fields in native byte order, since a dump is only meant to be
+// restored on the machine that took it):
+//
+//     offset  size  field
+//          0     4  magic (per module)
+//          4     2  version (per module)
+//          6     2  header_size (16)
+//          8     4  length (payload bytes)
+//         12     4  crc32 of the payload
+//         16     -  payload
+//
+// a module creates its state file with lkmpg_state_create(), which takes the
+// whole dump in one sequential read (the dump is taken on open, so every
+// read of the same open file sees the same state) and restores one from a
+// single write of the whole dump:
+//
+// cat /proc/<module>-state > state
+// (reload the module)
+// dd if=state of=/proc/<module>-state bs=1M
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/proc_fs.h>
+#include <linux/slab.h>
+#include <linux/types.h>
+#include <linux/uio.h>
+
+#include "lkmpg-buffer.h"
+
+#define LKMPG_STATE_FILE_MODE 0600
+
+// dumps larger than this are rejected on restore before being copied in
+
+#define LKMPG_STATE_SIZE_MAX (16 << 20)
+
+struct lkmpg_state_header {
+    u32 magic;
+    u16 version;
+    u16 header_size;
+    u32 length;
+    u32 crc;
+};
+
+// size() bounds the payload of the next dump and is called without any lock
+// held; dump() fills at most size bytes and returns how many it wrote, and
+// restore() replaces the module state with a checked payload
+
+struct lkmpg_state_ops {
+    u32 magic;
+    u16 version;
+    size_t (*size)(void);
+    ssize_t (*dump)(void* payload, size_t size);
+    int (*restore)(const void* payload, size_t length);
+};
+
+struct lkmpg_state_dump {
+    size_t size;
+    struct lkmpg_state_header header;
+    u8 payload[];
+};
+
+static inline u32 lkmpg_state_crc(const void* payload, size_t length) {
+    return crc32_le(~0, payload, length) ^ ~0;
+}
+
+// fills in the header once length bytes of payload follow it
+
+static inline void lkmpg_state_seal(struct lkmpg_state_header* header, u32 magic, u16 version, size_t length) {
+
+    header->magic = magic;
+    header->version = version;
+    header->header_size = sizeof(*header);
+    header->length = length;
+    header->crc = lkmpg_state_crc(header + 1, length);
+
+}
+
+// returns the payload length of the dump in buffer, or -EINVAL when it is
+// not a dump of this format, -EPROTO for another version and -EBADMSG when
+// it is truncated or its checksum does not match
+
+static inline ssize_t lkmpg_state_check(const void* buffer, size_t size, u32 magic, u16 version) {
+
+    const struct lkmpg_state_header* header = buffer;
+
+    if (size < sizeof(*header) || header->magic != magic || header->header_size != sizeof(*header)) {
+        return -EINVAL;
+    }
+
+    if (header->version != version) {
+        return -EPROTO;
+    }
+
+    if (header->length != size - sizeof(*header) || header->crc != lkmpg_state_crc(header + 1, header->length)) {
+        return -EBADMSG;
+    }
+
+    return header->length;
+
+}
+
+static inline int lkmpg_state_proc_open(struct inode* inode, struct file* file) {
+
+    ssize_t length = 0;
+    size_t size = 0;
+    struct lkmpg_state_dump* dump = NULL;
+    const struct lkmpg_state_ops* ops = pde_data(inode);
+
+    if (!(file->f_mode & FMODE_READ)) {
+        return 0;
+    }
+
+    size = ops->size();
+
+    if (!(dump = kvmalloc(struct_size(dump, payload, size), GFP_KERNEL))) {
+        return -ENOMEM;
+    }
+
+    if ((length = ops->dump(dump->payload, size)) < 0) {
+        kvfree(dump);
+        return length;
+    }
+
+    lkmpg_state_seal(&dump->header, ops->magic, ops->version, length);
+    dump->size = sizeof(dump->header) + length;
+    file->private_data = dump;
+
+    return 0;
+
+}
+
+static inline ssize_t lkmpg_state_proc_read_iter(struct kiocb* iocb, struct iov_iter* to) {
+
+    struct lkmpg_state_dump* dump = iocb->ki_filp->private_data;
+
+    if (!dump) {
+        return -EBADF;
+    }
+
+    return lkmpg_buffer_copy_to_iter((const char*) &dump->header, dump->size, &iocb->ki_pos, to);
+
+}
+
+static inline ssize_t lkmpg_state_proc_write(struct file* file, const char __user* buffer, size_t length, loff_t* offset) {
+
+    int retval = 0;
+    void* kbuffer = NULL;
+    ssize_t payload_length = 0;
+    const struct lkmpg_state_ops* ops = pde_data(file_inode(file));
+
+    // a restore is a single write of the whole dump
+
+    if (*offset || length > LKMPG_STATE_SIZE_MAX) {
+        return -EINVAL;
+    }
+
+    kbuffer = kvmalloc(length, GFP_KERNEL);
+
+    if (!kbuffer) {
+        return -ENOMEM;
+    }
+
+    if (copy_from_user(kbuffer, buffer, length)) {
+        retval = -EFAULT;
+        goto LKMPG_STATE_PROC_WRITE_EXIT;
+    }
+
+    if ((payload_length = lkmpg_state_check(kbuffer, length, ops->magic, ops->version)) < 0) {
+        retval = payload_length;
+        goto LKMPG_STATE_PROC_WRITE_EXIT;
+    }
+
+    retval = ops->restore((const struct lkmpg_state_header*) kbuffer + 1, payload_length);
+
+LKMPG_STATE_PROC_WRITE_EXIT:
+
+    kvfree(kbuffer);
+    return retval ? retval : (ssize_t) length;
+
+}
+
+static inline int lkmpg_state_proc_release(struct inode* inode, struct file* file) {
+    kvfree(file->private_data);
+    return 0;
+}
+
+static const struct proc_ops lkmpg_state_proc_ops = {
+    .proc_open = lkmpg_state_proc_open,
+    .proc_read_iter = lkmpg_state_proc_read_iter,
+    .proc_write = lkmpg_state_proc_write,
+    .proc_lseek = default_llseek,
+    .proc_release = lkmpg_state_proc_release,
+};
+
+static inline struct proc_dir_entry* lkmpg_state_create(const char* name, const struct lkmpg_state_ops* ops) {
+    return proc_create_data(name, LKMPG_STATE_FILE_MODE, NULL, &lkmpg_state_proc_ops, (void*) ops);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#if !defined(LKMPG_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LKMPG_TRACE_H
+
+// tracepoint classes shared by the file operations of the modules
+//
+// every module keeps its own trace.h, with its own TRACE_SYSTEM, and
+// includes this header inside its multi-read section, where
+// trace/define_trace.h reads both several times; the module then defines
+// its events from the classes, so they keep the names and fields they had:
+//
+// DEFINE_EVENT(lkmpg_file, <module>_open,
+//     TP_PROTO(const struct file* file, int retval),
+//     TP_ARGS(file, retval)
+// );
+//
+// lkmpg_file is for open and release, lkmpg_io for read and write, where
+// offset is the file position before the call, and lkmpg_seek for lseek
+
+#include <linux/fs.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(lkmpg_file,
+
+    TP_PROTO(const struct file* file, int retval),
+
+    TP_ARGS(file, retval),
+
+    TP_STRUCT__entry(
+        __field(unsigned long, ino)
+        __field(int, retval)
+    ),
+
+    TP_fast_assign(
+        __entry->ino = file_inode(file)->i_ino;
+        __entry->retval = retval;
+    ),
+
+    TP_printk("ino=%lu retval=%d", __entry->ino, __entry->retval)
+
+);
+
+DECLARE_EVENT_CLASS(lkmpg_io,
+
+    TP_PROTO(const struct file* file, size_t length, loff_t offset, ssize_t retval),
+
+    TP_ARGS(file, length, offset, retval),
+
+    TP_STRUCT__entry(
+        __field(unsigned long, ino)
+        __field(size_t, length)
+        __field(loff_t, offset)
+        __field(ssize_t, retval)
+    ),
+
+    TP_fast_assign(
+        __entry->ino = file_inode(file)->i_ino;
+        __entry->length = length;
+        __entry->offset = offset;
+        __entry->retval = retval;
+    ),
+
+    TP_printk("ino=%lu length=%zu offset=%lld retval=%zd", __entry->ino, __entry->length, __entry->offset, __entry->retval)
+
+);
+
+DECLARE_EVENT_CLASS(lkmpg_seek,
+
+    TP_PROTO(const struct file* file, loff_t offset, int whence, loff_t retval),
+
+    TP_ARGS(file, offset, whence, retval),
+
+    TP_STRUCT__entry(
+        __field(unsigned long, ino)
+        __field(loff_t, offset)
+        __field(int, whence)
+        __field(loff_t, retval)
+    ),
+
+    TP_fast_assign(
+        __entry->ino = file_inode(file)->i_ino;
+        __entry->offset = offset;
+        __entry->whence = whence;
+        __entry->retval = retval;
+    ),
+
+    TP_printk("ino=%lu offset=%lld whence=%d retval=%lld", __entry->ino, __entry->offset, __entry->whence, __entry->retval)
+
+);
+
+#endif
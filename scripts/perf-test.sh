@@ -0,0 +1,149 @@
+#!/usr/bin/env bash
+
+# runs bench/bench against every module in a throwaway vm booted from the host
+# kernel with virtme-ng, so that results do not depend on what else is loaded
+# on the machine and modules can be loaded without touching the host
+#
+# make perf-test [PERF_RESULTS=file] [PERF_BASELINE=file] [PERF_DURATION=s]
+#
+# results are written as json lines (one per scenario, see bench/bench.c) to
+# PERF_RESULTS; when PERF_BASELINE exists the results are compared against it,
+# otherwise they become the baseline
+
+set -euo pipefail
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+
+PERF_RESULTS="${PERF_RESULTS:-$ROOT/perf-results.jsonl}"
+PERF_BASELINE="${PERF_BASELINE:-$ROOT/perf-baseline.jsonl}"
+PERF_DURATION="${PERF_DURATION:-3}"
+PERF_THREADS="${PERF_THREADS:-1,2,4,8}"
+PERF_CPUS="${PERF_CPUS:-8}"
+PERF_MEMORY="${PERF_MEMORY:-1G}"
+
+# 01 to 03 are all named hello, so they are loaded and removed one at a time
+# before the modules under test are loaded together
+
+SMOKE_MODULES=(
+    01-hello-world/hello.ko
+    02-hello-world/hello.ko
+    03-hello-world/hello.ko
+)
+
+MODULES=(
+    04-chardev/chardev.ko
+    05-procfs-static/procfs-static.ko
+    06-procfs-buffer/procfs-buffer.ko
+    07-procfs-inode/procfs-inode.ko
+    08-procfs-seqfile/procfs-seqfile.ko
+    09-sysfs-attrs/sysfs-attrs.ko
+    10-procfs-pcilist/procfs-pcilist.ko
+)
+
+# scenario: targets, read percentage, request size, extra bench options
+
+SCENARIOS=(
+    "chardev,procfs-static,procfs-pcilist-config,sysfs-snapshot 100 4096"
+    "procfs-buffer,procfs-inode,procfs-seqfile 100 128"
+    "procfs-buffer,procfs-inode,procfs-seqfile 50 128"
+    "procfs-buffer,procfs-inode 100 1024"
+    "procfs-pcilist,sysfs-attr-int,sysfs-attr-string 90 64"
+    "sysfs-notify 0 8"
+    "sysfs-notify,sysfs-notify-timer 0 8 -p 10000 -i 1000"
+    "procfs-static,procfs-buffer,procfs-inode 100 1024 -S"
+)
+
+perf_test_guest() {
+
+    local module=""
+    local scenario=""
+
+    if [[ "$EUID" -ne 0 ]]; then
+        echo "[perf-test] the guest side must run as root to load modules" >&2
+        exit 1
+    fi
+
+    for module in "${SMOKE_MODULES[@]}"; do
+        insmod "$ROOT/$module"
+        rmmod hello
+    done
+
+    for module in "${MODULES[@]}"; do
+        insmod "$ROOT/$module"
+    done
+
+    : > "$PERF_RESULTS"
+
+    for scenario in "${SCENARIOS[@]}"; do
+        read -r targets read_percent size options <<< "$scenario"
+        "$ROOT/bench/bench" -T "$targets" -t "$PERF_THREADS" -m "$read_percent" -s "$size" -d "$PERF_DURATION" ${options:-} | tee -a "$PERF_RESULTS"
+    done
+
+    for (( i = ${#MODULES[@]} - 1; i >= 0; --i )); do
+        rmmod "$(basename "${MODULES[i]}" .ko)"
+    done
+
+}
+
+# prints ops_per_sec and p99_ns of every result next to the baseline result
+# with the same target, read mode, threads, read percentage and size
+
+perf_test_compare() {
+
+    awk '
+        function field(line, name,    match_) {
+            if (match(line, "\"" name "\":\"?[^,\"}]*")) {
+                match_ = substr(line, RSTART, RLENGTH)
+                sub(/^"[^"]*":"?/, "", match_)
+                return match_
+            }
+            return ""
+        }
+        function key(line) {
+            return field(line, "target") " " field(line, "read_mode") " " field(line, "threads") " " field(line, "read_percent") " " field(line, "size")
+        }
+        FNR == NR {
+            ops[key($0)] = field($0, "ops_per_sec")
+            p99[key($0)] = field($0, "p99_ns")
+            next
+        }
+        FNR == 1 {
+            printf "%-48s %14s %14s %8s %12s %12s\n", "target mode threads read% size", "base ops/s", "ops/s", "delta", "base p99", "p99"
+        }
+        {
+            k = key($0)
+            now = field($0, "ops_per_sec")
+            if (k in ops && ops[k] > 0) {
+                printf "%-48s %14.0f %14.0f %+7.1f%% %12s %12s\n", k, ops[k], now, (now - ops[k]) * 100 / ops[k], p99[k], field($0, "p99_ns")
+            } else {
+                printf "%-48s %14s %14.0f %8s %12s %12s\n", k, "-", now, "-", "-", field($0, "p99_ns")
+            }
+        }
+    ' "$PERF_BASELINE" "$PERF_RESULTS"
+
+}
+
+if [[ "${1:-}" == "--guest" ]]; then
+    perf_test_guest
+    exit 0
+fi
+
+if ! command -v vng > /dev/null; then
+    echo "[perf-test] vng (virtme-ng) is required to boot the test vm" >&2
+    exit 1
+fi
+
+# the vm runs the host kernel with the repository mounted writable and no
+# network device, and exports the settings above to the guest side; vng runs
+# the guest command as the invoking user unless told otherwise, and the guest
+# side needs root for insmod and rmmod
+
+vng --run --user root --cpus "$PERF_CPUS" --memory "$PERF_MEMORY" --rwdir "$ROOT" --rwdir "$(dirname "$PERF_RESULTS")" \
+    --exec "PERF_RESULTS='$PERF_RESULTS' PERF_DURATION='$PERF_DURATION' PERF_THREADS='$PERF_THREADS' '$ROOT/scripts/perf-test.sh' --guest"
+
+if [[ -f "$PERF_BASELINE" ]]; then
+    perf_test_compare
+else
+    cp "$PERF_RESULTS" "$PERF_BASELINE"
+    echo "[perf-test] saved baseline to $PERF_BASELINE"
+fi
@@ -0,0 +1,555 @@
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/errno.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include "lkmpg-buffer.h"
+#include "lkmpg-parse.h"
+
+// kunit tests for the helpers in include/, which the modules share and which
+// work without a file, a user buffer or a lock, so they run as they are
+//
+// ./tools/testing/kunit/kunit.py run --kunitconfig=<path to this directory>
+//
+// the lkmpg_bench suite times the same helpers and reports ns per operation
+// through kunit_info(); its numbers come from a uml or qemu guest and are
+// only comparable with each other
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Emily Portin <portin.emily@protonmail.com>");
+MODULE_DESCRIPTION("lkmpg-kunit");
+MODULE_VERSION("0.1");
+
+#define LKMPG_KUNIT_BENCH_ITERATIONS 100000
+
+// the delimiters the modules pass to the parsers: 08-procfs-seqfile for
+// lkmpg_parse_u8_clamped(), 09-sysfs-attrs for the vectors
+
+#define LKMPG_KUNIT_SEQFILE_DELIMITERS " ,\n"
+#define LKMPG_KUNIT_VECTOR_DELIMITERS " ,\t\n"
+
+static void lkmpg_test_parse_u8_clamped(struct kunit*);
+static void lkmpg_test_parse_u8_clamped_empty_tokens(struct kunit*);
+static void lkmpg_test_parse_u8_clamped_invalid(struct kunit*);
+static void lkmpg_test_parse_u8_clamped_commas(struct kunit*);
+static void lkmpg_test_parse_u32_vector(struct kunit*);
+static void lkmpg_test_parse_u32_vector_empty(struct kunit*);
+static void lkmpg_test_parse_u32_vector_too_big(struct kunit*);
+static void lkmpg_test_parse_u32_vector_overflow(struct kunit*);
+static void lkmpg_test_parse_u32_vector_commas(struct kunit*);
+static void lkmpg_test_parse_s64_vector(struct kunit*);
+static void lkmpg_test_parse_s64_vector_overflow(struct kunit*);
+static void lkmpg_test_parse_s64_vector_commas(struct kunit*);
+static void lkmpg_test_buffer_read_span(struct kunit*);
+static void lkmpg_test_buffer_write_span(struct kunit*);
+static void lkmpg_test_buffer_reserve(struct kunit*);
+static void lkmpg_test_buffer_compact(struct kunit*);
+static void lkmpg_test_buffer_compact_empty(struct kunit*);
+
+static void lkmpg_bench_parse_u8_clamped(struct kunit*);
+static void lkmpg_bench_parse_u32_vector(struct kunit*);
+static void lkmpg_bench_parse_s64_vector(struct kunit*);
+static void lkmpg_bench_buffer_spans(struct kunit*);
+static void lkmpg_bench_buffer_reserve_compact(struct kunit*);
+
+static void lkmpg_bench_report(struct kunit*, const char*, u64 start);
+
+static struct kunit_case lkmpg_test_cases[] = {
+    KUNIT_CASE(lkmpg_test_parse_u8_clamped),
+    KUNIT_CASE(lkmpg_test_parse_u8_clamped_empty_tokens),
+    KUNIT_CASE(lkmpg_test_parse_u8_clamped_invalid),
+    KUNIT_CASE(lkmpg_test_parse_u8_clamped_commas),
+    KUNIT_CASE(lkmpg_test_parse_u32_vector),
+    KUNIT_CASE(lkmpg_test_parse_u32_vector_empty),
+    KUNIT_CASE(lkmpg_test_parse_u32_vector_too_big),
+    KUNIT_CASE(lkmpg_test_parse_u32_vector_overflow),
+    KUNIT_CASE(lkmpg_test_parse_u32_vector_commas),
+    KUNIT_CASE(lkmpg_test_parse_s64_vector),
+    KUNIT_CASE(lkmpg_test_parse_s64_vector_overflow),
+    KUNIT_CASE(lkmpg_test_parse_s64_vector_commas),
+    KUNIT_CASE(lkmpg_test_buffer_read_span),
+    KUNIT_CASE(lkmpg_test_buffer_write_span),
+    KUNIT_CASE(lkmpg_test_buffer_reserve),
+    KUNIT_CASE(lkmpg_test_buffer_compact),
+    KUNIT_CASE(lkmpg_test_buffer_compact_empty),
+    {}
+};
+
+static struct kunit_suite lkmpg_test_suite = {
+    .name = "lkmpg",
+    .test_cases = lkmpg_test_cases,
+};
+
+static struct kunit_case lkmpg_bench_cases[] = {
+    KUNIT_CASE(lkmpg_bench_parse_u8_clamped),
+    KUNIT_CASE(lkmpg_bench_parse_u32_vector),
+    KUNIT_CASE(lkmpg_bench_parse_s64_vector),
+    KUNIT_CASE(lkmpg_bench_buffer_spans),
+    KUNIT_CASE(lkmpg_bench_buffer_reserve_compact),
+    {}
+};
+
+static struct kunit_suite lkmpg_bench_suite = {
+    .name = "lkmpg_bench",
+    .test_cases = lkmpg_bench_cases,
+};
+
+kunit_test_suites(&lkmpg_test_suite, &lkmpg_bench_suite);
+
+void lkmpg_test_parse_u8_clamped(struct kunit* test) {
+
+    char input[] = "0 7 255 256 -1 0x10 99";
+    u8 values[8] = {};
+    const char* failed = NULL;
+
+    // values outside of 0..255 are clamped instead of rejected, and tokens
+    // past the end of values are ignored
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u8_clamped(input, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, 6, &failed), 0);
+    KUNIT_EXPECT_EQ(test, values[0], 0);
+    KUNIT_EXPECT_EQ(test, values[1], 7);
+    KUNIT_EXPECT_EQ(test, values[2], 255);
+    KUNIT_EXPECT_EQ(test, values[3], 255);
+    KUNIT_EXPECT_EQ(test, values[4], 0);
+    KUNIT_EXPECT_EQ(test, values[5], 16);
+    KUNIT_EXPECT_EQ(test, values[6], 0);
+    KUNIT_EXPECT_NULL(test, failed);
+
+}
+
+void lkmpg_test_parse_u8_clamped_empty_tokens(struct kunit* test) {
+
+    char input[] = "1  3\n";
+    u8 values[4] = {9, 9, 9, 9};
+    const char* failed = NULL;
+
+    // an empty token still takes its slot and leaves it as it was
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u8_clamped(input, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, 4, &failed), 0);
+    KUNIT_EXPECT_EQ(test, values[0], 1);
+    KUNIT_EXPECT_EQ(test, values[1], 9);
+    KUNIT_EXPECT_EQ(test, values[2], 3);
+    KUNIT_EXPECT_EQ(test, values[3], 9);
+
+}
+
+void lkmpg_test_parse_u8_clamped_invalid(struct kunit* test) {
+
+    char input[] = "1 two 3";
+    u8 values[3] = {};
+    const char* failed = NULL;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u8_clamped(input, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, 3, &failed), -EINVAL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, failed);
+    KUNIT_EXPECT_STREQ(test, failed, "two");
+    KUNIT_EXPECT_EQ(test, values[0], 1);
+    KUNIT_EXPECT_EQ(test, values[2], 0);
+
+}
+
+void lkmpg_test_parse_u8_clamped_commas(struct kunit* test) {
+
+    char input[] = "1,2,,4, 5\n6";
+    char tab[] = "1\t2";
+    u8 values[7] = {9, 9, 9, 9, 9, 9, 9};
+    const char* failed = NULL;
+
+    // commas split like spaces, so ", " is two delimiters with an empty token
+    // between them, and tabs are not delimiters at all
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u8_clamped(input, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, 7, &failed), 0);
+    KUNIT_EXPECT_EQ(test, values[0], 1);
+    KUNIT_EXPECT_EQ(test, values[1], 2);
+    KUNIT_EXPECT_EQ(test, values[2], 9);
+    KUNIT_EXPECT_EQ(test, values[3], 4);
+    KUNIT_EXPECT_EQ(test, values[4], 9);
+    KUNIT_EXPECT_EQ(test, values[5], 5);
+    KUNIT_EXPECT_EQ(test, values[6], 6);
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u8_clamped(tab, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, 7, &failed), -EINVAL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, failed);
+    KUNIT_EXPECT_STREQ(test, failed, "1\t2");
+
+}
+
+void lkmpg_test_parse_u32_vector(struct kunit* test) {
+
+    char input[] = " 1 4294967295\n\n0x20 ";
+    u32 values[4] = {};
+    size_t parsed = 0;
+
+    // empty tokens are skipped, so values are packed from the start
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 4, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 3);
+    KUNIT_EXPECT_EQ(test, values[0], 1U);
+    KUNIT_EXPECT_EQ(test, values[1], U32_MAX);
+    KUNIT_EXPECT_EQ(test, values[2], 32U);
+
+}
+
+void lkmpg_test_parse_u32_vector_empty(struct kunit* test) {
+
+    char empty[] = "";
+    char blank[] = " \n \n";
+    u32 values[2] = {};
+    size_t parsed = 1;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(empty, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 2, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 0);
+
+    parsed = 1;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(blank, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 2, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 0);
+
+}
+
+void lkmpg_test_parse_u32_vector_too_big(struct kunit* test) {
+
+    char exact[] = "1 2\n";
+    char over[] = "1 2 3";
+    u32 values[2] = {};
+    size_t parsed = 0;
+
+    // a full vector is fine, one value more is not, and a trailing
+    // delimiter is not a value
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(exact, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 2, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 2);
+
+    parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(over, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 2, &parsed), -E2BIG);
+    KUNIT_EXPECT_EQ(test, parsed, 0);
+
+}
+
+void lkmpg_test_parse_u32_vector_overflow(struct kunit* test) {
+
+    char overflow[] = "4294967296";
+    char negative[] = "-1";
+    u32 values[1] = {};
+    size_t parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(overflow, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), -ERANGE);
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(negative, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), -EINVAL);
+
+}
+
+void lkmpg_test_parse_u32_vector_commas(struct kunit* test) {
+
+    char input[] = "1,2,,\t3, 4\n";
+    char over[] = "1,2,3";
+    u32 values[4] = {};
+    size_t parsed = 0;
+
+    // runs of commas, tabs and spaces only separate values
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 4, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 4);
+    KUNIT_EXPECT_EQ(test, values[0], 1U);
+    KUNIT_EXPECT_EQ(test, values[1], 2U);
+    KUNIT_EXPECT_EQ(test, values[2], 3U);
+    KUNIT_EXPECT_EQ(test, values[3], 4U);
+
+    parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_u32_vector(over, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 2, &parsed), -E2BIG);
+
+}
+
+void lkmpg_test_parse_s64_vector(struct kunit* test) {
+
+    char input[] = "-9223372036854775808 0 9223372036854775807";
+    s64 values[3] = {};
+    size_t parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 3, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 3);
+    KUNIT_EXPECT_EQ(test, values[0], S64_MIN);
+    KUNIT_EXPECT_EQ(test, values[1], 0LL);
+    KUNIT_EXPECT_EQ(test, values[2], S64_MAX);
+
+}
+
+void lkmpg_test_parse_s64_vector_overflow(struct kunit* test) {
+
+    char over[] = "9223372036854775808";
+    char under[] = "-9223372036854775809";
+    char empty[] = "";
+    char too_big[] = "1 2";
+    s64 values[1] = {};
+    size_t parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(over, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), -ERANGE);
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(under, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), -ERANGE);
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(empty, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(too_big, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 1, &parsed), -E2BIG);
+
+}
+
+void lkmpg_test_parse_s64_vector_commas(struct kunit* test) {
+
+    char input[] = "-1,\t-9223372036854775808 ,2";
+    char invalid[] = "1,-,2";
+    s64 values[3] = {};
+    size_t parsed = 0;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 3, &parsed), 0);
+    KUNIT_EXPECT_EQ(test, parsed, 3);
+    KUNIT_EXPECT_EQ(test, values[0], -1LL);
+    KUNIT_EXPECT_EQ(test, values[1], S64_MIN);
+    KUNIT_EXPECT_EQ(test, values[2], 2LL);
+
+    KUNIT_EXPECT_EQ(test, lkmpg_parse_s64_vector(invalid, LKMPG_KUNIT_VECTOR_DELIMITERS, values, 3, &parsed), -EINVAL);
+
+}
+
+void lkmpg_test_buffer_read_span(struct kunit* test) {
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(-1, 16, 4), -EINVAL);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(0, 16, 4), 4);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(14, 16, 4), 2);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(15, 16, 4), 1);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(16, 16, 4), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(17, 16, 4), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(LLONG_MAX, 16, 4), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(0, 0, 4), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_read_span(0, 16, 0), 0);
+
+}
+
+void lkmpg_test_buffer_write_span(struct kunit* test) {
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(-1, 16, 4), -EINVAL);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(0, 16, 4), 4);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(0, 16, 32), 16);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(14, 16, 4), 2);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(15, 16, 4), 1);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(16, 16, 4), -ENOSPC);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(17, 16, 4), -ENOSPC);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(LLONG_MAX, 16, 4), -ENOSPC);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_write_span(0, 16, 0), -ENOSPC);
+
+}
+
+void lkmpg_test_buffer_reserve(struct kunit* test) {
+
+    struct lkmpg_buffer buffer = {};
+    char* data = NULL;
+
+    // room for a terminating nul is added, and every byte starts out zeroed
+
+    KUNIT_ASSERT_EQ(test, lkmpg_buffer_reserve(&buffer, 8), 0);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buffer.data);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 9);
+    KUNIT_EXPECT_EQ(test, buffer.size, 0);
+    KUNIT_EXPECT_TRUE(test, !memchr_inv(buffer.data, 0, buffer.capacity));
+
+    // a smaller reservation keeps the allocation
+
+    memcpy(buffer.data, "abcd", 4);
+    buffer.size = 4;
+    data = buffer.data;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_reserve(&buffer, 4), 0);
+    KUNIT_EXPECT_PTR_EQ(test, buffer.data, data);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 9);
+
+    // a larger one keeps the contents and zeroes the bytes it adds
+
+    KUNIT_ASSERT_EQ(test, lkmpg_buffer_reserve(&buffer, 64), 0);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 65);
+    KUNIT_EXPECT_EQ(test, memcmp(buffer.data, "abcd", 4), 0);
+    KUNIT_EXPECT_TRUE(test, !memchr_inv(buffer.data + 4, 0, buffer.capacity - 4));
+
+    lkmpg_buffer_free(&buffer);
+    KUNIT_EXPECT_NULL(test, buffer.data);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 0);
+
+}
+
+void lkmpg_test_buffer_compact(struct kunit* test) {
+
+    struct lkmpg_buffer buffer = {};
+
+    KUNIT_ASSERT_EQ(test, lkmpg_buffer_reserve(&buffer, 64), 0);
+    memcpy(buffer.data, "abcd", 4);
+    buffer.size = 4;
+
+    // a buffer that was just used is left alone
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_reclaimable(&buffer), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_compact(&buffer), 0);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 65);
+
+    // once idle, it shrinks to its contents and their nul
+
+    buffer.used = jiffies - msecs_to_jiffies(LKMPG_BUFFER_IDLE_MS) - 1;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_reclaimable(&buffer), 60);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_compact(&buffer), 60);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buffer.data);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 5);
+    KUNIT_EXPECT_EQ(test, buffer.size, 4);
+    KUNIT_EXPECT_STREQ(test, buffer.data, "abcd");
+
+    // and a compacted buffer has nothing more to release
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_reclaimable(&buffer), 0);
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_compact(&buffer), 0);
+
+    lkmpg_buffer_free(&buffer);
+
+}
+
+void lkmpg_test_buffer_compact_empty(struct kunit* test) {
+
+    struct lkmpg_buffer buffer = {};
+
+    // nothing to release before the first reservation
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_compact(&buffer), 0);
+
+    // an idle empty buffer is freed entirely
+
+    KUNIT_ASSERT_EQ(test, lkmpg_buffer_reserve(&buffer, 16), 0);
+    buffer.used = jiffies - msecs_to_jiffies(LKMPG_BUFFER_IDLE_MS) - 1;
+
+    KUNIT_EXPECT_EQ(test, lkmpg_buffer_compact(&buffer), 17);
+    KUNIT_EXPECT_NULL(test, buffer.data);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 0);
+
+    // and can be reserved again
+
+    KUNIT_ASSERT_EQ(test, lkmpg_buffer_reserve(&buffer, 16), 0);
+    KUNIT_EXPECT_EQ(test, buffer.capacity, 17);
+
+    lkmpg_buffer_free(&buffer);
+
+}
+
+void lkmpg_bench_report(struct kunit* test, const char* name, u64 start) {
+
+    u64 ns = ktime_get_ns() - start;
+
+    kunit_info(test, "%s: %llu ns/op over %d ops\n", name, div64_u64(ns, LKMPG_KUNIT_BENCH_ITERATIONS), LKMPG_KUNIT_BENCH_ITERATIONS);
+
+}
+
+// the parsers split their input in place, so every operation parses a fresh
+// copy of it, the way the modules parse a copy of what was written; the
+// sums keep the compiler from dropping the work and double as a check
+
+void lkmpg_bench_parse_u8_clamped(struct kunit* test) {
+
+    static const char source[] = "1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16\n";
+    char input[sizeof(source)];
+    u8 values[16] = {};
+    const char* failed = NULL;
+    u64 sum = 0;
+    u64 start = ktime_get_ns();
+
+    for (int i = 0; i < LKMPG_KUNIT_BENCH_ITERATIONS; ++i) {
+        memcpy(input, source, sizeof(source));
+        lkmpg_parse_u8_clamped(input, LKMPG_KUNIT_SEQFILE_DELIMITERS, values, ARRAY_SIZE(values), &failed);
+        sum += values[15];
+    }
+
+    lkmpg_bench_report(test, "lkmpg_parse_u8_clamped 16 values", start);
+    KUNIT_EXPECT_EQ(test, sum, 16ULL * LKMPG_KUNIT_BENCH_ITERATIONS);
+
+}
+
+void lkmpg_bench_parse_u32_vector(struct kunit* test) {
+
+    static const char source[] = "1 22 333 4444 55555 666666 7777777 88888888 1 22 333 4444 55555 666666 7777777 88888888\n";
+    char input[sizeof(source)];
+    u32 values[16] = {};
+    size_t parsed = 0;
+    u64 sum = 0;
+    u64 start = ktime_get_ns();
+
+    for (int i = 0; i < LKMPG_KUNIT_BENCH_ITERATIONS; ++i) {
+        memcpy(input, source, sizeof(source));
+        lkmpg_parse_u32_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, ARRAY_SIZE(values), &parsed);
+        sum += parsed;
+    }
+
+    lkmpg_bench_report(test, "lkmpg_parse_u32_vector 16 values", start);
+    KUNIT_EXPECT_EQ(test, sum, 16ULL * LKMPG_KUNIT_BENCH_ITERATIONS);
+
+}
+
+void lkmpg_bench_parse_s64_vector(struct kunit* test) {
+
+    static const char source[] = "-1 22 -333 4444 -55555 666666 -7777777 88888888 -999999999 1000000000000 -1 2 -3 4 -5 6\n";
+    char input[sizeof(source)];
+    s64 values[16] = {};
+    size_t parsed = 0;
+    u64 sum = 0;
+    u64 start = ktime_get_ns();
+
+    for (int i = 0; i < LKMPG_KUNIT_BENCH_ITERATIONS; ++i) {
+        memcpy(input, source, sizeof(source));
+        lkmpg_parse_s64_vector(input, LKMPG_KUNIT_VECTOR_DELIMITERS, values, ARRAY_SIZE(values), &parsed);
+        sum += parsed;
+    }
+
+    lkmpg_bench_report(test, "lkmpg_parse_s64_vector 16 values", start);
+    KUNIT_EXPECT_EQ(test, sum, 16ULL * LKMPG_KUNIT_BENCH_ITERATIONS);
+
+}
+
+// one read span and one write span per operation, at offsets that cycle
+// through the start, the middle, the end and past the end of the buffer
+
+void lkmpg_bench_buffer_spans(struct kunit* test) {
+
+    u64 sum = 0;
+    u64 start = ktime_get_ns();
+
+    for (int i = 0; i < LKMPG_KUNIT_BENCH_ITERATIONS; ++i) {
+        loff_t offset = i % 5000;
+        sum += max_t(ssize_t, lkmpg_buffer_read_span(offset, 4096, 64), 0);
+        sum += max_t(ssize_t, lkmpg_buffer_write_span(offset, 4096, 64), 0);
+        OPTIMIZER_HIDE_VAR(sum);
+    }
+
+    lkmpg_bench_report(test, "lkmpg_buffer_read_span and lkmpg_buffer_write_span", start);
+    KUNIT_EXPECT_GT(test, sum, 0ULL);
+
+}
+
+// a reservation from nothing and the compaction that frees it again, which
+// is what an idle file pays for the next write after the shrinker ran
+
+void lkmpg_bench_buffer_reserve_compact(struct kunit* test) {
+
+    struct lkmpg_buffer buffer = {};
+    u64 released = 0;
+    u64 start = ktime_get_ns();
+
+    for (int i = 0; i < LKMPG_KUNIT_BENCH_ITERATIONS; ++i) {
+
+        if (lkmpg_buffer_reserve(&buffer, 4096)) {
+            break;
+        }
+
+        buffer.used = jiffies - msecs_to_jiffies(LKMPG_BUFFER_IDLE_MS) - 1;
+        released += lkmpg_buffer_compact(&buffer);
+
+    }
+
+    lkmpg_bench_report(test, "lkmpg_buffer_reserve and lkmpg_buffer_compact 4096 bytes", start);
+    KUNIT_EXPECT_EQ(test, released, 4097ULL * LKMPG_KUNIT_BENCH_ITERATIONS);
+
+    lkmpg_buffer_free(&buffer);
+
+}